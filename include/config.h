@@ -355,6 +355,16 @@
  */
 /* #define INSURANCE allow crashed game recovery */
 
+/*
+ *      NLE: Keep level files in memory rather than in the playground, see
+ *      files.c. Only save and bones files are written to disk. Crash
+ *      recovery needs the level files on disk, and external compression
+ *      works on real files only.
+ */
+#if !defined(INSURANCE) && !defined(COMPRESS) && !defined(ZLIB_COMP)
+#define MEMORY_LEVELFILES
+#endif
+
 #ifndef MAC
 /* #define CHDIR */ /* delete if no chdir() available */ /* Deleted for NLE */
 #endif
@@ -462,6 +472,17 @@ typedef unsigned char uchar;
 #endif
 #endif
 
+/*
+ * VISION_BITBOARD makes Algorithm C work on row bitsets: the line of sight
+ * code marks what could be seen a machine word at a time, and
+ * vision_recalc() works out from the old and new bitsets which positions
+ * changed and only redraws those.  What the hero sees, and the order the
+ * map is redrawn in, is the same with or without it.
+ */
+#ifndef VISION_TABLES
+#define VISION_BITBOARD /* word-parallel line of sight */
+#endif
+
 #if !defined(MAC)
 #if !defined(NOCLIPPING)
 #define CLIPPING /* allow smaller screens -- ERS */
@@ -13,6 +13,9 @@
 #define DLBRSRC /* use Mac resources */
 #else
 #define DLBLIB /* use a set of external files */
+#ifdef UNIX
+#define DLBMMAP /* map the library files rather than reading them */
+#endif
 #endif
 
 #ifdef DLBLIB
@@ -33,6 +36,13 @@ typedef struct dlb_library {
     long nentries; /* # of files in directory */
     long rev;      /* dlb file revision */
     long strsize;  /* dlb file string size */
+#ifdef DLBMMAP
+    const char *data; /* mapped data file, replaces fdata once set */
+    long datasize;    /* size of the mapping */
+    int *hashtab;     /* dir indices by file name hash, -1 when empty */
+    int hashsize;     /* # of hashtab slots, a power of two */
+    boolean shared;   /* owned by the process rather than this game */
+#endif
 } library;
 
 /* library definitions */
@@ -844,6 +844,12 @@ E boolean NDECL(recover_savefile);
 E void NDECL(assure_syscf_file);
 #endif
 E int FDECL(nhclose, (int));
+E int FDECL(nhread, (int, genericptr_t, unsigned));
+E int FDECL(nhwrite, (int, genericptr_t, unsigned));
+#ifdef MEMORY_LEVELFILES
+E void NDECL(free_levelfiles);
+E boolean FDECL(memlevel_fd, (int));
+#endif
 #ifdef HOLD_LOCKFILE_OPEN
 E void NDECL(really_close);
 #endif
@@ -1078,6 +1084,7 @@ E int NDECL(dosuspend);
 
 E void FDECL(new_light_source, (XCHAR_P, XCHAR_P, int, int, ANY_P *));
 E void FDECL(del_light_source, (int, ANY_P *));
+E void FDECL(forget_lit_areas, (int, int));
 E void FDECL(do_light_sources, (char **));
 E void FDECL(show_transient_light, (struct obj *, int, int));
 E void NDECL(transient_light_cleanup);
@@ -1669,6 +1676,10 @@ E const char *FDECL(regex_error_desc, (struct nhregex *));
 E boolean FDECL(regex_match, (const char *, struct nhregex *));
 E void FDECL(regex_free, (struct nhregex *));
 
+/* ### nlepool.c ### */
+
+E void NDECL(free_pools);
+
 /* ### nttty.c ### */
 
 #ifdef WIN32
@@ -290,6 +290,23 @@ extern long *FDECL(alloc, (unsigned int));  /* alloc.c */
 extern char *FDECL(dupstr, (const char *)); /* ditto */
 #endif
 
+/* NLE: free-list pools for monsters, objects and their mextra and oextra;
+   see nlepool.c */
+#define POOL_MONST 0
+#define POOL_OBJ 1
+#define POOL_MEXTRA 2
+#define POOL_OEXTRA 3
+#define NUM_POOLS 4
+#ifdef MONITOR_HEAP
+extern genericptr_t FDECL(nhpool_get, (int, const char *, int));
+extern void FDECL(nhpool_put, (int, genericptr_t, const char *, int));
+#define pool_get(p) nhpool_get(p, __FILE__, (int) __LINE__)
+#define pool_put(p, x) nhpool_put(p, x, __FILE__, (int) __LINE__)
+#else
+extern genericptr_t FDECL(pool_get, (int));       /* nlepool.c */
+extern void FDECL(pool_put, (int, genericptr_t)); /* ditto */
+#endif
+
 /* Used for consistency checks of various data files; declare it here so
    that utility programs which include config.h but not hack.h can see it. */
 struct version_info {
@@ -22,5 +22,7 @@ nle_ctx_t *current_nle_ctx;
 nle_ctx_t *nle_start(nle_obs *, FILE *, nle_settings *);
 nle_ctx_t *nle_step(nle_ctx_t *, nle_obs *);
 void nle_end(nle_ctx_t *);
+void nle_set_clock(nle_ctx_t *, long, long);
+int nle_generate_level(nle_ctx_t *, unsigned long, int, int, nle_level *);
 
 #endif /* NLE_H */
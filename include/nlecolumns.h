@@ -0,0 +1,35 @@
+/*
+ * NLE columnar observation recordings.
+ *
+ * Stores the nle_obs arrays an agent saw, one column per observation key,
+ * so offline datasets don't need to reconstruct them from a ttyrec. Frames
+ * are grouped into chunks of chunk_frames rows (the last one may be
+ * shorter); each column of a chunk is a separate bzip2 stream, so a reader
+ * only decompresses the keys and chunks it needs. All integers are
+ * little-endian.
+ *
+ *   header   magic[8] "NLECOLS\0", uint32 version, uint32 chunk_frames,
+ *            uint32 num_columns
+ *   column   uint8 len, char name[len], uint8 len, char dtype[len],
+ *            uint8 ndim, uint32 shape[ndim]             (num_columns times)
+ *   chunks   bzip2 streams, written in chunk order, column order
+ *   index    per chunk: uint32 frames,
+ *                       per column: uint64 offset, uint64 size
+ *   trailer  uint64 index offset, uint64 num_chunks, magic[8]
+ *
+ * dtype is a numpy dtype name ("int16", "uint8", ...). Besides the
+ * requested observation keys, every recording has an "actions" (int32)
+ * column holding the action that led to the frame, or -1 for the first
+ * frame of an episode, and a "done" (uint8) column.
+ */
+
+#ifndef NLECOLUMNS_H
+#define NLECOLUMNS_H
+
+#define NLE_COLUMNS_MAGIC "NLECOLS"
+#define NLE_COLUMNS_MAGIC_SIZE 8
+#define NLE_COLUMNS_VERSION 1
+
+#define NLE_COLUMNS_TRAILER_SIZE (8 + 8 + NLE_COLUMNS_MAGIC_SIZE)
+
+#endif /* NLECOLUMNS_H */
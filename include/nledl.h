@@ -28,4 +28,13 @@ void nle_set_seed(nledl_ctx *, unsigned long, unsigned long, char,
 void nle_get_seed(nledl_ctx *, unsigned long *, unsigned long *, char *,
                   unsigned long *, bool *);
 
+void nle_set_clock(nledl_ctx *, long, long);
+
+void nle_set_rng_counting(nledl_ctx *, char);
+void nle_get_rng_counts(nledl_ctx *, nle_rng_counts *);
+
+int nle_generate_level(nledl_ctx *, unsigned long, int, int, nle_level *);
+
+void nle_get_pool_stats(nledl_ctx *, nle_pool_stats *);
+
 #endif /* NLEDL_H */
@@ -0,0 +1,64 @@
+/*
+ * NLE replay recordings.
+ *
+ * A replay is a compact alternative to a ttyrec: NetHack is deterministic
+ * given its RNG seeds and the stream of keypresses, so instead of every
+ * terminal byte we store the seeds, the options the game was started with,
+ * and the actions (plus in-game scores, to verify a re-simulation against).
+ *
+ * The file is a bzip2 stream of records. Each record is a single type byte
+ * followed by a payload whose size is fixed by the type (except OPTIONS,
+ * which is length prefixed). All integers are little-endian.
+ *
+ *   HEADER   magic[8] "NLERPLY\0", uint32 version, int64 start time (unix)
+ *   OPTIONS  uint8 spawn_monsters, uint32 len, char options[len]
+ *   RNG      uint8 generator (NLE_RNG_* in nletypes.h), right after
+ *            OPTIONS; left out for the default, ISAAC64
+ *   TIME     int64 time (unix), int32 UTC offset (seconds east), ttyrecs
+ *            only
+ *   SEEDS    uint64 core, uint64 disp, uint64 lgen, uint8 reseed,
+ *            uint8 lgen_in_use
+ *   ACTION   uint8 action
+ *   SCORE    int32 in-game score (blstats[NLE_BL_SCORE]), only if changed
+ *   DONE     int32 how_done
+ *
+ * A replay always starts with HEADER, OPTIONS and SEEDS. Further SEEDS
+ * records appear before the ACTION they precede if the seeds were changed
+ * (e.g. via nle_set_seed) between steps.
+ *
+ * The start time is the game's ubirthday. A replay's moon phase, night and
+ * such stay as they were at that time (see nle_clock_frozen in nle.c), and
+ * re-simulations pin NetHack's clock to it.
+ *
+ * NLE ttyrecs carry the same OPTIONS, RNG and SEEDS records in channel
+ * NLE_TTYREC_REPLAY_CHANNEL, one per ttyrec record: OPTIONS, RNG, TIME
+ * (the start time, as replays have no HEADER) and SEEDS when a game starts,
+ * and SEEDS before the action (channel 1) they precede. Recording a ttyrec
+ * leaves the game's clock alone; instead, a TIME record follows the action
+ * during which the game first read its clock in a new hour or time zone
+ * (see nle_clock_observed in nle.c), and re-simulations set NetHack's clock
+ * to it from that action on. Together with the actions, that is enough to
+ * re-simulate the game, unless it was played with reseeding.
+ */
+
+#ifndef NLEREPLAY_H
+#define NLEREPLAY_H
+
+#define NLE_REPLAY_MAGIC "NLERPLY"
+#define NLE_REPLAY_MAGIC_SIZE 8
+#define NLE_REPLAY_VERSION 1
+
+#define NLE_REPLAY_HEADER 0x48  /* 'H' */
+#define NLE_REPLAY_OPTIONS 0x4f /* 'O' */
+#define NLE_REPLAY_RNG 0x52     /* 'R' */
+#define NLE_REPLAY_SEEDS 0x53   /* 'S' */
+#define NLE_REPLAY_TIME 0x54    /* 'T' */
+#define NLE_REPLAY_ACTION 0x61  /* 'a' */
+#define NLE_REPLAY_SCORE 0x73   /* 's' */
+#define NLE_REPLAY_DONE 0x44    /* 'D' */
+
+#define NLE_REPLAY_SEEDS_SIZE (3 * 8 + 2)
+
+#define NLE_TTYREC_REPLAY_CHANNEL 3
+
+#endif /* NLEREPLAY_H */
@@ -8,6 +8,32 @@ Set of functions to manipulate NetHack's Random Number Generators
 #define NLERND_H
 
 #include "nletypes.h"
+#include "isaac64.h"
+
+/* State of one RNG stream, for either generator. */
+typedef struct nle_rng {
+    char kind; /* NLE_RNG_* */
+    union {
+        isaac64_ctx isaac64;
+        uint64_t xoshiro[4];
+    } u;
+} nle_rng;
+
+/* The streams behind rn2() and rn2_on_display_rng(), see rnd.c. */
+struct rnglist_t {
+    int (*fn)(int);
+    boolean init;
+    nle_rng rng_state;
+};
+extern struct rnglist_t rnglist[];
+
+void nle_rng_init(nle_rng *, int, unsigned long);
+uint64_t nle_rng_next(nle_rng *);
+
+/* RNG accounting, also in rnd.c. */
+extern nle_rng_counts rng_counts;
+void count_rng(boolean);
+int nle_core_stream();
 
 void nle_init_lgen_rng();
 void nle_swap_to_lgen(int);
@@ -17,5 +43,7 @@ void nle_set_seed(nle_ctx_t *, unsigned long, unsigned long, boolean,
                   unsigned long);
 void nle_get_seed(nle_ctx_t *, unsigned long *, unsigned long *, boolean *,
                   unsigned long *, bool *);
+void nle_set_rng_counting(nle_ctx_t *, boolean);
+void nle_get_rng_counts(nle_ctx_t *, nle_rng_counts *);
 
 #endif
\ No newline at end of file
@@ -3,8 +3,12 @@
 #define NLETYPES_H
 
 #include <fcontext/fcontext.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/types.h>
+
+#include "nlereplay.h"
 
 #define NLE_MESSAGE_SIZE 256
 #define NLE_BLSTATS_SIZE 27
@@ -59,6 +63,66 @@ typedef signed char boolean;
 
 typedef struct TMT TMT;
 
+/* A level made by nle_generate_level (nle.c) without playing, see
+ * nlelevel.c. Map arrays are indexed [y][x - 1] like the glyphs. Lists
+ * hold at most as many entries as they have room for; 'truncated' counts
+ * the rest. */
+#define NLE_LEVEL_ROWS 21 /* ROWNO */
+#define NLE_LEVEL_COLS 79 /* COLNO - 1 */
+#define NLE_LEVEL_ROOMS 40 /* MAXNROFROOMS */
+#define NLE_LEVEL_OBJECTS 1024
+#define NLE_LEVEL_MONSTERS 256
+#define NLE_LEVEL_TRAPS 256
+
+typedef struct nle_level {
+    int dnum, dlevel, depth;
+    char dungeon[24]; /* e.g. "The Gnomish Mines" */
+    char special[16]; /* special level file, e.g. "oracle", or "" */
+
+    unsigned char typ[NLE_LEVEL_ROWS][NLE_LEVEL_COLS];    /* LEVL_TYP */
+    unsigned char flags[NLE_LEVEL_ROWS][NLE_LEVEL_COLS];  /* doormask &c */
+    unsigned char lit[NLE_LEVEL_ROWS][NLE_LEVEL_COLS];
+    unsigned char roomno[NLE_LEVEL_ROWS][NLE_LEVEL_COLS]; /* NO_ROOM &c */
+
+    /* x, y of each, 0, 0 if absent; sstairs lead to another dungeon. */
+    unsigned char upstair[2], dnstair[2], upladder[2], dnladder[2];
+    unsigned char sstairs[2];
+
+    int nrooms;
+    struct {
+        signed char lx, ly, hx, hy, rtype, rlit, doorct, irregular;
+    } rooms[NLE_LEVEL_ROOMS];
+
+    int nobjects; /* on the floor; not buried or in containers */
+    struct {
+        unsigned char x, y;
+        short otyp;
+        int quan;
+    } objects[NLE_LEVEL_OBJECTS];
+
+    int nmonsters;
+    struct {
+        unsigned char x, y;
+        short mnum;
+        char peaceful, asleep;
+    } monsters[NLE_LEVEL_MONSTERS];
+
+    int ntraps;
+    struct {
+        unsigned char x, y, ttyp;
+    } traps[NLE_LEVEL_TRAPS];
+
+    int truncated;
+} nle_level;
+
+typedef struct nle_level_request {
+    unsigned long lgen_seed;
+    int dnum, dlevel;
+    nle_level *level;
+    int result; /* NLE_LEVEL_PENDING until done, then 0 or -1 */
+} nle_level_request;
+#define NLE_LEVEL_PENDING 1
+
 typedef struct nle_observation {
     int action;
     int done;
@@ -85,14 +149,69 @@ typedef struct nle_observation {
     int *misc;                          /* Size NLE_MISC_SIZE */
 } nle_obs;
 
+/* Generators behind the core, disp and lgen RNG streams, see rnd.c. */
+#define NLE_RNG_ISAAC64 0 /* NetHack's own ISAAC64 */
+#define NLE_RNG_XOSHIRO 1 /* xoshiro256**, much cheaper per draw */
+
 typedef struct {
     unsigned long seeds[2]; /* core, disp */
     char reseed; /* boolean: use NetHack's anti-TAS reseed mechanism? */
     bool use_init_seeds;     /* bool to tell NLE if seeds were provided */
     unsigned long lgen_seed; /* seed for level generation RNG */
     bool use_lgen_seed; /* bool to tell NLE to use level generation RNG */
+    char rng;           /* NLE_RNG_*, fixed for the whole game */
 } nle_seeds_init_t;
 
+/* Optional accounting of RNG use, see nle_get_rng_counts in nlernd.c. */
+#define NLE_RNG_STREAM_CORE 0
+#define NLE_RNG_STREAM_DISP 1
+#define NLE_RNG_STREAM_LGEN 2 /* the core RNG while it generates levels */
+#define NLE_RNG_STREAMS 3
+
+#define NLE_RNG_RN2 0 /* also rn2_on_display_rng */
+#define NLE_RNG_RNL 1
+#define NLE_RNG_RND 2
+#define NLE_RNG_D 3
+#define NLE_RNG_RNE 4
+#define NLE_RNG_RNZ 5
+#define NLE_RNG_FUNCS 6
+
+#define NLE_RNG_SITES 8192
+
+typedef struct nle_rng_site {
+    unsigned long caller; /* return address of the call */
+    unsigned char func;   /* NLE_RNG_RN2 ... NLE_RNG_RNZ */
+    unsigned char stream; /* NLE_RNG_STREAM_* */
+    unsigned long calls;
+    unsigned long draws; /* numbers taken from the stream by these calls */
+} nle_rng_site;
+
+typedef struct nle_rng_counts {
+    unsigned long draws[NLE_RNG_STREAMS];
+    unsigned long calls[NLE_RNG_STREAMS][NLE_RNG_FUNCS];
+    unsigned long lost; /* calls not in sites[] as the table was full */
+    int nsites;
+    nle_rng_site sites[NLE_RNG_SITES]; /* in order of first call */
+} nle_rng_counts;
+
+/* Occupancy of the pools behind newmonst() & co., see nlepool.c; in the
+ * order of POOL_* in global.h. */
+#define NLE_POOL_MONST 0
+#define NLE_POOL_OBJ 1
+#define NLE_POOL_MEXTRA 2
+#define NLE_POOL_OEXTRA 3
+#define NLE_POOLS 4
+
+typedef struct nle_pool_stats {
+    unsigned long size;  /* bytes per item */
+    unsigned long slabs; /* none with MONITOR_HEAP */
+    unsigned long items; /* in all slabs, in use or free */
+    unsigned long live;  /* in use now */
+    unsigned long peak;  /* most in use at any one time */
+    unsigned long gets;
+    unsigned long puts;
+} nle_pool_stats;
+
 typedef struct nle_globals {
     fcontext_stack_t stack;
     fcontext_t returncontext;
@@ -108,10 +227,63 @@ typedef struct nle_globals {
     void *ttyrec_bz2;
 #endif
 
+    /* Ttyrec records of the current step, written out in one go. All of
+     * them share the timestamp taken when the step started. */
+    char ttyrec_buf[4 * BUFSIZ];
+    size_t ttyrec_buf_len;
+    long ttyrec_sec, ttyrec_usec;
+    long ttyrec_steps;
+    /* SEEDS payload as last written to the replay channel. */
+    unsigned char ttyrec_seeds[NLE_REPLAY_SEEDS_SIZE];
+    /* Local hour (since the epoch) and UTC offset of the clock as last
+     * written to the replay channel; ttyrec_hour < 0 before the first. */
+    long ttyrec_hour, ttyrec_utc_offset;
+
+    /* Replay recording, see nlereplay.h. */
+    FILE *replay;
+    void *replay_bz2;
+    unsigned char replay_seeds[NLE_REPLAY_SEEDS_SIZE]; /* as last recorded */
+    long replay_score;
+
+    /* Pending nle_generate_level call, if any. */
+    nle_level_request *level_request;
+
     boolean done;
     nle_obs *observation;
 } nle_ctx_t;
 
+/* Special levels parsed once and shared, read-only, by all NLE instances of
+ * the process; see load_special in sp_lev.c. It lives with the caller of
+ * nle_start (nledl.c), as each instance's copy of the library is unloaded
+ * on reset. */
+#define NLE_SPLEV_CACHE_SIZE 256
+#define NLE_SPLEV_NAME_SIZE 64
+
+typedef struct nle_splev_cache {
+    pthread_mutex_t mutex;
+    int size;
+    struct {
+        char name[NLE_SPLEV_NAME_SIZE];
+        void *lvl; /* sp_lev * */
+    } entries[NLE_SPLEV_CACHE_SIZE];
+} nle_splev_cache;
+
+/* Mapped data libraries (nhdat), keyed by file identity; see map_library
+ * in dlb.c. Like the level cache, owned by nledl.c. */
+#define NLE_DLB_CACHE_SIZE 8
+
+typedef struct nle_dlb_cache {
+    pthread_mutex_t mutex;
+    int size;
+    struct {
+        dev_t dev;
+        ino_t ino;
+        off_t fsize;
+        time_t mtime;
+        void *lib; /* library * */
+    } entries[NLE_DLB_CACHE_SIZE];
+} nle_dlb_cache;
+
 typedef struct nle_settings {
     /*
      *  Path to NetHack's game files.
@@ -130,9 +302,43 @@ typedef struct nle_settings {
      * Filename for nle's ttyrec*.bz2.
      */
     char ttyrecname[4096];
+    /*
+     * Bool indicating whether ttyrec timestamps count steps (seconds = step
+     * index) instead of holding the wall-clock time the step started at.
+     */
+    int ttyrec_logical_time;
+    /*
+     * Filename for nle's replay*.bz2 (seeds and actions only), or empty.
+     */
+    char replayname[4096];
+    /*
+     * If nonzero, the Unix time NetHack's clock stands at, e.g. the start
+     * time of a recorded game being re-simulated. 0 for the wall clock.
+     */
+    long fixed_time;
+    /*
+     * Seconds east of UTC of the time zone NetHack's clock is in while
+     * fixed_time is set. Otherwise the local time zone is used.
+     */
+    long fixed_utc_offset;
 
     /* Initial seeds for the RNGs */
     nle_seeds_init_t initial_seeds;
+    /*
+     * Bool indicating whether to count RNG calls from the start of the game.
+     */
+    int rng_counts;
+    /*
+     * Bool indicating whether this instance only makes levels on request
+     * (nle_generate_level) instead of playing.
+     */
+    int level_generator;
+
+    /* Shared special level cache, or NULL to load levels every time. */
+    nle_splev_cache *splev_cache;
+
+    /* Shared data library cache, or NULL to map nhdat in each game. */
+    nle_dlb_cache *dlb_cache;
 
 } nle_settings;
 
@@ -122,7 +122,7 @@ struct obj {
     struct oextra *oextra; /* pointer to oextra struct */
 };
 
-#define newobj() (struct obj *) alloc(sizeof(struct obj))
+#define newobj() (struct obj *) pool_get(POOL_OBJ)
 
 /***
  **	oextra referencing and testing macros
@@ -1,4 +1,12 @@
-from nle._pyconverter import Converter
+from nle._pyconverter import Converter, ObservationColumns, ZipFile
 import nle.dataset.db
-from nle.dataset.populate_db import add_altorg_directory, add_nledata_directory
+import nle.dataset.framecache
+from nle.dataset.framecache import DeltaFrames
+import nle.dataset.gameindex
+from nle.dataset.gameindex import GameIndex
+from nle.dataset.populate_db import (
+    add_altorg_directory,
+    add_nledata_directory,
+    add_ttyrec_stats,
+)
 from nle.dataset.dataset import TtyrecDataset
@@ -73,6 +73,26 @@ def convert_frames(
             return
 
 
+def _make_buffers(batch_size, seq_length, rows, cols, ttyrec_version):
+    """Allocate the minibatch arrays, as a dict in the order yielded."""
+    buffers = dict(
+        tty_chars=np.zeros((batch_size, seq_length, rows, cols), dtype=np.uint8),
+        tty_colors=np.zeros((batch_size, seq_length, rows, cols), dtype=np.int8),
+        tty_cursor=np.zeros((batch_size, seq_length, 2), dtype=np.int16),
+        timestamps=np.zeros((batch_size, seq_length), dtype=np.int64),
+        done=np.zeros((batch_size, seq_length), dtype=np.uint8),
+        gameids=np.zeros((batch_size, seq_length), dtype=np.int32),
+        keypresses=np.zeros((batch_size, seq_length), dtype=np.uint8),
+        scores=np.zeros((batch_size, seq_length), dtype=np.int32),
+    )
+    key_vals = list(buffers.items())
+    if ttyrec_version < 3:
+        key_vals.remove(("scores", buffers["scores"]))
+    if ttyrec_version < 2:
+        key_vals.remove(("keypresses", buffers["keypresses"]))
+    return buffers, key_vals
+
+
 def _ttyrec_generator(
     batch_size, seq_length, rows, cols, load_fn, map_fn, ttyrec_version
 ):
@@ -84,27 +104,10 @@ def _ttyrec_generator(
        map_fn(fn, *iterables) -> <generator> (can use built-in map)
 
     """
-    chars = np.zeros((batch_size, seq_length, rows, cols), dtype=np.uint8)
-    colors = np.zeros((batch_size, seq_length, rows, cols), dtype=np.int8)
-    cursors = np.zeros((batch_size, seq_length, 2), dtype=np.int16)
-    timestamps = np.zeros((batch_size, seq_length), dtype=np.int64)
-    actions = np.zeros((batch_size, seq_length), dtype=np.uint8)
-    resets = np.zeros((batch_size, seq_length), dtype=np.uint8)
-    gameids = np.zeros((batch_size, seq_length), dtype=np.int32)
-    scores = np.zeros((batch_size, seq_length), dtype=np.int32)
-
-    key_vals = [
-        ("tty_chars", chars),
-        ("tty_colors", colors),
-        ("tty_cursor", cursors),
-        ("timestamps", timestamps),
-        ("done", resets),
-        ("gameids", gameids),
-    ]
-    if ttyrec_version >= 2:
-        key_vals.append(("keypresses", actions))
-    if ttyrec_version >= 3:
-        key_vals.append(("scores", scores))
+    buffers, key_vals = _make_buffers(
+        batch_size, seq_length, rows, cols, ttyrec_version
+    )
+    gameids = buffers["gameids"]
 
     # Load initial gameids.
     converters = [
@@ -122,13 +125,13 @@ def _ttyrec_generator(
             map_fn(
                 _convert_frames,
                 converters,
-                chars,
-                colors,
-                cursors,
-                timestamps,
-                actions,
-                scores,
-                resets,
+                buffers["tty_chars"],
+                buffers["tty_colors"],
+                buffers["tty_cursor"],
+                buffers["timestamps"],
+                buffers["keypresses"],
+                buffers["scores"],
+                buffers["done"],
                 gameids,
             )
         )
@@ -136,6 +139,182 @@ def _ttyrec_generator(
         yield dict(key_vals)
 
 
+def _native_ttyrec_generator(
+    batch_size,
+    seq_length,
+    rows,
+    cols,
+    games,
+    loop_forever,
+    num_threads,
+    ttyrec_version,
+    game_index=None,
+    root=None,
+):
+    """Like `_ttyrec_generator`, but converting whole minibatches natively.
+
+    :param games: list of (gameid, [path of part 0, part 1, ...]) to convert,
+       in order.
+    :param num_threads: number of threads of the BatchConverter.
+    :param game_index: if given, games is a list of gameids of this `GameIndex`
+       instead, whose paths are relative to root.
+
+    """
+    buffers, key_vals = _make_buffers(
+        batch_size, seq_length, rows, cols, ttyrec_version
+    )
+    batch_converter = converter.BatchConverter(
+        rows, cols, ttyrec_version, batch_size, num_threads
+    )
+    if game_index is None:
+        batch_converter.set_games(games, loop_forever)
+    else:
+        batch_converter.set_indexed_games(game_index, games, root, loop_forever)
+
+    more = True
+    while more:  # Yield the last, padded minibatch too.
+        more = batch_converter.convert(
+            buffers["tty_chars"],
+            buffers["tty_colors"],
+            buffers["tty_cursor"],
+            buffers["timestamps"],
+            buffers["keypresses"],
+            buffers["scores"],
+            buffers["done"],
+            buffers["gameids"],
+        )
+        yield dict(key_vals)
+
+
+# The order of MinibatchPipeline slot arrays.
+_PIPELINE_KEYS = (
+    "tty_chars",
+    "tty_colors",
+    "tty_cursor",
+    "timestamps",
+    "keypresses",
+    "scores",
+    "done",
+    "gameids",
+)
+
+
+def _prefetching_ttyrec_generator(
+    batch_size,
+    seq_length,
+    rows,
+    cols,
+    games,
+    loop_forever,
+    seed,
+    num_threads,
+    num_slots,
+    ttyrec_version,
+    game_index=None,
+    root=None,
+):
+    """Like `_native_ttyrec_generator`, but converting up to num_slots - 1
+    minibatches ahead on background threads, see `MinibatchPipeline`.
+
+    Each yielded minibatch is only valid until the next one is requested, when
+    its arrays are handed back to the producers.
+
+    :param seed: if not None, shuffle games with this seed.
+
+    """
+    index_kwargs = {}
+    if game_index is not None:
+        index_kwargs = dict(index=game_index, gameids=games, root=root)
+        games = []
+    slots = [
+        _make_buffers(batch_size, seq_length, rows, cols, ttyrec_version)
+        for _ in range(num_slots)
+    ]
+    pipeline = converter.MinibatchPipeline(
+        rows,
+        cols,
+        ttyrec_version,
+        [tuple(buffers[k] for k in _PIPELINE_KEYS) for buffers, _ in slots],
+        games,
+        loop_forever,
+        seed,
+        num_threads,
+        **index_kwargs,
+    )
+
+    while True:
+        slot = pipeline.next()
+        if slot < 0:
+            return
+        yield dict(slots[slot][1])
+
+
+def _cached_ttyrec_generator(
+    batch_size, seq_length, frame_cache, gameids, loop_forever, ttyrec_version
+):
+    """Like `_ttyrec_generator`, but copying frames from a FrameCache.
+
+    Fills batch rows in order with the same game assignment, resets and
+    padding as `convert_frames` over the builtin map.
+
+    :param frame_cache: a `framecache.FrameCache` holding all of `gameids`.
+
+    """
+    buffers, key_vals = _make_buffers(
+        batch_size,
+        seq_length,
+        frame_cache.rows,
+        frame_cache.cols,
+        ttyrec_version,
+    )
+    frame_keys = [k for k in buffers if k not in ("done", "gameids")]
+    resets = buffers["done"]
+    ids = buffers["gameids"]
+
+    count = [0]
+
+    def next_game():
+        i = count[0]
+        count[0] += 1
+        if (not loop_forever) and i >= len(gameids):
+            return None
+        gameid = gameids[i % len(gameids)]
+        return [gameid, frame_cache.num_frames(gameid), 0]
+
+    # One [gameid, number of frames, position] per row.
+    games = [next_game() for _ in range(batch_size)]
+    assert all(games), "Not enough ttyrecs to fill a batch!"
+
+    ids[0, -1] = 1  # basically creating a "do-while" loop by setting an indicator
+    while np.any(ids[:, -1] != 0):  # loop until only padding is found
+        for b, game in enumerate(games):
+            resets[b, 0] = 0
+            t = 0
+            while True:
+                gameid, length, pos = game
+                n = min(seq_length - t, length - pos)
+                frame_cache.read_into(
+                    gameid, pos, {k: buffers[k][b, t : t + n] for k in frame_keys}
+                )
+                resets[b, t + 1 : t + n] = 0
+                ids[b, t : t + n] = gameid
+                game[2] += n
+                t += n
+                if t == seq_length:
+                    break
+
+                game = next_game()
+                if game:
+                    games[b] = game
+                    resets[b, t] = 1
+                else:
+                    for key in buffers:
+                        buffers[key][b, t:] = 0
+                    break
+
+        yield dict(key_vals)
+
+
 class TtyrecDataset:
     """Dataset object to allow iteration through the ttyrecs found in our ttyrec
     database.
@@ -155,6 +334,11 @@ class TtyrecDataset:
         loop_forever=False,
         subselect_sql=None,
         subselect_sql_args=None,
+        num_threads=0,
+        frame_cache=None,
+        archives=(),
+        prefetch=0,
+        game_index=None,
     ):
         """
         An iterable dataset to load minibatches of NetHack games from compressed
@@ -195,6 +379,25 @@ class TtyrecDataset:
         :param subselect_sql: SQL Query to subselect games (gameids) using metadata
         :param subselect_sql_args: SQL Query Args to subselect games (gameids)
             using metadata.
+        :param num_threads: If positive, convert minibatches natively with a
+            BatchConverter running this many threads (`threadpool` is unused).
+        :param frame_cache: A `framecache.FrameCache`, or the directory of one,
+            holding the dataset's games pre-decoded by `framecache.compile`. If
+            given, minibatches are copied from it instead of converted.
+        :param archives: Paths of zip archives of the dataset, e.g. as
+            distributed. A ttyrec found in one of them under its path relative
+            to the dataset root is read from it rather than from the root
+            directory, so the archives don't need to be extracted. Not
+            supported with num_threads.
+        :param prefetch: If positive (requires num_threads), convert up to this
+            many minibatches ahead of the consumer on num_threads background
+            threads. Each minibatch is then only valid until the next one is
+            requested. Batch row i takes games i, i + batch_size, ... of the
+            (shuffled) games, so the order only depends on the seed drawn from
+            np.random.
+        :param game_index: A `gameindex.GameIndex`, or the filename of one,
+            written by `gameindex.write` for this dataset. If given, the paths
+            of games are looked up in it rather than loaded from the database.
         """
         self.batch_size = batch_size
         self.seq_length = seq_length
@@ -237,24 +440,36 @@ class TtyrecDataset:
             sql_args = subselect_sql_args if subselect_sql_args else ()
             sql_args = (dataset_name,) + sql_args
 
+        if game_index is not None and not isinstance(
+            game_index, nld.gameindex.GameIndex
+        ):
+            game_index = nld.gameindex.GameIndex(game_index)
+        self._game_index = game_index
+
         self._games = defaultdict(list)
         self._meta = None  # Populate lazily.
         self.dbfilename = dbfilename
         with nld.db.connect(self.dbfilename) as conn:
             c = conn.cursor()
 
-            for row in c.execute(core_sql, sql_args):
-                self._games[row[0]].append(row[1:3])
+            if game_index is None:
+                for row in c.execute(core_sql, sql_args):
+                    self._games[row[0]].append(row[1:3])
 
-            # Guarantee order is [part0, ..., partN] for multi-part games.
-            for files in self._games.values():
-                files.sort()
+                # Guarantee order is [part0, ..., partN] for multi-part games.
+                for files in self._games.values():
+                    files.sort()
+            elif gameids is None and subselect_sql:
+                gameids = sorted({row[0] for row in c.execute(core_sql, sql_args)})
 
             self._rootpath = nld.db.get_root(dataset_name, conn)
             self._ttyrec_version = nld.db.get_ttyrec_version(dataset_name, conn)
 
         if gameids is None:
-            gameids = self._games.keys()
+            if game_index is None:
+                gameids = self._games.keys()
+            else:
+                gameids = game_index.gameids().tolist()
 
         self._core_sql = core_sql
         self._meta_sql = meta_sql
@@ -262,10 +477,56 @@ class TtyrecDataset:
         self._gameids = list(gameids)
         self._threadpool = threadpool
         self._map = partial(self._threadpool.map, timeout=60) if threadpool else map
+        self._num_threads = num_threads
+
+        if frame_cache is not None and not isinstance(
+            frame_cache, nld.framecache.FrameCache
+        ):
+            frame_cache = nld.framecache.FrameCache(frame_cache)
+        if frame_cache is not None:
+            if (frame_cache.rows, frame_cache.cols) != (rows, cols):
+                raise ValueError(
+                    "Frame cache has %ix%i frames, not %ix%i"
+                    % (frame_cache.rows, frame_cache.cols, rows, cols)
+                )
+            missing = [g for g in self._gameids if g not in frame_cache]
+            if missing:
+                raise ValueError(
+                    "%i games are missing from the frame cache, e.g. %i"
+                    % (len(missing), missing[0])
+                )
+        self._frame_cache = frame_cache
+
+        if prefetch > 0 and num_threads <= 0:
+            raise ValueError("prefetch requires num_threads")
+        self._prefetch = prefetch
+
+        if archives and num_threads > 0:
+            raise ValueError("archives are not supported with num_threads")
+        self._members = {}
+        for path in archives:
+            archive = converter.ZipFile(path)
+            self._members.update((name, archive) for name in archive.names())
 
     def get_paths(self, gameid):
+        if self._game_index is not None:
+            return self._game_index.get_paths(gameid)
         return [path for _, path in self._games[gameid]]
 
+    @property
+    def gameids(self):
+        """The gameids of the dataset, in selection (not shuffled) order."""
+        return list(self._gameids)
+
+    @property
+    def rootpath(self):
+        """The directory relative paths from `get_paths` are relative to."""
+        return self._rootpath
+
+    @property
+    def ttyrec_version(self):
+        return self._ttyrec_version
+
     def get_meta(self, gameid):
         if self._meta is None:
             self.populate_metadata()
@@ -312,20 +573,71 @@ class TtyrecDataset:
                 part = 0
 
             filename = files[part]
+            archive = self._members.get(filename)
+            if archive is not None:
+                converter.load_ttyrec_zip(archive, filename, gameid=gameid, part=part)
+                return True
             filepath = os.path.join(self._rootpath, filename)
             converter.load_ttyrec(filepath, gameid=gameid, part=part)
             return True
 
         return _load_fn
 
-    def __iter__(self):
-        gameids = list(self._gameids)
-        if self.shuffle:
-            np.random.shuffle(gameids)
-
+    def _generator(self, gameids, batch_size, seq_length, seed=None):
+        if self._frame_cache is not None:
+            return _cached_ttyrec_generator(
+                batch_size,
+                seq_length,
+                self._frame_cache,
+                gameids,
+                self.loop_forever,
+                self._ttyrec_version,
+            )
+        if self._num_threads > 0:
+            index_kwargs = {}
+            if self._game_index is not None:
+                # Paths are looked up natively.
+                games = list(gameids)
+                index_kwargs = dict(game_index=self._game_index, root=self._rootpath)
+            else:
+                games = [
+                    (
+                        gameid,
+                        [
+                            os.path.join(self._rootpath, p)
+                            for p in self.get_paths(gameid)
+                        ],
+                    )
+                    for gameid in gameids
+                ]
+            if self._prefetch > 0:
+                return _prefetching_ttyrec_generator(
+                    batch_size,
+                    seq_length,
+                    self.rows,
+                    self.cols,
+                    games,
+                    self.loop_forever,
+                    seed,
+                    self._num_threads,
+                    self._prefetch + 1,  # One more for the consumer.
+                    self._ttyrec_version,
+                    **index_kwargs,
+                )
+            return _native_ttyrec_generator(
+                batch_size,
+                seq_length,
+                self.rows,
+                self.cols,
+                games,
+                self.loop_forever,
+                self._num_threads,
+                self._ttyrec_version,
+                **index_kwargs,
+            )
         return _ttyrec_generator(
-            self.batch_size,
-            self.seq_length,
+            batch_size,
+            seq_length,
             self.rows,
             self.cols,
             self._make_load_fn(gameids),
@@ -333,19 +645,22 @@ class TtyrecDataset:
             self._ttyrec_version,
         )
 
+    def __iter__(self):
+        gameids = list(self._gameids)
+        if self.shuffle and self._prefetch > 0:
+            # Shuffled natively, reproducibly given the seed.
+            seed = np.random.randint(2**32)
+            return self._generator(gameids, self.batch_size, self.seq_length, seed=seed)
+        if self.shuffle:
+            np.random.shuffle(gameids)
+
+        return self._generator(gameids, self.batch_size, self.seq_length)
+
     def get_ttyrecs(self, gameids, chunk_size=None):
         """Fetch data from a single episode, chunked into a sequence of tensors."""
         seq_length = chunk_size or self.seq_length
         mbs = []
-        for mb in _ttyrec_generator(
-            len(gameids),
-            seq_length,
-            self.rows,
-            self.cols,
-            self._make_load_fn(gameids),
-            self._map,
-            self._ttyrec_version,
-        ):
+        for mb in self._generator(gameids, len(gameids), seq_length):
             mbs.append({k: t.copy() for k, t in mb.items()})
         return mbs
 
@@ -169,6 +169,30 @@ def delete_dataset(dataset_name, conn=None, commit=True):
             conn.commit()
 
 
+def create_ttyrec_stats(conn=None, commit=True):
+    """Add the `ttyrec_stats` table (see populate_db.add_ttyrec_stats), unless
+    the database has it already."""
+    with db(conn, rw=True) as conn:
+        conn.execute(
+            """CREATE TABLE IF NOT EXISTS ttyrec_stats
+            (
+                path            TEXT,
+                part            INTEGER,
+                gameid          INTEGER,
+                frames          INTEGER,
+                actions         INTEGER,
+                rewards         INTEGER,
+                records         INTEGER,
+                first_timestamp INTEGER,
+                last_timestamp  INTEGER,
+                size            INTEGER,
+                PRIMARY KEY (gameid, part, path)
+            )"""
+        )
+        if commit:
+            conn.commit()
+
+
 def create(filename=DB):
     ctime = time.time()
 
@@ -250,6 +274,8 @@ def create(filename=DB):
             )"""
         )
 
+        create_ttyrec_stats(conn=c, commit=False)
+
         conn.commit()
     logger.info(
         "Created Empty '%s'. Size: %.2f MB",
@@ -0,0 +1,209 @@
+import json
+import os
+
+import numpy as np
+
+from nle import _pyconverter as converter
+
+META = "meta.json"
+INDEX = "index.npy"
+
+
+def _columns(rows, cols):
+    """The (key, dtype, frame shape) of each cached column, in file order."""
+    return (
+        ("tty_chars", np.uint8, (rows, cols)),
+        ("tty_colors", np.int8, (rows, cols)),
+        ("tty_cursor", np.int16, (2,)),
+        ("timestamps", np.int64, ()),
+        ("keypresses", np.uint8, ()),
+        ("scores", np.int32, ()),
+    )
+
+
+def compile(dataset, directory, num_threads=None, keyframe_interval=0):
+    """Decode the games of a TtyrecDataset once into a frame cache.
+
+    The cache is a directory of raw, uncompressed column files (one set per
+    compiling thread) plus an index of where each game's frames are. Passing
+    it as `frame_cache` to a TtyrecDataset with the same rows and cols then
+    fills minibatches by copying from memory-mapped files instead of
+    decompressing and converting the ttyrecs on every epoch. Expect about
+    2 * rows * cols bytes per frame.
+
+    Unlike the on-the-fly converters, which keep one terminal per batch row,
+    each game is decoded starting from a blank terminal.
+
+    :param dataset: The TtyrecDataset whose games (`dataset.gameids`) to
+        compile.
+    :param directory: Where to write the cache. Created if necessary.
+    :param num_threads: Number of games decoded in parallel (default: the
+        number of CPUs).
+    :param keyframe_interval: If positive, store tty_chars and tty_colors as
+        a keyframe every this many frames plus the cells changed in between
+        (see `DeltaFrames`), which takes a fraction of the space.
+    """
+    os.makedirs(directory, exist_ok=True)
+    games = [
+        (
+            gameid,
+            [os.path.join(dataset.rootpath, p) for p in dataset.get_paths(gameid)],
+        )
+        for gameid in dataset.gameids
+    ]
+    # One shard per thread, as compile_frame_cache writes them.
+    num_shards = max(1, min(num_threads or os.cpu_count() or 1, len(games)))
+    index = converter.compile_frame_cache(
+        directory,
+        games,
+        dataset.rows,
+        dataset.cols,
+        dataset.ttyrec_version,
+        num_shards,
+        keyframe_interval,
+    )
+    np.save(
+        os.path.join(directory, INDEX), np.array(index, dtype=np.int64).reshape(-1, 4)
+    )
+    with open(os.path.join(directory, META), "w") as f:
+        json.dump(
+            dict(
+                rows=dataset.rows,
+                cols=dataset.cols,
+                ttyrec_version=dataset.ttyrec_version,
+                num_shards=num_shards,
+                keyframe_interval=keyframe_interval,
+            ),
+            f,
+        )
+    return FrameCache(directory)
+
+
+class FrameCache:
+    """Read-only view of a frame cache written by `compile`."""
+
+    def __init__(self, directory):
+        with open(os.path.join(directory, META)) as f:
+            meta = json.load(f)
+        self.directory = directory
+        self.rows = meta["rows"]
+        self.cols = meta["cols"]
+        self.ttyrec_version = meta["ttyrec_version"]
+        self.keyframe_interval = meta.get("keyframe_interval", 0)
+
+        columns = _columns(self.rows, self.cols)
+        if self.keyframe_interval:
+            columns = (
+                ("frames", np.uint8, ()),
+                ("frame_offsets", np.uint64, ()),
+            ) + columns[2:]
+
+        self._shards = []
+        for shard in range(meta["num_shards"]):
+            arrays = {}
+            for key, dtype, shape in columns:
+                filename = os.path.join(directory, "%s.%i" % (key, shard))
+                if os.path.getsize(filename) == 0:  # Can't mmap empty files.
+                    arrays[key] = np.zeros((0,) + shape, dtype=dtype)
+                else:
+                    arrays[key] = np.memmap(filename, dtype=dtype, mode="r")
+                    arrays[key] = arrays[key].reshape((-1,) + shape)
+            self._shards.append(arrays)
+
+        self._games = {
+            gameid: (shard, start, length)
+            for gameid, shard, start, length in np.load(
+                os.path.join(directory, INDEX)
+            ).tolist()
+        }
+
+    def __contains__(self, gameid):
+        return gameid in self._games
+
+    def __len__(self):
+        return len(self._games)
+
+    def num_frames(self, gameid):
+        return self._games[gameid][2]
+
+    def read_into(self, gameid, pos, out):
+        """Copy frames pos, pos + 1, ... of a game into the arrays of the dict
+        out, all [n, ...] with the same n, keyed like `_columns`."""
+        shard, start, length = self._games[gameid]
+        arrays = self._shards[shard]
+        n = len(out["timestamps"])
+        assert pos + n <= length
+        for key, array in out.items():
+            if key in arrays:
+                array[...] = arrays[key][start + pos : start + pos + n]
+        if self.keyframe_interval:
+            converter.decode_frames(
+                arrays["frames"],
+                arrays["frame_offsets"],
+                start + pos,
+                out["tty_chars"],
+                out["tty_colors"],
+            )
+
+    def frames(self, gameid):
+        """Dict of the game's columns, as [num_frames, ...] arrays. These are
+        read-only views unless the cache is delta encoded."""
+        shard, start, length = self._games[gameid]
+        if not self.keyframe_interval:
+            return {
+                key: column[start : start + length]
+                for key, column in self._shards[shard].items()
+            }
+        out = {
+            key: np.zeros((length,) + shape, dtype=dtype)
+            for key, dtype, shape in _columns(self.rows, self.cols)
+        }
+        self.read_into(gameid, 0, out)
+        return out
+
+
+class DeltaFrames:
+    """Terminal frames held as keyframes plus the cells changed in between.
+
+    An in-memory counterpart of the delta encoded frame cache, eg. for replay
+    buffers: typical NetHack frames take a few hundred bytes instead of
+    2 * rows * cols. Decoding frame i replays it from the last keyframe
+    before it, at most `keyframe_interval` frames back.
+
+    Example
+    -------
+        ```
+        frames = DeltaFrames(mb["tty_chars"][0], mb["tty_colors"][0])
+        chars, colors = frames.decode(10, 20)
+        ```
+    """
+
+    def __init__(self, chars, colors, keyframe_interval=128):
+        """
+        :param chars: np.array(np.uint8) [T x ROWS x COLS]
+        :param colors: np.array(np.int8) [T x ROWS x COLS]
+        """
+        self.shape = chars.shape[1:]
+        self.data, self.offsets = converter.encode_frames(
+            np.ascontiguousarray(chars),
+            np.ascontiguousarray(colors),
+            keyframe_interval,
+        )
+
+    def __len__(self):
+        return len(self.offsets)
+
+    @property
+    def nbytes(self):
+        return self.data.nbytes + self.offsets.nbytes
+
+    def decode(self, start=0, stop=None, chars=None, colors=None):
+        """Decode frames [start, stop), into chars and colors if given."""
+        stop = len(self) if stop is None else stop
+        shape = (stop - start,) + self.shape
+        if chars is None:
+            chars = np.zeros(shape, dtype=np.uint8)
+        if colors is None:
+            colors = np.zeros(shape, dtype=np.int8)
+        converter.decode_frames(self.data, self.offsets, start, chars, colors)
+        return chars, colors
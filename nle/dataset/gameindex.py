@@ -0,0 +1,92 @@
+import os
+
+import numpy as np
+
+from nle import _pyconverter as converter
+from nle import dataset as nld
+
+GameIndex = converter.GameIndex
+
+MAGIC = b"NLEGIDX1"
+
+
+def _padded(data):
+    return data + b"\0" * (-len(data) % 8)
+
+
+def write(filename, dataset_name, dbfilename=nld.db.DB, columns=None):
+    """Write the games of a dataset to a game index file.
+
+    The index holds the sorted gameids, the paths of each game's ttyrecs
+    (relative to the dataset root) and integer metadata columns from the
+    `games` table, in a flat file that `GameIndex` memory-maps. Passing it as
+    `game_index` to a TtyrecDataset spares every worker loading the paths from
+    sqlite into Python objects, and the pages are shared between processes.
+    Rewrite the index after changing the dataset.
+
+    :param columns: Names of the `games` columns to include (default: all
+        INTEGER columns). Missing values are stored as -1.
+    """
+    with nld.db.connect(dbfilename) as conn:
+        c = conn.cursor()
+        ttyrec_version = nld.db.get_ttyrec_version(dataset_name, conn)
+        if columns is None:
+            columns = [
+                name
+                for _, name, ctype, *_ in c.execute("PRAGMA table_info(games)")
+                if ctype == "INTEGER" and name != "gameid"
+            ]
+
+        paths = {}
+        for gameid, _, path in c.execute(
+            """SELECT ttyrecs.gameid, ttyrecs.part, ttyrecs.path
+            FROM ttyrecs
+            INNER JOIN datasets ON ttyrecs.gameid=datasets.gameid
+            WHERE datasets.dataset_name=?
+            ORDER BY ttyrecs.gameid, ttyrecs.part""",
+            (dataset_name,),
+        ):
+            paths.setdefault(gameid, []).append(path)
+        gameids = np.array(sorted(paths), dtype=np.int64)
+
+        values = np.full((len(columns), len(gameids)), -1, dtype=np.int64)
+        if columns:
+            position = {gameid: i for i, gameid in enumerate(gameids.tolist())}
+            for gameid, *row in c.execute(
+                "SELECT gameid, %s FROM games" % ", ".join(columns)
+            ):
+                i = position.get(gameid)
+                if i is not None:
+                    values[:, i] = [-1 if v is None else v for v in row]
+
+    pool = bytearray()
+    path_offsets = []
+    part_offsets = [0]
+    for gameid in gameids.tolist():
+        for path in paths[gameid]:
+            path_offsets.append(len(pool))
+            pool += path.encode() + b"\0"
+        part_offsets.append(len(path_offsets))
+    pool = _padded(bytes(pool) or b"\0")
+    names = _padded(b"".join(name.encode() + b"\0" for name in columns))
+
+    header = [
+        len(gameids),
+        len(path_offsets),
+        len(columns),
+        len(names),
+        len(pool),
+        ttyrec_version,
+    ]
+    tmpname = filename + ".tmp"
+    with open(tmpname, "wb") as f:
+        f.write(MAGIC)
+        f.write(np.array(header, dtype="<u8").tobytes())
+        f.write(gameids.astype("<i8").tobytes())
+        f.write(np.array(part_offsets, dtype="<u8").tobytes())
+        f.write(np.array(path_offsets, dtype="<u8").tobytes())
+        f.write(values.astype("<i8").tobytes())
+        f.write(names)
+        f.write(pool)
+    os.replace(tmpname, filename)
+    return GameIndex(filename)
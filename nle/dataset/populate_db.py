@@ -6,6 +6,7 @@ import re
 import time
 from functools import partial
 
+from nle import _pyconverter as converter
 from nle import dataset as nld
 
 XLOGFILE_COLUMNS = [
@@ -317,6 +318,64 @@ def add_nledata_directory(path, name, filename=nld.db.DB):
     )
 
 
+def add_ttyrec_stats(name, filename=nld.db.DB, num_threads=None):
+    """Scan the ttyrecs of dataset `name` into the `ttyrec_stats` table.
+
+    Only the record headers are read, which is much faster than converting the
+    ttyrecs. For each ttyrec this stores the number of frames a conversion
+    yields, of action (channel 1) and reward (channel 2) records and of records
+    overall, the first and last timestamps (in microseconds) and the
+    decompressed size. Existing rows of the ttyrecs are replaced.
+
+    :param num_threads: Number of ttyrecs scanned in parallel (default: the
+        number of CPUs).
+    """
+    with nld.db.db(filename=filename, rw=True) as conn:
+        print("Scanning ttyrecs of dataset '%s' in '%s'" % (name, filename))
+        stime = time.time()
+        c = conn.cursor()
+        nld.db.create_ttyrec_stats(conn=c, commit=False)
+
+        root = nld.db.get_root(name, conn=c)
+        version = nld.db.get_ttyrec_version(name, conn=c)
+        ttyrecs = c.execute(
+            """SELECT ttyrecs.path, ttyrecs.part, ttyrecs.gameid
+            FROM ttyrecs
+            INNER JOIN datasets ON ttyrecs.gameid=datasets.gameid
+            WHERE datasets.dataset_name=?""",
+            (name,),
+        ).fetchall()
+        stats = converter.scan_ttyrecs(
+            [os.path.join(root, path) for path, _, _ in ttyrecs],
+            version,
+            num_threads or os.cpu_count() or 1,
+        )
+        c.executemany(
+            "INSERT OR REPLACE INTO ttyrec_stats VALUES (?,?,?,?,?,?,?,?,?,?)",
+            (
+                (
+                    path,
+                    part,
+                    gameid,
+                    s["frames"],
+                    s["records"].get(1, 0),
+                    s["records"].get(2, 0),
+                    sum(s["records"].values()),
+                    s["first_timestamp"],
+                    s["last_timestamp"],
+                    s["size"],
+                )
+                for (path, part, gameid), s in zip(ttyrecs, stats)
+            ),
+        )
+
+        mtime = time.time()
+        c.execute("UPDATE meta SET mtime = ?", (mtime,))
+        conn.commit()
+
+    print("Scanned %i ttyrecs in %.2f sec." % (len(ttyrecs), mtime - stime))
+
+
 def ttyrec_data_generator(ttyrecs, gameids, root):
     last_gameid = None
     for path, gameid in zip(ttyrecs, gameids):
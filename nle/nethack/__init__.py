@@ -12,5 +12,7 @@ from nle.nethack.nethack import (
     INTERNAL_SHAPE,
     OBSERVATION_DESC,
     TTYREC_VERSION,
+    replay,
+    replay_ttyrecs,
     tty_render,
 )
@@ -29,6 +29,12 @@ SCREEN_DESCRIPTIONS_SHAPE = DUNGEON_SHAPE + (
 )
 TERMINAL_SHAPE = (_pynethack.nethack.NLE_TERM_LI, _pynethack.nethack.NLE_TERM_CO)
 
+# Generators that can drive NetHack's core, disp and lgen RNG streams.
+RNGS = {
+    "isaac64": _pynethack.nethack.NLE_RNG_ISAAC64,
+    "xoshiro": _pynethack.nethack.NLE_RNG_XOSHIRO,
+}
+
 OBSERVATION_DESC = {
     "glyphs": dict(shape=DUNGEON_SHAPE, dtype=np.int16),
     "chars": dict(shape=DUNGEON_SHAPE, dtype=np.uint8),
@@ -120,6 +126,56 @@ def _close(pynethack, dl, tempdir, warn=True):
         )
 
 
+def _replayer(observation_keys, num_threads, hackdir):
+    for key in observation_keys:
+        if key not in OBSERVATION_DESC:
+            raise ValueError("Unknown observation '%s'" % key)
+    return _pynethack.Replayer(DLPATH, hackdir, list(observation_keys), num_threads)
+
+
+def replay(
+    filenames, observation_keys=OBSERVATION_DESC.keys(), num_threads=1, hackdir=HACKDIR
+):
+    """Re-simulates replays recorded via `Nethack.set_replay`.
+
+    Each replay is run through a fresh copy of libnethack, on up to
+    `num_threads` threads in parallel, with NetHack's clock pinned to the
+    time the game started. The moon phase, night time and the like stayed as
+    they were at that time while the game was recorded, too. Raises
+    ValueError for games played with NetHack's anti-TAS reseeding (see
+    `set_current_seeds`), which can't be re-simulated.
+
+    Returns:
+        [list] one dict per filename, mapping each observation key to an array
+        of shape (T,) + OBSERVATION_DESC[key]["shape"] holding the observation
+        before each action, and "actions" to the (T,) array of actions taken.
+    """
+    replayer = _replayer(observation_keys, num_threads, hackdir)
+    return replayer.replay(list(filenames))
+
+
+def replay_ttyrecs(
+    filenames, observation_keys=OBSERVATION_DESC.keys(), num_threads=1, hackdir=HACKDIR
+):
+    """Re-simulates the games of ttyrecs recorded by NLE, like `replay`.
+
+    NLE ttyrecs hold the options and RNG seeds of each game in channel 3
+    (see include/nlereplay.h) besides the actions in channel 1, which turns
+    them into replays with full observations rather than terminal frames
+    only. Only games played without NetHack's anti-TAS reseeding, i.e. with
+    seeds set via `set_initial_seeds` with reseed=False, can be re-simulated;
+    others raise ValueError. Instead of staying at the start time, NetHack's
+    clock follows the hours and time zone the recorded game saw, which the
+    ttyrec holds as well.
+
+    Returns:
+        [list] one dict per game, in the order of the files and of the games
+        within each file (one per reset), like `replay`.
+    """
+    replayer = _replayer(observation_keys, num_threads, hackdir)
+    return replayer.replay_ttyrecs(list(filenames))
+
+
 def tty_render(chars, colors, cursor=None):
     """Returns chars as string with ANSI escape sequences.
 
@@ -168,9 +224,17 @@ class Nethack:
         hackdir=HACKDIR,
         spawn_monsters=True,
         scoreprefix="",
+        ttyrec_logical_time=False,
+        rng="isaac64",
+        level_generator=False,
     ):
         self._copy = copy
 
+        if rng not in RNGS:
+            raise ValueError(
+                "Unknown RNG '%s', expected one of %s" % (rng, list(RNGS))
+            )
+
         if not os.path.exists(hackdir) or not os.path.exists(
             os.path.join(hackdir, "nhdat")
         ):
@@ -232,6 +296,16 @@ class Nethack:
                 scoreprefix,
             )
         self._ttyrec = ttyrec
+        if ttyrec_logical_time:
+            # Step indices instead of wall-clock seconds as ttyrec timestamps.
+            self._pynethack.set_ttyrec_logical_time(True)
+        if rng != "isaac64":
+            # Same seeds, different (cheaper) generator: games only
+            # reproduce with the generator they were played with.
+            self._pynethack.set_rng(RNGS[rng])
+        if level_generator:
+            # Makes levels via generate_level() instead of playing.
+            self._pynethack.set_level_generator(True)
 
         self._finalizer.detach()
         self._finalizer = weakref.finalize(
@@ -319,6 +393,104 @@ class Nethack:
     def get_current_seeds(self):
         return self._pynethack.get_seeds()
 
+    def generate_level(self, lgen_seed, dnum=0, dlevel=1):
+        """Makes a level without playing, on a level_generator instance.
+
+        The level comes from the level generation seed alone: the same seed,
+        dungeon and level give the same level on any level generator with
+        the same options, in any order. It is not the level a game with
+        this lgen seed would reach there, though. Needs a reset() first.
+
+        Arguments:
+            lgen_seed [int]: Seed for the dungeon layout and the level.
+            dnum [int]: Dungeon number, 0 for the Dungeons of Doom.
+            dlevel [int]: Level within that dungeon, from 1.
+
+        Returns:
+            [dict or None] None if there is no such level, otherwise the
+                map as (21, 79) arrays "typ", "flags", "lit" and "roomno",
+                (x, y) tuples for the stairs and ladders, "rooms" (lx, ly,
+                hx, hy, rtype, rlit, doorct, irregular), floor "objects"
+                (x, y, otyp, quan), "monsters" (x, y, mnum, peaceful,
+                asleep) and "traps" (x, y, ttyp) as arrays, one row each.
+        """
+        return self._pynethack.generate_level(lgen_seed, dnum, dlevel)
+
+    def get_pool_stats(self):
+        """Returns how full NetHack's monster and object pools are.
+
+        Monsters, objects and their extra data are allocated from per-type
+        slabs and recycled through free lists rather than malloc'd one by
+        one. Needs a reset() first.
+
+        Returns:
+            [dict] with a dict for each of "monst", "obj", "mextra" and
+                "oextra": item "size" in bytes, "slabs" allocated, "items"
+                in them, "live" items in use now and "peak" at most so far,
+                "gets" and "puts" (allocations and releases) this game.
+        """
+        return self._pynethack.get_pool_stats()
+
+    def set_rng_counting(self, on=True):
+        """Counts calls to NetHack's random functions from now on.
+
+        Counting restarts from zero in the current game, if any, and from
+        the start of every following game until turned off again.
+        """
+        self._pynethack.set_rng_counting(on)
+
+    def get_rng_counts(self):
+        """Returns the RNG use counted so far in this game.
+
+        Only the outermost call of rn2, rnl, rnd, d, rne or rnz is counted;
+        draws of nested calls (e.g. rne's rn2s) go to the outer call.
+
+        Returns:
+            [dict] with
+                "draws": random numbers taken per stream, indexed by
+                    NLE_RNG_STREAM_{CORE,DISP,LGEN}.
+                "calls": calls per stream and function (NLE_RNG_RN2 etc.).
+                "sites": list of (caller, function, stream, calls, draws),
+                    where caller is the return address as an offset into the
+                    NetHack library (for addr2line), in order of first call.
+                "lost": calls not in "sites" as its table was full.
+        """
+        return self._pynethack.get_rng_counts()
+
+    def record_observations(self, path, observation_keys=None, chunk_frames=1024):
+        """Records every following observation to `path`, one column per key.
+
+        The file holds the observations returned by `reset` and `step`, plus
+        the action that led to each of them (-1 after a reset) and the done
+        flag, and can be read with `nle.dataset.ObservationColumns`. Frames
+        are compressed in chunks of `chunk_frames` on a background thread.
+        Recording stops when called with `path=None` or on `close`; only then
+        is the file complete.
+
+        Arguments:
+            path [str or None]: File to write to.
+            observation_keys [list or None]: Keys to record; defaults to all
+                observation keys of this instance.
+            chunk_frames [int]: Number of frames per compressed chunk.
+        """
+        if observation_keys is None:
+            observation_keys = self._obs_buffers.keys()
+        self._pynethack.record_observations(
+            path or "", list(observation_keys), chunk_frames
+        )
+
+    def set_replay(self, path):
+        """Records the next episodes as replays to `path`.
+
+        A replay only stores the options, seeds and actions of an episode and
+        can be turned back into observations with `replay`. Takes effect at
+        the next reset; pass None to stop recording. While recording, NetHack's
+        anti-TAS reseeding is disabled and the moon phase, night time and the
+        like stay as they were when the episode started, as both would make
+        the episode impossible to re-simulate.
+        """
+        self._pynethack.set_replay(path or "")
+
     def in_normal_game(self):
         return self._pynethack.in_normal_game()
 
@@ -57,7 +57,7 @@ def ttyframes(f, tty2=True):
             sec, usec, length = struct.unpack("<iii", header)
             channel = 0
 
-        if sec < 0 or usec < 0 or length < 0 or channel not in (0, 1, 2):
+        if sec < 0 or usec < 0 or length < 0 or channel not in (0, 1, 2, 3):
             raise IOError("Illegal header %s in %s" % ((sec, usec, length, channel), f))
         timestamp = sec + usec * 1e-6
 
@@ -93,7 +93,8 @@ DEC_DATA_COLOR = 3  # Dark yellow.
 FRAMECNT_COLOR = 2  # Dark green.
 TIMESTAMP_COLOR = 7  # "Normal" color.
 CHANNEL_COLOR = 2  # Dark green.
-BRACES_COLOR = [11, 4, 5]  # Output: Bright yellow, input: dark blue, score: pink
+# Output: Bright yellow, input: dark blue, score: pink, seeds: dark cyan.
+BRACES_COLOR = [11, 4, 5, 6]
 
 
 # "Select Graphic Rendition" sequence.
@@ -163,7 +164,7 @@ def main():
     if FLAGS.use_pager:
         setup_pager()
 
-    frames = [0, 0, 0]
+    frames = [0, 0, 0, 0]
     with getfile(FLAGS.filename) as f:
         for timestamp, channel, data in ttyframes(f, tty2=not FLAGS.no_input):
             frames[channel] += 1
@@ -184,6 +185,18 @@ def main():
                 score, *_ = struct.unpack("<i", data)
                 data = f"  {score} "
                 arrow = "->"
+            elif channel == 3:
+                if data[:1] == b"S":  # See include/nlereplay.h.
+                    core, disp, lgen, reseed, lgen_in_use = struct.unpack(
+                        "<QQQ??", data[1:]
+                    )
+                    data = f"  core={core} disp={disp} reseed={reseed} "
+                    if lgen_in_use:
+                        data += f"lgen={lgen} "
+                elif data[:1] == b"T":
+                    time, utc_offset = struct.unpack("<qi", data[1:])
+                    data = f"  time={time} utc_offset={utc_offset} "
+                arrow = "->"
 
             data = str(data)[2:-1]  # Strip b' and '
 
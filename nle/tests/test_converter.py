@@ -1,12 +1,13 @@
 import bz2
 import os
 import re
+import zipfile
 
 import numpy as np
 import pytest
 from memory_profiler import memory_usage
 
-from nle.dataset import Converter
+from nle.dataset import Converter, ZipFile
 
 # From
 #   https://alt.org/nethack/trd/?file=https://s3.amazonaws.com/altorg/ttyrec/Anarchos/2020-10-03.17:27:10.ttyrec.bz2  # noqa: B950
@@ -78,6 +79,22 @@ def load_and_convert(
         )
 
 
+def _convert_all(converter, seq_length):
+    """Converts up to seq_length frames into new buffers.
+
+    Returns the number of frames left unfilled and the chars, colors, cursors,
+    timestamps, actions and scores buffers.
+    """
+    chars = np.zeros((seq_length, converter.rows, converter.cols), dtype=np.uint8)
+    colors = np.zeros((seq_length, converter.rows, converter.cols), dtype=np.int8)
+    cursors = np.zeros((seq_length, 2), dtype=np.int16)
+    timestamps = np.zeros((seq_length,), dtype=np.int64)
+    actions = np.zeros((seq_length,), dtype=np.uint8)
+    scores = np.zeros((seq_length,), dtype=np.int32)
+    remaining = converter.convert(chars, colors, cursors, timestamps, actions, scores)
+    return remaining, chars, colors, cursors, timestamps, actions, scores
+
+
 class TestConverter:
     def test_is_loaded(self):
         converter = Converter(ROWS, COLUMNS, TTYREC_V1)
@@ -135,6 +152,92 @@ class TestConverter:
         )
         assert remaining == 165
 
+    @pytest.mark.parametrize("threads", [2, 4])
+    def test_parallel_decompression(self, tmpdir, threads, seq_length=4000):
+        # Level 1 gives 100k blocks, so this ttyrec spans several of them.
+        with bz2.open(getfilename(TTYREC_2020)) as f:
+            data = f.read()
+        multiblock = str(tmpdir.join("multiblock.ttyrec.bz2"))
+        with open(multiblock, "wb") as f:
+            f.write(bz2.compress(data, compresslevel=1))
+
+        results = []
+        for t in (1, threads):
+            converter = Converter(ROWS, COLUMNS, TTYREC_V1, threads=t)
+            converter.load_ttyrec(multiblock)
+            results.append(_convert_all(converter, seq_length)[:5])
+
+        assert results[0][0] == results[1][0] > 0
+        for serial, parallel in zip(results[0][1:], results[1][1:]):
+            np.testing.assert_array_equal(serial, parallel)
+
+    def test_seek(self, tmpdir, seq_length=3000):
+        # Level 1 gives 100k blocks, so keyframes land in different blocks.
+        with bz2.open(getfilename(TTYREC_2020)) as f:
+            data = f.read()
+        ttyrec = str(tmpdir.join("seek.ttyrec.bz2"))
+        with open(ttyrec, "wb") as f:
+            f.write(bz2.compress(data, compresslevel=1))
+
+        def convert(converter):
+            remaining, *buffers = _convert_all(converter, seq_length)
+            return [b[: seq_length - remaining] for b in buffers[:4]]
+
+        converter = Converter(ROWS, COLUMNS, TTYREC_V1)
+        converter.load_ttyrec(ttyrec)
+        expected = convert(converter)
+        num_frames = len(expected[0])
+
+        assert converter.index_ttyrec(ttyrec, interval=100) == num_frames
+        assert os.path.exists(ttyrec + ".idx")
+
+        for start in [1, 99, 100, 101, 1234, num_frames - 1]:
+            converter = Converter(ROWS, COLUMNS, TTYREC_V1)
+            converter.load_ttyrec(ttyrec, start_frame=start)
+            for e, a in zip(expected, convert(converter)):
+                np.testing.assert_array_equal(e[start:], a)
+
+    def test_load_from_memory(self, tmpdir, seq_length=3000):
+        def convert(converter):
+            return _convert_all(converter, seq_length)[1:5]
+
+        converter = Converter(ROWS, COLUMNS, TTYREC_V1)
+        converter.load_ttyrec(getfilename(TTYREC_2020))
+        expected = convert(converter)
+
+        with open(getfilename(TTYREC_2020), "rb") as f:
+            data = f.read()
+        archive = str(tmpdir.join("ttyrecs.zip"))
+        with zipfile.ZipFile(archive, "w") as z:
+            z.writestr("a/stored.ttyrec.bz2", data, zipfile.ZIP_STORED)
+            z.writestr("b/deflated.ttyrec.bz2", data, zipfile.ZIP_DEFLATED)
+
+        archive = ZipFile(archive)
+        assert len(archive) == 2
+        assert archive.names() == ["a/stored.ttyrec.bz2", "b/deflated.ttyrec.bz2"]
+        assert "a/stored.ttyrec.bz2" in archive
+        assert "stored.ttyrec.bz2" not in archive
+
+        converter = Converter(ROWS, COLUMNS, TTYREC_V1)
+        converter.load_ttyrec_buffer(data, gameid=1)
+        assert converter.is_loaded()
+        assert converter.gameid == 1
+        for e, a in zip(expected, convert(converter)):
+            np.testing.assert_array_equal(e, a)
+
+        for member in archive.names():
+            converter = Converter(ROWS, COLUMNS, TTYREC_V1)
+            converter.load_ttyrec_zip(archive, member, gameid=2, part=1)
+            assert converter.filename == member
+            assert converter.part == 1
+            for e, a in zip(expected, convert(converter)):
+                np.testing.assert_array_equal(e, a)
+
+        with pytest.raises(KeyError):
+            converter.load_ttyrec_zip(archive, "missing.ttyrec.bz2")
+        with pytest.raises(RuntimeError):
+            ZipFile(getfilename(TTYREC_2020))
+
     def test_data(self):
         converter = Converter(ROWS, COLUMNS, TTYREC_V1)
         assert converter.rows == ROWS
@@ -14,6 +14,24 @@ from test_db import mockdata  # noqa: F401
 
 from nle.dataset import dataset
 from nle.dataset import db
+from nle.dataset import framecache
+from nle.dataset import gameindex
+
+# One game per row, so which row loads which game is deterministic.
+ONE_GAME_PER_ROW = dict(seq_length=20, batch_size=7, gameids=range(1, 8), shuffle=False)
+
+
+def _collect(data):
+    # The dataset reuses its arrays, so copy each minibatch.
+    return [{k: v.copy() for k, v in mb.items()} for mb in data]
+
+
+def _assert_same_minibatches(a, b):
+    assert len(a) == len(b)
+    for mb1, mb2 in zip(a, b):
+        assert list(mb1.keys()) == list(mb2.keys())
+        for k in mb1:
+            np.testing.assert_array_equal(mb1[k], mb2[k])
 
 
 class TestDataset:
@@ -91,6 +109,137 @@ class TestDataset:
         # No leading 1s
         assert (mb["done"][:, 0] == 0).all()
 
+    @pytest.mark.parametrize("num_threads", [1, 3])
+    def test_native_batch_converter(self, db_exists, num_threads):
+        expected = _collect(dataset.TtyrecDataset("basictest", **ONE_GAME_PER_ROW))
+        native = _collect(
+            dataset.TtyrecDataset(
+                "basictest", num_threads=num_threads, **ONE_GAME_PER_ROW
+            )
+        )
+        _assert_same_minibatches(expected, native)
+
+    def test_native_batch_converter_several_games_per_row(self, db_exists):
+        # Rows run out of their game mid-minibatch and go on with the next
+        # part (game 7 has three) or the next game. With one thread, rows take
+        # new games in row order, as they do with the builtin map.
+        kwargs = dict(seq_length=50, batch_size=2, gameids=range(1, 8), shuffle=False)
+        expected = _collect(dataset.TtyrecDataset("basictest", **kwargs))
+        native = _collect(dataset.TtyrecDataset("basictest", num_threads=1, **kwargs))
+        _assert_same_minibatches(expected, native)
+
+        gameids = np.concatenate([mb["gameids"] for mb in native], axis=1)
+        assert set(np.unique(gameids)) == set(range(8))
+        # Some row went on with another game within a minibatch.
+        assert any(len(set(row) - {0}) > 1 for mb in native for row in mb["gameids"])
+
+    @pytest.mark.parametrize("num_threads", [1, 3])
+    def test_prefetching_pipeline(self, db_exists, num_threads):
+        expected = _collect(dataset.TtyrecDataset("basictest", **ONE_GAME_PER_ROW))
+        prefetched = _collect(
+            dataset.TtyrecDataset(
+                "basictest", num_threads=num_threads, prefetch=2, **ONE_GAME_PER_ROW
+            )
+        )
+        _assert_same_minibatches(expected, prefetched)
+
+        # Several games per row: the same seed gives the same minibatches.
+        data = dataset.TtyrecDataset(
+            "basictest",
+            seq_length=50,
+            batch_size=3,
+            gameids=range(1, 8),
+            num_threads=num_threads,
+            prefetch=3,
+        )
+
+        def get_data(seed):
+            np.random.seed(seed)
+            return _collect(data)
+
+        run1, run2 = get_data(0), get_data(0)
+        _assert_same_minibatches(run1, run2)
+        gameids = np.concatenate([mb["gameids"] for mb in run1], axis=1)
+        assert set(np.unique(gameids)) == set(range(8))
+
+        with pytest.raises(ValueError):
+            dataset.TtyrecDataset("basictest", prefetch=2)
+
+    @pytest.mark.parametrize("keyframe_interval", [0, 8])
+    def test_frame_cache(self, db_exists, tmpdir, keyframe_interval):
+        # One game per row, so each game starts on a blank terminal either way.
+        data = dataset.TtyrecDataset("basictest", **ONE_GAME_PER_ROW)
+        expected = _collect(data)
+
+        cache = framecache.compile(
+            data, str(tmpdir), num_threads=3, keyframe_interval=keyframe_interval
+        )
+        assert len(cache) == 7
+        cached = _collect(
+            dataset.TtyrecDataset(
+                "basictest", frame_cache=str(tmpdir), **ONE_GAME_PER_ROW
+            )
+        )
+        _assert_same_minibatches(expected, cached)
+
+        # An empty dataset still gives a (one shard) cache that opens.
+        empty = dataset.TtyrecDataset("basictest", gameids=[])
+        assert len(framecache.compile(empty, str(tmpdir.join("empty")))) == 0
+
+    def test_delta_frames(self, db_exists):
+        data = dataset.TtyrecDataset("basictest", seq_length=300, batch_size=1)
+        mb = next(iter(data))
+        chars, colors = mb["tty_chars"][0], mb["tty_colors"][0]
+
+        frames = framecache.DeltaFrames(chars, colors, keyframe_interval=16)
+        assert len(frames) == len(chars)
+        assert frames.nbytes < chars.nbytes / 4
+
+        for start, stop in [(0, 300), (1, 2), (15, 17), (100, 250)]:
+            c, o = frames.decode(start, stop)
+            np.testing.assert_array_equal(c, chars[start:stop])
+            np.testing.assert_array_equal(o, colors[start:stop])
+
+        # Corrupt input: the data cut short, and a delta frame with no
+        # keyframe before it.
+        data, offsets = frames.data, frames.offsets
+        frames.data = data[: offsets[250]]
+        with pytest.raises(ValueError):
+            frames.decode(240, 260)
+        frames.data = data
+        keyframes = [data[o] == data[o + 1] == 0xFF for o in offsets]
+        frames.offsets = offsets[keyframes.index(False) :]
+        with pytest.raises(ValueError):
+            frames.decode(0, 1)
+
+    @pytest.mark.parametrize("prefetch", [0, 2])
+    def test_game_index(self, db_exists, tmpdir, prefetch):
+        data = dataset.TtyrecDataset("basictest", **ONE_GAME_PER_ROW)
+        expected = _collect(data)
+
+        filename = str(tmpdir.join("games.idx"))
+        index = gameindex.write(filename, "basictest")
+        assert len(index) == 7
+        assert 8 not in index
+        np.testing.assert_array_equal(index.gameids(), range(1, 8))
+        points = index.column("points")
+        for i, gameid in enumerate(range(1, 8)):
+            assert index.get_paths(gameid) == data.get_paths(gameid)
+            assert points[i] == data.get_meta(gameid)["points"]
+        with pytest.raises(KeyError):
+            index.get_paths(8)
+
+        indexed = _collect(
+            dataset.TtyrecDataset(
+                "basictest",
+                game_index=filename,
+                num_threads=2,
+                prefetch=prefetch,
+                **ONE_GAME_PER_ROW,
+            )
+        )
+        _assert_same_minibatches(expected, indexed)
+
     def test_get_ttyrec(self, db_exists, pool):
         data = dataset.TtyrecDataset(
             "basictest",
@@ -6,9 +6,12 @@ import warnings
 
 import numpy as np
 import pytest
+from test_converter import _convert_all
 
 from nle import _pynethack
 from nle import nethack
+from nle.dataset import Converter
+from nle.dataset import ObservationColumns
 
 # MORE + compass directions + long compass directions.
 ACTIONS = [
@@ -32,6 +35,16 @@ ACTIONS = [
 ]
 
 
+def _start_wizard_game(game):
+    # Wizard mode ignores the role in the player name, so get past the
+    # character selection (like NLE's env does) and the welcome message.
+    game.reset()
+    while not game.in_normal_game():
+        game.step(ord(" "))
+    obs, _ = game.step(27)
+    return obs
+
+
 class TestNetHack:
     @pytest.fixture
     def game(self):  # Make sure we close even on test failure.
@@ -132,6 +145,78 @@ class TestNetHack:
         finally:
             game.close()
 
+    def test_xoshiro_rng(self):
+        rngs = ("xoshiro", "xoshiro", "isaac64")
+        games = [nethack.Nethack(copy=True, rng=rng) for rng in rngs]
+        try:
+            obs = []
+            for game in games:
+                game.set_initial_seeds(core=42, disp=666, lgen=7)
+                obs.append([game.reset()])
+                for _ in range(20):
+                    obs[-1].append(game.step(ord("s"))[0])
+                assert game.get_current_seeds() == (42, 666, False, 7)
+            np.testing.assert_equal(obs[0], obs[1])
+            # The same seeds give another game with the default RNG.
+            with pytest.raises(AssertionError):
+                np.testing.assert_equal(obs[0], obs[2])
+        finally:
+            for game in games:
+                game.close()
+
+        with pytest.raises(ValueError, match="Unknown RNG"):
+            nethack.Nethack(rng="mt19937")
+
+    def test_rng_counts(self):
+        counts = []
+        for _ in range(2):
+            game = nethack.Nethack(copy=True)
+            try:
+                game.set_initial_seeds(core=42, disp=666, lgen=7)
+                game.set_rng_counting()
+                game.reset()
+                for _ in range(20):
+                    game.step(ord("s"))
+                counts.append(game.get_rng_counts())
+            finally:
+                game.close()
+
+        draws, calls = counts[0]["draws"], counts[0]["calls"]
+        assert draws[nethack.NLE_RNG_STREAM_CORE] > 0
+        assert draws[nethack.NLE_RNG_STREAM_LGEN] > 0
+        assert calls.sum() == sum(site[3] for site in counts[0]["sites"])
+        assert draws.sum() == sum(site[4] for site in counts[0]["sites"])
+        np.testing.assert_equal(counts[0], counts[1])
+
+    def test_generate_level(self):
+        game = nethack.Nethack(copy=True, level_generator=True)
+        try:
+            game.reset()
+            level0 = game.generate_level(42, dnum=0, dlevel=3)
+            mines = game.generate_level(7, dnum=2, dlevel=2)
+            assert mines["dungeon"] == "The Gnomish Mines"
+            level1 = game.generate_level(42, dnum=0, dlevel=3)
+            assert level0["depth"] == 3
+            assert len(level0["rooms"]) > 0
+            assert (level0["typ"] != 0).any()
+            for key in ("typ", "flags", "roomno", "objects", "monsters"):
+                np.testing.assert_equal(level0[key], level1[key])
+            assert game.generate_level(42, dnum=0, dlevel=99) is None
+        finally:
+            game.close()
+
+    def test_pool_stats(self, game):
+        game.reset()
+        for _ in range(20):
+            game.step(ord("s"))
+        stats = game.get_pool_stats()
+        assert set(stats) == {"monst", "obj", "mextra", "oextra"}
+        for pool in stats.values():
+            assert pool["gets"] - pool["puts"] == pool["live"]
+            assert pool["live"] <= pool["peak"] <= pool["items"]
+        assert stats["obj"]["live"] > 0  # the hero's inventory at least
+        assert stats["monst"]["live"] > 0
+
     def test_set_seed_after_reset(self, game):
         game.reset()
         # Could fail on a system without a good source of randomness:
@@ -139,6 +224,279 @@ class TestNetHack:
         game.set_current_seeds(core=42, disp=666)
         assert game.get_current_seeds() == (42, 666, False, 0)
 
+    def test_level_files_in_memory(self):
+        game = nethack.Nethack(observation_keys=("blstats",), wizard=True, copy=True)
+        try:
+            (blstats,) = _start_wizard_game(game)
+            assert blstats[nethack.NLE_BL_DEPTH] == 1
+            # ^V in wizard mode: level teleport, here to level 3 and back.
+            for depth in (3, 1):
+                for key in (22, ord(str(depth)), ord("\r"), 27, 27):
+                    (blstats,), _ = game.step(key)
+                assert blstats[nethack.NLE_BL_DEPTH] == depth
+            levelfiles = [f for f in os.listdir(game._vardir) if f[-2:] in (".1", ".3")]
+            assert not levelfiles
+        finally:
+            game.close()
+
+    def test_special_levels_after_reset(self):
+        game = nethack.Nethack(observation_keys=("blstats",), wizard=True, copy=True)
+        try:
+            # The Oracle is on one of levels 5-9. Levels loaded in the first
+            # game come from the shared cache in the second.
+            for _ in range(2):
+                _start_wizard_game(game)
+                for depth in range(2, 10):
+                    for key in (22, ord(str(depth)), ord("\r"), 27, 27):
+                        (blstats,), _ = game.step(key)
+                    assert blstats[nethack.NLE_BL_DEPTH] == depth
+        finally:
+            game.close()
+
+    def _play_timers(self):
+        # Wishes for objects with timers, drops one of each on the upstairs,
+        # goes down a level and back (saving and restoring the timers of the
+        # dropped ones with the level) and waits until all have fired.
+        keys = ("glyphs", "blstats", "message", "inv_strs", "tty_chars")
+        wishes = ("lit wax candle", "jackal corpse", "cave spider egg")
+        game = nethack.Nethack(
+            observation_keys=keys, wizard=True, spawn_monsters=False, copy=True
+        )
+        steps = []
+
+        def send(chars):
+            for c in chars:
+                ob, done = game.step(ord(c))
+                assert not done
+                steps.append(ob)
+            return ob
+
+        def wish(item):
+            # ^W; the message starts with the item's inventory letter.
+            message = send("\x17%s\r" % item)[2]
+            send("\x1b")
+            return chr(message[0])
+
+        def screen():
+            return bytes(steps[-1][4]).decode("ascii")
+
+        try:
+            game.set_initial_seeds(core=10, disp=666)
+            steps.append(game.reset())
+            while not game.in_normal_game():  # Character selection.
+                send(" ")
+            for letter in [wish(item) for item in wishes]:
+                send("d" + letter)
+            for item in wishes:
+                wish(item)
+            # ^V to level 2 and back, then ^T onto the upstairs.
+            send("\x162\r\x1b\x1b\x161\r\x1b\x1b\x14<.")
+            send(":")
+            here = screen()
+            send("\x1b")
+            while steps[-1][1][nethack.NLE_BL_TIME] < 1000:
+                send("\x1b20s")  # Search for 20 turns.
+            send("\x1b:")
+            inventory = [bytes(s).decode("ascii") for s in steps[-1][3]]
+            return steps, here, screen(), "".join(inventory)
+        finally:
+            game.close()
+
+    def test_timers(self):
+        steps, here, there, inventory = self._play_timers()
+        for item in ("candle", "jackal corpse", "an egg"):
+            # Still there after the level was saved and restored, and gone
+            # (burnt out, rotted away, hatched) later, as are the carried ones.
+            assert item in here
+            assert item not in there
+            assert item not in inventory
+        np.testing.assert_equal(steps, self._play_timers()[0])
+
+    def test_ttyrec_logical_time(self, tmpdir):
+        ttyrec = str(tmpdir.join("logical.ttyrec3.bz2"))
+        game = nethack.Nethack(
+            observation_keys=("blstats",), ttyrec=ttyrec, ttyrec_logical_time=True
+        )
+        try:
+            game.reset()
+            steps = 0
+            for _ in range(20):
+                _, done = game.step(random.choice(ACTIONS))
+                steps += 1
+                if done:
+                    break
+        finally:
+            game.close()
+
+        converter = Converter(25, 80, nethack.TTYREC_VERSION)
+        converter.load_ttyrec(ttyrec)
+        remaining, _, _, _, timestamps, _, _ = _convert_all(converter, steps + 1)
+        # One frame per action, stamped with its (1-based) step index.
+        assert remaining == 1
+        np.testing.assert_equal(timestamps[:steps], np.arange(1, steps + 1) * 10**6)
+
+    def test_replay(self, tmpdir):
+        path = str(tmpdir.join("episode.nlereplay"))
+        keys = ("glyphs", "blstats")
+        game = nethack.Nethack(observation_keys=keys, copy=True)
+        try:
+            game.set_replay(path)
+            game.set_initial_seeds(core=42, disp=666)
+            obs = [game.reset()]
+            actions = []
+            for _ in range(100):
+                actions.append(random.choice(ACTIONS))
+                ob, done = game.step(actions[-1])
+                if done:
+                    break
+                obs.append(ob)
+            game.set_replay(None)
+            game.reset()  # Closes the replay file.
+        finally:
+            game.close()
+
+        (replayed,) = nethack.replay([path], observation_keys=keys)
+        np.testing.assert_equal(replayed["actions"], actions)
+        assert len(replayed["glyphs"]) == len(actions)
+        for i, key in enumerate(keys):
+            expected = [o[i] for o in obs[: len(actions)]]
+            np.testing.assert_equal(replayed[key], expected)
+
+    def test_replay_ttyrecs(self, tmpdir):
+        ttyrec = str(tmpdir.join("seeded.ttyrec3.bz2"))
+        keys = ("glyphs", "blstats", "inv_letters")
+        game = nethack.Nethack(observation_keys=keys, ttyrec=ttyrec, copy=True)
+        episodes = []
+        try:
+            for seed in (42, 43):  # Two games in one ttyrec.
+                game.set_initial_seeds(core=seed, disp=666)
+                obs, actions = [game.reset()], []
+                for _ in range(50):
+                    actions.append(random.choice(ACTIONS))
+                    ob, done = game.step(actions[-1])
+                    if done:
+                        break
+                    obs.append(ob)
+                episodes.append((obs, actions))
+        finally:
+            game.close()
+
+        replayed = nethack.replay_ttyrecs([ttyrec], observation_keys=keys)
+        assert len(replayed) == 2
+        for episode, (obs, actions) in zip(replayed, episodes):
+            np.testing.assert_equal(episode["actions"], actions)
+            for i, key in enumerate(keys):
+                expected = [o[i] for o in obs[: len(actions)]]
+                np.testing.assert_equal(episode[key], expected)
+
+        # The seeds don't show up as frames.
+        converter = Converter(25, 80, nethack.TTYREC_VERSION)
+        converter.load_ttyrec(ttyrec)
+        actions = _convert_all(converter, 200)[5]
+        n = len(episodes[0][1])
+        np.testing.assert_equal(actions[:n], episodes[0][1])
+
+    def test_replay_ttyrecs_reseeding(self, tmpdir):
+        ttyrec = str(tmpdir.join("reseeding.ttyrec3.bz2"))
+        game = nethack.Nethack(ttyrec=ttyrec, copy=True)
+        try:
+            game.set_initial_seeds(core=42, disp=666, reseed=True)
+            game.reset()
+            game.step(random.choice(ACTIONS))
+        finally:
+            game.close()
+
+        with pytest.raises(ValueError, match="reseeding"):
+            nethack.replay_ttyrecs([ttyrec])
+
+    def test_ttyrec_leaves_game_alone(self, tmpdir):
+        # Recording a ttyrec must not change the game, e.g. its clock.
+        actions = [random.choice(ACTIONS) for _ in range(300)]
+        episodes = []
+        for ttyrec in (str(tmpdir.join("game.ttyrec3.bz2")), None):
+            game = nethack.Nethack(ttyrec=ttyrec, copy=True)
+            try:
+                game.set_initial_seeds(core=42, disp=666)
+                obs = [game.reset()]
+                for action in actions:
+                    ob, done = game.step(action)
+                    obs.append(ob)
+                    if done:
+                        break
+            finally:
+                game.close()
+            episodes.append(obs)
+
+        with_ttyrec, without_ttyrec = episodes
+        assert len(with_ttyrec) == len(without_ttyrec)
+        for a, b in zip(with_ttyrec, without_ttyrec):
+            for key, x, y in zip(nethack.OBSERVATION_DESC, a, b):
+                np.testing.assert_equal(x, y, err_msg=key)
+
+    def test_map_without_tty(self, tmpdir):
+        # Without a ttyrec and tty_* observations, the map observations are
+        # updated without drawing the map (see flush_screen in display.c).
+        keys = ("glyphs", "chars", "colors", "specials", "screen_descriptions")
+        tty_keys = ("tty_chars", "tty_colors", "tty_cursor")
+        actions = [random.choice(ACTIONS) for _ in range(300)]
+        episodes = []
+        for ttyrec, extra_keys in (
+            (str(tmpdir.join("game.ttyrec3.bz2")), tty_keys),
+            (None, ()),
+        ):
+            game = nethack.Nethack(
+                observation_keys=keys + extra_keys, ttyrec=ttyrec, copy=True
+            )
+            try:
+                game.set_initial_seeds(core=42, disp=666)
+                obs = [game.reset()[: len(keys)]]
+                for action in actions:
+                    ob, done = game.step(action)
+                    obs.append(ob[: len(keys)])
+                    if done:
+                        break
+            finally:
+                game.close()
+            episodes.append(obs)
+
+        with_tty, without_tty = episodes
+        assert len(with_tty) == len(without_tty)
+        for a, b in zip(with_tty, without_tty):
+            for key, x, y in zip(keys, a, b):
+                np.testing.assert_equal(x, y, err_msg=key)
+
+    def test_record_observations(self, tmpdir):
+        path = str(tmpdir.join("episode.nleobs"))
+        game = nethack.Nethack(observation_keys=("glyphs", "blstats"), copy=True)
+        try:
+            game.record_observations(path, chunk_frames=16)
+            obs, actions, dones = [game.reset()], [-1], [False]
+            for _ in range(50):
+                actions.append(random.choice(ACTIONS))
+                ob, done = game.step(actions[-1])
+                obs.append(ob)
+                dones.append(done)
+                if done:
+                    break
+            game.record_observations(None)
+        finally:
+            game.close()
+
+        columns = ObservationColumns(path)
+        assert sorted(columns.keys()) == ["actions", "blstats", "done", "glyphs"]
+        assert len(columns) == len(obs)
+        assert columns.num_chunks == (len(obs) + 15) // 16
+        np.testing.assert_equal(columns.read("glyphs"), [o[0] for o in obs])
+        np.testing.assert_equal(columns.read("blstats"), [o[1] for o in obs])
+        np.testing.assert_equal(columns.read("actions"), actions)
+        np.testing.assert_equal(columns.read("done"), dones)
+        # Slices across chunk boundaries.
+        np.testing.assert_equal(
+            columns.read("glyphs", 10, 20), [o[0] for o in obs[10:20]]
+        )
+        with pytest.raises(KeyError):
+            columns.read("chars")
+
 
 class TestNetHackFurther:
     def test_run(self):
@@ -1,11 +1,16 @@
+import bz2
 import json
+import os
 
 import pytest  # NOQA: F401
+from test_converter import _convert_all
 from test_converter import getfilename
 from test_db import conn  # NOQA: F401
 from test_db import mockdata  # NOQA: F401
 
 from nle import nethack
+from nle.dataset import Converter
+from nle.dataset import populate_db
 
 TTYRECS_TABLE_OFFSET = 0
 GAMES_TABLE_OFFSET = 5
@@ -104,3 +109,29 @@ class TestPopulateDB:
             assert actual[TTYREC_VERSION_IDX] == nethack.TTYREC_VERSION
 
         assert paths == sorted(paths)
+
+    def test_ttyrec_stats(self, conn):  # NOQA: F811
+        populate_db.add_ttyrec_stats("basictest", num_threads=3)
+
+        cmd = """
+        SELECT ttyrec_stats.*, roots.root FROM ttyrec_stats
+        INNER JOIN datasets ON ttyrec_stats.gameid=datasets.gameid
+        INNER JOIN roots ON roots.dataset_name=datasets.dataset_name
+        WHERE datasets.dataset_name='basictest'
+        """
+        result = conn.execute(cmd).fetchall()
+        assert len(result) == 9
+
+        for row in result:
+            path, root = row[0], row[-1]
+            frames, actions, rewards, records, first, last, size = row[3:10]
+            # Version 1 ttyrecs have a frame per record, and no channels.
+            assert actions == rewards == 0
+            assert frames == records
+
+            converter = Converter(24, 80, 1)
+            converter.load_ttyrec(os.path.join(root, path))
+            remaining, _, _, _, timestamps, _, _ = _convert_all(converter, frames + 1)
+            assert remaining == 1
+            assert (first, last) == (timestamps[0], timestamps[frames - 1])
+            assert 0 < size <= len(bz2.open(os.path.join(root, path)).read())
@@ -123,6 +123,10 @@
  */
 #include "hack.h"
 
+/* NLE: flush_screen() without terminal output, see winrl.cc */
+extern boolean NDECL(nle_tty_wanted);
+extern void FDECL(rl_print_glyph_row, (int, int, int, const int *));
+
 STATIC_DCL void FDECL(show_mon_or_warn, (int, int, int));
 STATIC_DCL void FDECL(display_monster,
                       (XCHAR_P, XCHAR_P, struct monst *, int, XCHAR_P));
@@ -1659,14 +1663,34 @@ int cursor_on_u;
         return;
 #endif
 
-    for (y = 0; y < ROWNO; y++) {
-        register gbuf_entry *gptr = &gbuf[y][x = gbuf_start[y]];
+    if (WINDOWPORT("rl") && !nle_tty_wanted()) {
+        /* NLE: nobody reads the terminal, so don't draw on it; winrl gets
+           each row's changed stretch at once instead, NO_GLYPH where a
+           position didn't change. */
+        int row[COLNO], start, stop;
 
-        for (; x <= gbuf_stop[y]; gptr++, x++)
-            if (gptr->new) {
-                print_glyph(WIN_MAP, x, y, gptr->glyph, get_bk_glyph(x, y));
+        for (y = 0; y < ROWNO; y++) {
+            register gbuf_entry *gptr = &gbuf[y][start = gbuf_start[y]];
+
+            if (start > (stop = gbuf_stop[y]))
+                continue;
+            for (x = start; x <= stop; gptr++, x++) {
+                row[x] = gptr->new ? gptr->glyph : NO_GLYPH;
                 gptr->new = 0;
             }
+            rl_print_glyph_row(y, start, stop, &row[start]);
+        }
+    } else {
+        for (y = 0; y < ROWNO; y++) {
+            register gbuf_entry *gptr = &gbuf[y][x = gbuf_start[y]];
+
+            for (; x <= gbuf_stop[y]; gptr++, x++)
+                if (gptr->new) {
+                    print_glyph(WIN_MAP, x, y, gptr->glyph,
+                                get_bk_glyph(x, y));
+                    gptr->new = 0;
+                }
+        }
     }
 
     if (cursor_on_u)
@@ -12,6 +12,11 @@
 #include <string.h>
 #endif
 
+#ifdef DLBMMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #define DATAPREFIX 4
 
 #if defined(OVERLAY)
@@ -68,7 +73,23 @@ extern FILE *FDECL(fopen_datafile, (const char *, const char *, int));
 #define MAX_LIBS 4
 static library dlb_libs[MAX_LIBS];
 
+#ifdef DLBMMAP
+#define lib_is_open(lp) ((lp)->data != 0)
+#define lib_open map_library
+#define lib_close unmap_library
+#else
+#define lib_is_open(lp) ((lp)->fdata != 0)
+#define lib_open open_library
+#define lib_close close_library
+#endif
+
 STATIC_DCL boolean FDECL(readlibdir, (library * lp));
+#ifdef DLBMMAP
+STATIC_DCL unsigned FDECL(hash_fname, (const char *));
+STATIC_DCL void FDECL(index_libdir, (library *));
+STATIC_DCL boolean FDECL(map_library, (const char *, library *));
+STATIC_DCL void FDECL(unmap_library, (library *));
+#endif
 STATIC_DCL boolean FDECL(find_file, (const char *name, library **lib,
                                      long *startp, long *sizep));
 STATIC_DCL boolean NDECL(lib_dlb_init);
@@ -87,6 +108,11 @@ void FDECL(close_library, (library * lp));
 
 /* without extern.h via hack.h, these haven't been declared for us */
 extern char *FDECL(eos, (char *));
+#ifdef DLBMMAP
+/* libraries shared by the games of a process, see nle.c */
+extern genericptr_t FDECL(nle_dlb_lookup, (int));
+extern genericptr_t FDECL(nle_dlb_insert, (int, genericptr_t));
+#endif
 
 /*
  * Read the directory out of the library.  Return 1 if successful,
@@ -188,8 +214,21 @@ long *startp, *sizep;
     int i, j;
     library *lp;
 
-    for (i = 0; i < MAX_LIBS && dlb_libs[i].fdata; i++) {
+    for (i = 0; i < MAX_LIBS && lib_is_open(&dlb_libs[i]); i++) {
         lp = &dlb_libs[i];
+#ifdef DLBMMAP
+        for (j = hash_fname(name) & (lp->hashsize - 1); lp->hashtab[j] >= 0;
+             j = (j + 1) & (lp->hashsize - 1)) {
+            libdir *dp = &lp->dir[lp->hashtab[j]];
+
+            if (FILENAME_CMP(name, dp->fname) == 0) {
+                *lib = lp;
+                *startp = dp->foffset;
+                *sizep = dp->fsize;
+                return TRUE;
+            }
+        }
+#else
         for (j = 0; j < lp->nentries; j++) {
             if (FILENAME_CMP(name, lp->dir[j].fname) == 0) {
                 *lib = lp;
@@ -198,6 +237,7 @@ long *startp, *sizep;
                 return TRUE;
             }
         }
+#endif
     }
     *lib = (library *) 0;
     *startp = *sizep = 0;
@@ -238,9 +278,117 @@ library *lp;
     (void) memset((char *) lp, 0, sizeof(library));
 }
 
+#ifdef DLBMMAP
+STATIC_OVL unsigned
+hash_fname(name)
+const char *name;
+{
+    unsigned h = 2166136261U; /* FNV-1a */
+
+    while (*name)
+        h = (h ^ (unsigned char) *name++) * 16777619U;
+    return h;
+}
+
+/* Build the open addressing table find_file() uses for lookups. */
+STATIC_OVL void
+index_libdir(lp)
+library *lp;
+{
+    int i, j;
+
+    for (lp->hashsize = 16; lp->hashsize < 2 * lp->nentries;)
+        lp->hashsize *= 2;
+    lp->hashtab = (int *) alloc(lp->hashsize * sizeof(int));
+    for (i = 0; i < lp->hashsize; i++)
+        lp->hashtab[i] = -1;
+    for (i = 0; i < lp->nentries; i++) {
+        for (j = hash_fname(lp->dir[i].fname) & (lp->hashsize - 1);
+             lp->hashtab[j] >= 0; j = (j + 1) & (lp->hashsize - 1))
+            continue;
+        lp->hashtab[j] = i;
+    }
+}
+
+/*
+ * Map the library read-only and index its directory.  None of it changes
+ * afterwards, so the first game of a process to get here hands it to
+ * nle_dlb_insert() and later ones, including those after a reset, get it
+ * back from nle_dlb_lookup() without reading anything.  The mapped pages
+ * are shared with other processes through the page cache.
+ */
+STATIC_OVL boolean
+map_library(lib_name, lp)
+const char *lib_name;
+library *lp;
+{
+    FILE *fp;
+    library *shared, *cached;
+    struct stat st;
+    genericptr_t data = MAP_FAILED;
+    int i;
+
+    if (!(fp = fopen_datafile(lib_name, RDBMODE, DATAPREFIX)))
+        return FALSE;
+    if ((shared = (library *) nle_dlb_lookup(fileno(fp))) != 0) {
+        (void) fclose(fp);
+        *lp = *shared;
+        return TRUE;
+    }
+
+    lp->fdata = fp;
+    if (readlibdir(lp) && !fstat(fileno(fp), &st)) {
+        for (i = 0; i < lp->nentries; i++)
+            if (lp->dir[i].foffset < 0 || lp->dir[i].fsize < 0
+                || lp->dir[i].foffset + lp->dir[i].fsize > st.st_size)
+                break;
+        if (i == lp->nentries && st.st_size > 0)
+            data = mmap((genericptr_t) 0, (size_t) st.st_size, PROT_READ,
+                        MAP_SHARED, fileno(fp), (off_t) 0);
+    }
+    if (data == MAP_FAILED) {
+        close_library(lp);
+        return FALSE;
+    }
+    lp->data = (const char *) data;
+    lp->datasize = (long) st.st_size;
+    index_libdir(lp);
+    lp->fdata = (FILE *) 0;
+
+    shared = (library *) alloc(sizeof(library));
+    *shared = *lp;
+    shared->shared = TRUE;
+    cached = (library *) nle_dlb_insert(fileno(fp), (genericptr_t) shared);
+    (void) fclose(fp);
+    if (cached == shared) {
+        lp->shared = TRUE;
+    } else {
+        free((genericptr_t) shared);
+        if (cached) { /* another game mapped it first */
+            unmap_library(lp);
+            *lp = *cached;
+        }
+    }
+    return TRUE;
+}
+
+STATIC_OVL void
+unmap_library(lp)
+library *lp;
+{
+    if (!lp->shared) {
+        (void) munmap((genericptr_t) lp->data, (size_t) lp->datasize);
+        free((genericptr_t) lp->dir);
+        free((genericptr_t) lp->sspace);
+        free((genericptr_t) lp->hashtab);
+    }
+    (void) memset((char *) lp, 0, sizeof(library));
+}
+#endif /* DLBMMAP */
+
 /*
  * Open the library file once using stdio.  Keep it open, but
- * keep track of the file position.
+ * keep track of the file position.  Or, with DLBMMAP, map it.
  */
 STATIC_OVL boolean
 lib_dlb_init(VOID_ARGS)
@@ -251,11 +399,11 @@ lib_dlb_init(VOID_ARGS)
     build_dlb_filename((const char *) 0);
 #endif
     /* To open more than one library, add open library calls here. */
-    if (!open_library(DLBFILE, &dlb_libs[0]))
+    if (!lib_open(DLBFILE, &dlb_libs[0]))
         return FALSE;
 #ifdef DLBFILE2
-    if (!open_library(DLBFILE2, &dlb_libs[1])) {
-        close_library(&dlb_libs[0]);
+    if (!lib_open(DLBFILE2, &dlb_libs[1])) {
+        lib_close(&dlb_libs[0]);
         return FALSE;
     }
 #endif
@@ -268,8 +416,8 @@ lib_dlb_cleanup(VOID_ARGS)
     int i;
 
     /* close the data file(s) */
-    for (i = 0; i < MAX_LIBS && dlb_libs[i].fdata; i++)
-        close_library(&dlb_libs[i]);
+    for (i = 0; i < MAX_LIBS && lib_is_open(&dlb_libs[i]); i++)
+        lib_close(&dlb_libs[i]);
 }
 
 #ifdef VERSION_IN_DLB_FILENAME
@@ -320,7 +468,11 @@ char *buf;
 int size, quan;
 dlb *dp;
 {
+#ifdef DLBMMAP
+    long nbytes;
+#else
     long pos, nread, nbytes;
+#endif
 
     /* make sure we don't read into the next file */
     if ((dp->size - dp->mark) < (size * quan))
@@ -328,6 +480,12 @@ dlb *dp;
     if (quan == 0)
         return 0;
 
+#ifdef DLBMMAP
+    nbytes = (long) size * quan;
+    (void) memcpy(buf, dp->lib->data + dp->start + dp->mark, (size_t) nbytes);
+    dp->mark += nbytes;
+    return quan;
+#else
     pos = dp->start + dp->mark;
     if (dp->lib->fmark != pos) {
         fseek(dp->lib->fdata, pos, SEEK_SET); /* check for error??? */
@@ -340,6 +498,7 @@ dlb *dp;
     dp->lib->fmark += nbytes;
 
     return nread;
+#endif
 }
 
 STATIC_OVL int
@@ -377,7 +536,11 @@ int len;
 dlb *dp;
 {
     int i;
+#ifdef DLBMMAP
+    const char *p, *nl;
+#else
     char *bp, c = 0;
+#endif
 
     if (len <= 0)
         return buf; /* sanity check */
@@ -387,6 +550,15 @@ dlb *dp;
         return (char *) 0;
 
     len--; /* save room for null */
+#ifdef DLBMMAP
+    p = dp->lib->data + dp->start + dp->mark;
+    i = (dp->size - dp->mark < len) ? (int) (dp->size - dp->mark) : len;
+    if ((nl = (const char *) memchr(p, '\n', (size_t) i)) != 0)
+        i = (int) (nl - p) + 1;
+    (void) memcpy(buf, p, (size_t) i);
+    buf[i] = '\0';
+    dp->mark += i;
+#else
     for (i = 0, bp = buf; i < len && dp->mark < dp->size && c != '\n';
          i++, bp++) {
         if (dlb_fread(bp, 1, 1, dp) <= 0)
@@ -394,6 +566,7 @@ dlb *dp;
         c = *bp;
     }
     *bp = '\0';
+#endif
 
 #if defined(MSDOS) || defined(WIN32)
     if ((bp = index(buf, '\r')) != 0) {
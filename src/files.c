@@ -476,6 +476,104 @@ set_lock_and_bones()
 }
 #endif /* MFLOPPY */
 
+#ifdef MEMORY_LEVELFILES
+/*
+ * Level files as growable memory buffers, one per ledger number: leaving a
+ * level bwrite()s it into its buffer and coming back mread()s it out again,
+ * without touching the file system. The descriptors create_levelfile() and
+ * open_levelfile() return for them lie far above any real one; nhwrite(),
+ * nhread() and nhclose() recognize them. A buffer keeps its allocation
+ * when the level is rewritten.
+ */
+#define MEMLEVEL_FD0 0x40000000
+#define MEMLEVEL_FD(lev) (MEMLEVEL_FD0 + (lev))
+
+static struct memlevel {
+    char *data;
+    unsigned len, size;
+    unsigned pos; /* read position */
+} memlevels[MAXLINFO];
+
+STATIC_OVL struct memlevel *
+memlevel(fd)
+int fd;
+{
+    if (fd < MEMLEVEL_FD0 || fd >= MEMLEVEL_FD(MAXLINFO))
+        return (struct memlevel *) 0;
+    return &memlevels[fd - MEMLEVEL_FD0];
+}
+
+void
+free_levelfiles()
+{
+    int lev;
+
+    for (lev = 0; lev < MAXLINFO; lev++) {
+        if (memlevels[lev].data)
+            free((genericptr_t) memlevels[lev].data);
+        memlevels[lev].data = (char *) 0;
+        memlevels[lev].len = memlevels[lev].size = memlevels[lev].pos = 0;
+    }
+}
+
+/* is fd a level file kept in memory? */
+boolean
+memlevel_fd(fd)
+int fd;
+{
+    return (boolean) (memlevel(fd) != 0);
+}
+#endif /* MEMORY_LEVELFILES */
+
+/* write() that knows about level files kept in memory */
+int
+nhwrite(fd, buf, len)
+int fd;
+genericptr_t buf;
+unsigned len;
+{
+#ifdef MEMORY_LEVELFILES
+    struct memlevel *ml = memlevel(fd);
+
+    if (ml) {
+        if (len > ml->size - ml->len) {
+            unsigned size = max(2 * ml->size, ml->len + len);
+            char *data;
+
+            size = max(size, 4 * BUFSZ);
+            if (!(data = (char *) realloc((genericptr_t) ml->data, size)))
+                return -1;
+            ml->data = data;
+            ml->size = size;
+        }
+        (void) memcpy((genericptr_t) (ml->data + ml->len), buf, len);
+        ml->len += len;
+        return (int) len;
+    }
+#endif
+    return (int) write(fd, buf, len);
+}
+
+/* read() that knows about level files kept in memory */
+int
+nhread(fd, buf, len)
+int fd;
+genericptr_t buf;
+unsigned len;
+{
+#ifdef MEMORY_LEVELFILES
+    struct memlevel *ml = memlevel(fd);
+
+    if (ml) {
+        len = min(len, ml->len - ml->pos);
+        (void) memcpy(buf, (genericptr_t) (ml->data + ml->pos), len);
+        ml->pos += len;
+        return (int) len;
+    }
+#endif
+    return (int) read(fd, buf, len);
+}
+
 /* Construct a file name for a level-type file, which is of the form
  * something.level (with any old level stripped off).
  * This assumes there is space on the end of 'file' to append
@@ -509,6 +607,11 @@ char errbuf[];
 
     if (errbuf)
         *errbuf = '\0';
+#ifdef MEMORY_LEVELFILES
+    memlevels[lev].len = memlevels[lev].pos = 0;
+    level_info[lev].flags |= LFILE_EXISTS;
+    return MEMLEVEL_FD(lev);
+#endif
     set_levelfile_name(lock, lev);
     fq_lock = fqname(lock, LEVELPREFIX, 0);
 
@@ -550,6 +653,15 @@ char errbuf[];
 
     if (errbuf)
         *errbuf = '\0';
+#ifdef MEMORY_LEVELFILES
+    if (!(level_info[lev].flags & LFILE_EXISTS)) {
+        if (errbuf)
+            Sprintf(errbuf, "No level file for level %d.", lev);
+        return -1;
+    }
+    memlevels[lev].pos = 0;
+    return MEMLEVEL_FD(lev);
+#endif
     set_levelfile_name(lock, lev);
     fq_lock = fqname(lock, LEVELPREFIX, 0);
 #ifdef MFLOPPY
@@ -586,6 +698,15 @@ int lev;
      * Level 0 might be created by port specific code that doesn't
      * call create_levfile(), so always assume that it exists.
      */
+#ifdef MEMORY_LEVELFILES
+    if (memlevels[lev].data)
+        free((genericptr_t) memlevels[lev].data);
+    memlevels[lev].data = (char *) 0;
+    memlevels[lev].len = memlevels[lev].size = memlevels[lev].pos = 0;
+    level_info[lev].flags &= ~LFILE_EXISTS;
+    if (lev != 0)
+        return;
+#endif
     if (lev == 0 || (level_info[lev].flags & LFILE_EXISTS)) {
         set_levelfile_name(lock, lev);
 #ifdef HOLD_LOCKFILE_OPEN
@@ -698,6 +819,10 @@ int
 nhclose(fd)
 int fd;
 {
+#ifdef MEMORY_LEVELFILES
+    if (memlevel(fd))
+        return 0;
+#endif
     if (lftrack.fd == fd) {
         really_close(); /* close it, but reopen it to hold it */
         fd = open_levelfile(0, (char *) 0);
@@ -712,6 +837,10 @@ int
 nhclose(fd)
 int fd;
 {
+#ifdef MEMORY_LEVELFILES
+    if (memlevel(fd))
+        return 0;
+#endif
     return close(fd);
 }
 #endif /* ?HOLD_LOCKFILE_OPEN */
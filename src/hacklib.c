@@ -6,6 +6,7 @@
 /* NetHack may be freely redistributed.  See license for details. */
 
 #include "hack.h" /* for config.h+extern.h */
+#include "nletypes.h" /* NLE: nle_settings */
 /*=
     Assorted 'small' utility routines.  They're virtually independent of
     NetHack, except that rounddiv may call panic().  setrandom calls one
@@ -851,6 +852,11 @@ extern struct tm *FDECL(localtime, (time_t *));
 #endif
 STATIC_DCL struct tm *NDECL(getlt);
 
+/* NLE: the clock of recorded games, see nle_clock_frozen in nle.c */
+extern nle_settings settings;
+extern boolean NDECL(nle_clock_frozen);
+extern void FDECL(nle_clock_observed, (time_t, struct tm *));
+
 /* NLE hack for seeds. Should stay in sync with rnglist in src/rnd.c.
    plus one other RNG seed for level generation. See nlernd.c */
 extern unsigned long nle_seeds[];
@@ -919,6 +925,8 @@ getnow()
 {
     time_t datetime = 0;
 
+    if (settings.fixed_time) /* NLE */
+        return (time_t) settings.fixed_time;
     (void) time((TIME_type) &datetime);
     return datetime;
 }
@@ -927,8 +935,24 @@ STATIC_OVL struct tm *
 getlt()
 {
     time_t date = getnow();
+    struct tm *lt;
 
-    return localtime((LOCALTIME_type) &date);
+    /* NLE: a fixed clock (re-simulating a recorded game) is in the time
+       zone it was recorded in, not the local one. */
+    if (settings.fixed_time) {
+        date += settings.fixed_utc_offset;
+        return gmtime((LOCALTIME_type) &date);
+    }
+    /* NLE: moon phase, night and the like stay as they were when a game
+       recorded to a replay file started, in UTC, so that re-simulating it
+       later or elsewhere gives the same game. */
+    if (nle_clock_frozen() && ubirthday) {
+        date = ubirthday;
+        return gmtime((LOCALTIME_type) &date);
+    }
+    lt = localtime((LOCALTIME_type) &date);
+    nle_clock_observed(date, lt); /* NLE: ttyrecs record it */
+    return lt;
 }
 
 int
@@ -25,12 +25,10 @@
  * The major working function is do_light_sources(). It is called
  * when the vision system is recreating its "could see" array.  Here
  * we add a flag (TEMP_LIT) to the array for all locations that are lit
- * via a light source.  The bad part of this is that we have to
- * re-calculate the LOS of each light source every time the vision
- * system runs.  Even if the light sources and any topology (vision blocking
- * positions) have not changed.  The good part is that no extra memory
- * is used, plus we don't have to figure out how far the sources have moved,
- * or if the topology has changed.
+ * via a light source.  Each source remembers the area it lit the last
+ * time around, so the LOS of a source is only re-calculated after it has
+ * moved, its range has changed, or a vision blocking position within its
+ * range has changed [forget_lit_areas(), called by the vision system].
  *
  * The structure of the save/restore mechanism is amazingly similar to
  * the timer save/restore.  This is because they both have the same
@@ -42,8 +40,27 @@
 #define LSF_SHOW 0x1        /* display the light source */
 #define LSF_NEEDS_FIXUP 0x2 /* need oid fixup */
 
+/*
+ * Light sources are allocated with room for the area they lit, centered
+ * on the source.  The light_source inside a node is still exactly what
+ * save files hold.
+ */
+#define LS_SPAN (2 * MAX_RADIUS + 1)
+
+typedef struct ls_node {
+    light_source ls;            /* must be first */
+    xchar lit_x, lit_y;         /* where lit[][] was worked out */
+    short lit_range;            /* range it was worked out for; 0: stale */
+    char lit[LS_SPAN][LS_SPAN]; /* TEMP_LIT or 0 */
+} ls_node;
+
+#define ls_node_of(ls) ((ls_node *) (ls))
+
 static light_source *light_base = 0;
 
+STATIC_DCL light_source *NDECL(alloc_ls);
+STATIC_DCL void FDECL(find_lit_area, (light_source *));
+STATIC_DCL void FDECL(or_lit_row, (char *, const char *, int));
 STATIC_DCL void FDECL(write_ls, (int, light_source *));
 STATIC_DCL int FDECL(maybe_write_ls, (int, int, BOOLEAN_P));
 
@@ -51,6 +68,16 @@ STATIC_DCL int FDECL(maybe_write_ls, (int, int, BOOLEAN_P));
 extern char circle_data[];
 extern char circle_start[];
 
+/* Allocate a light source whose lit area has yet to be worked out. */
+STATIC_OVL light_source *
+alloc_ls()
+{
+    ls_node *ln = (ls_node *) alloc(sizeof (ls_node));
+
+    (void) memset((genericptr_t) ln, 0, sizeof (ls_node));
+    return &ln->ls;
+}
+
 /* Create a new light source.  */
 void
 new_light_source(x, y, range, type, id)
@@ -65,7 +92,7 @@ anything *id;
         return;
     }
 
-    ls = (light_source *) alloc(sizeof *ls);
+    ls = alloc_ls();
 
     ls->next = light_base;
     ls->x = x;
@@ -126,6 +153,87 @@ anything *id;
                fmt_ptr((genericptr_t) id->a_obj));
 }
 
+/*
+ * Work out which locations within range of a light source have a clear
+ * path to it, unless what was worked out last time still holds.
+ */
+STATIC_OVL void
+find_lit_area(ls)
+light_source *ls;
+{
+    ls_node *ln = ls_node_of(ls);
+    int x, y, min_x, max_x, max_y, offset;
+    char *limits;
+
+    if (ln->lit_range == ls->range && ln->lit_x == ls->x
+        && ln->lit_y == ls->y)
+        return;
+
+    (void) memset((genericptr_t) ln->lit, 0, sizeof ln->lit);
+    limits = circle_ptr(ls->range);
+    if ((max_y = (ls->y + ls->range)) >= ROWNO)
+        max_y = ROWNO - 1;
+    if ((y = (ls->y - ls->range)) < 0)
+        y = 0;
+    for (; y <= max_y; y++) {
+        offset = limits[abs(y - ls->y)];
+        if ((min_x = (ls->x - offset)) < 0)
+            min_x = 0;
+        if ((max_x = (ls->x + offset)) >= COLNO)
+            max_x = COLNO - 1;
+        for (x = min_x; x <= max_x; x++)
+            if ((ls->x == x && ls->y == y)
+                || clear_path((int) ls->x, (int) ls->y, x, y))
+                ln->lit[y - ls->y + MAX_RADIUS][x - ls->x + MAX_RADIUS] =
+                    TEMP_LIT;
+    }
+    ln->lit_x = ls->x;
+    ln->lit_y = ls->y;
+    ln->lit_range = ls->range;
+}
+
+/* OR n lit-area bytes into a row of the "could see" array, a word at a
+   time */
+STATIC_OVL void
+or_lit_row(row, lit, n)
+char *row;
+const char *lit;
+int n;
+{
+    unsigned long w, l;
+
+    for (; n >= (int) sizeof w; n -= (int) sizeof w) {
+        (void) memcpy((genericptr_t) &w, (genericptr_t) row, sizeof w);
+        (void) memcpy((genericptr_t) &l, (const genericptr) lit, sizeof l);
+        w |= l;
+        (void) memcpy((genericptr_t) row, (genericptr_t) &w, sizeof w);
+        row += sizeof w;
+        lit += sizeof w;
+    }
+    while (n-- > 0)
+        *row++ |= *lit++;
+}
+
+/*
+ * The terrain at <x,y> has started or stopped blocking light.  Light
+ * sources close enough for that to matter must find their lit area
+ * again; if <x,y> is not on the map, they all must.
+ */
+void
+forget_lit_areas(x, y)
+int x, y;
+{
+    light_source *ls;
+    ls_node *ln;
+
+    for (ls = light_base; ls; ls = ls->next) {
+        ln = ls_node_of(ls);
+        if (!isok(x, y) || (abs(x - ln->lit_x) <= ln->lit_range
+                            && abs(y - ln->lit_y) <= ln->lit_range))
+            ln->lit_range = 0;
+    }
+}
+
 /* Mark locations that are temporarily lit via mobile light sources. */
 void
 do_light_sources(cs_rows)
@@ -141,10 +249,8 @@ char **cs_rows;
         ls->flags &= ~LSF_SHOW;
 
         /*
-         * Check for moved light sources.  It may be possible to
-         * save some effort if an object has not moved, but not in
-         * the current setup -- we need to recalculate for every
-         * vision recalc.
+         * Check for moved light sources.  find_lit_area() compares the
+         * location with the one its lit area was worked out for.
          */
         if (ls->type == LS_OBJECT) {
             if (get_obj_location(ls->id.a_obj, &ls->x, &ls->y, 0))
@@ -171,6 +277,8 @@ char **cs_rows;
              * Kevin's tests indicated that doing this brute-force
              * method is faster for radius <= 3 (or so).
              */
+            if (ls->x != u.ux || ls->y != u.uy)
+                find_lit_area(ls);
             limits = circle_ptr(ls->range);
             if ((max_y = (ls->y + ls->range)) >= ROWNO)
                 max_y = ROWNO - 1;
@@ -200,10 +308,11 @@ char **cs_rows;
                         if (row[x] & COULD_SEE)
                             row[x] |= TEMP_LIT;
                 } else {
-                    for (x = min_x; x <= max_x; x++)
-                        if ((ls->x == x && ls->y == y)
-                            || clear_path((int) ls->x, (int) ls->y, x, y))
-                            row[x] |= TEMP_LIT;
+                    or_lit_row(&row[min_x],
+                               &ls_node_of(ls)->lit[y - ls->y + MAX_RADIUS]
+                                                   [min_x - ls->x
+                                                    + MAX_RADIUS],
+                               max_x - min_x + 1);
                 }
             }
         }
@@ -373,7 +482,7 @@ int fd;
     mread(fd, (genericptr_t) &count, sizeof count);
 
     while (count-- > 0) {
-        ls = (light_source *) alloc(sizeof(light_source));
+        ls = alloc_ls();
         mread(fd, (genericptr_t) ls, sizeof(light_source));
         ls->next = light_base;
         light_base = ls;
@@ -389,11 +498,11 @@ long *count, *size;
 {
     light_source *ls;
 
-    Sprintf(hdrbuf, hdrfmt, (long) sizeof (light_source));
+    Sprintf(hdrbuf, hdrfmt, (long) sizeof (ls_node));
     *count = *size = 0L;
     for (ls = light_base; ls; ls = ls->next) {
         ++*count;
-        *size += (long) sizeof *ls;
+        *size += (long) sizeof (ls_node);
     }
 }
 
@@ -634,7 +743,7 @@ struct obj *src, *dest;
              * never interfere us walking down the list - we are already
              * past the insertion point.
              */
-            new_ls = (light_source *) alloc(sizeof(light_source));
+            new_ls = alloc_ls();
             *new_ls = *ls;
             if (Is_candle(src)) {
                 /* split candles may emit less light than original group */
@@ -1019,7 +1019,7 @@ newmextra()
 {
     struct mextra *mextra;
 
-    mextra = (struct mextra *) alloc(sizeof(struct mextra));
+    mextra = (struct mextra *) pool_get(POOL_MEXTRA);
     mextra->mname = 0;
     mextra->egd = 0;
     mextra->epri = 0;
@@ -72,7 +72,7 @@ newoextra()
 {
     struct oextra *oextra;
 
-    oextra = (struct oextra *) alloc(sizeof (struct oextra));
+    oextra = (struct oextra *) pool_get(POOL_OEXTRA);
     oextra->oname = 0;
     oextra->omonst = 0;
     oextra->omid = 0;
@@ -99,7 +99,7 @@ struct obj *o;
         if (x->omailcmd)
             free((genericptr_t) x->omailcmd);
 
-        free((genericptr_t) x);
+        pool_put(POOL_OEXTRA, (genericptr_t) x);
         o->oextra = (struct oextra *) 0;
     }
 }
@@ -129,7 +129,7 @@ struct obj *otmp;
         if (m) {
             if (m->mextra)
                 dealloc_mextra(m);
-            free((genericptr_t) m);
+            pool_put(POOL_MONST, (genericptr_t) m);
             OMONST(otmp) = (struct monst *) 0;
         }
     }
@@ -2188,7 +2188,7 @@ struct obj *obj;
 
     if (obj->oextra)
         dealloc_oextra(obj);
-    free((genericptr_t) obj);
+    pool_put(POOL_OBJ, (genericptr_t) obj);
 }
 
 /* create an object from a horn of plenty; mirrors bagotricks(makemon.c) */
@@ -1796,7 +1796,7 @@ struct monst *m;
             free((genericptr_t) x->edog);
         /* [no action needed for x->mcorpsenm] */
 
-        free((genericptr_t) x);
+        pool_put(POOL_MEXTRA, (genericptr_t) x);
         m->mextra = (struct mextra *) 0;
     }
 }
@@ -1814,7 +1814,7 @@ struct monst *mon;
     }
     if (mon->mextra)
         dealloc_mextra(mon);
-    free((genericptr_t) mon);
+    pool_put(POOL_MONST, (genericptr_t) mon);
 }
 
 /* remove effects of mtmp from other data structures */
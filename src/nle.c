@@ -1,7 +1,10 @@
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <time.h>
 
 #include <tmt.h>
 
@@ -14,6 +17,7 @@
 #include "dlb.h"
 
 #include "nle.h"
+#include "nlereplay.h"
 #include "nlernd.h"
 
 #ifdef NLE_BZ2_TTYRECS
@@ -142,6 +146,13 @@ init_nle(FILE *ttyrec, nle_obs *obs)
     nle->outbuf_write_ptr = nle->outbuf;
     nle->outbuf_write_end = nle->outbuf + sizeof(nle->outbuf);
 
+    nle->ttyrec_buf_len = 0;
+    nle->ttyrec_sec = nle->ttyrec_usec = 0;
+    nle->ttyrec_steps = 0;
+    nle->ttyrec_hour = -1;
+
+    nle->level_request = NULL;
+
     return nle;
 }
 
@@ -210,24 +221,261 @@ write_ttyrec_data(void *buf, int length)
     return TRUE;
 }
 
+/* Hands the buffered records of this step to the compressor. */
+void
+flush_ttyrec(nle_ctx_t *nle)
+{
+    if (nle->ttyrec_buf_len) {
+        write_ttyrec_data(nle->ttyrec_buf, nle->ttyrec_buf_len);
+        nle->ttyrec_buf_len = 0;
+    }
+#ifndef NLE_BZ2_TTYRECS
+    fflush(nle->ttyrec);
+#endif
+}
+
+/* Takes the timestamp for all ttyrec records until the next call. Only
+ * called once per step, so the clock is never read per record. */
+void
+stamp_ttyrec(nle_ctx_t *nle)
+{
+    if (settings.ttyrec_logical_time) {
+        nle->ttyrec_sec = nle->ttyrec_steps;
+        nle->ttyrec_usec = 0;
+    } else {
+        long sec, usec;
+#ifdef CLOCK_REALTIME_COARSE
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        sec = ts.tv_sec;
+        usec = ts.tv_nsec / 1000;
+#else
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        sec = tv.tv_sec;
+        usec = tv.tv_usec;
+#endif
+        /* Keep timestamps monotonic even if the wall clock steps back. */
+        if (sec > nle->ttyrec_sec
+            || (sec == nle->ttyrec_sec && usec > nle->ttyrec_usec)) {
+            nle->ttyrec_sec = sec;
+            nle->ttyrec_usec = usec;
+        }
+    }
+    nle->ttyrec_steps++;
+}
+
+/* Appends a header (as read by read_header in converter.c) and its
+ * payload to the step's buffer. */
 boolean
-write_ttyrec_header(int length, unsigned char channel)
+write_ttyrec_record(unsigned char channel, void *buf, int length)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
+    nle_ctx_t *nle = current_nle_ctx;
+    int header[3];
+    header[0] = nle->ttyrec_sec;
+    header[1] = nle->ttyrec_usec;
+    header[2] = length;
 
-    int buffer[3];
-    buffer[0] = tv.tv_sec;
-    buffer[1] = tv.tv_usec;
-    buffer[2] = length;
+    size_t size = sizeof(header) + 1 + length;
+    if (nle->ttyrec_buf_len + size > sizeof(nle->ttyrec_buf))
+        flush_ttyrec(nle);
 
     /* Assumes little endianness */
-    write_ttyrec_data(buffer, 3 * sizeof(int));
-    write_ttyrec_data(&channel, 1);
-
+    char *p = nle->ttyrec_buf + nle->ttyrec_buf_len;
+    memcpy(p, header, sizeof(header));
+    p[sizeof(header)] = channel;
+    if (size <= sizeof(nle->ttyrec_buf)) {
+        memcpy(p + sizeof(header) + 1, buf, length);
+        nle->ttyrec_buf_len += size;
+    } else {
+        /* Too large to buffer; the buffer is empty at this point. */
+        write_ttyrec_data(p, sizeof(header) + 1);
+        write_ttyrec_data(buf, length);
+    }
     return TRUE;
 }
 
+void
+write_replay_data(nle_ctx_t *nle, const void *buf, int length)
+{
+#ifdef NLE_BZ2_TTYRECS
+    int bzerror;
+    BZ2_bzWrite(&bzerror, nle->replay_bz2, (void *) buf, length);
+    assert(bzerror == BZ_OK);
+#else
+    assert(fwrite(buf, 1, length, nle->replay) == length);
+#endif
+}
+
+void
+write_replay_record(nle_ctx_t *nle, unsigned char type, const void *payload,
+                    int length)
+{
+    /* Assumes little endianness, like the ttyrec headers. */
+    write_replay_data(nle, &type, 1);
+    if (length)
+        write_replay_data(nle, payload, length);
+}
+
+/* Fills buf with the SEEDS payload for the current seeds. */
+void
+get_replay_seeds(nle_ctx_t *nle, unsigned char *buf)
+{
+    unsigned long core, disp, lgen;
+    boolean reseed;
+    bool lgen_in_use;
+    uint64_t seeds[3];
+
+    nle_get_seed(nle, &core, &disp, &reseed, &lgen, &lgen_in_use);
+    seeds[0] = core;
+    seeds[1] = disp;
+    seeds[2] = lgen;
+    memcpy(buf, seeds, sizeof(seeds));
+    buf[sizeof(seeds)] = reseed ? 1 : 0;
+    buf[sizeof(seeds) + 1] = lgen_in_use ? 1 : 0;
+}
+
+/* Writes a SEEDS record if the seeds differ from the last ones written. */
+void
+write_replay_seeds(nle_ctx_t *nle, boolean force)
+{
+    unsigned char buf[NLE_REPLAY_SEEDS_SIZE];
+
+    get_replay_seeds(nle, buf);
+    if (!force && !memcmp(buf, nle->replay_seeds, sizeof(buf)))
+        return;
+    memcpy(nle->replay_seeds, buf, sizeof(buf));
+    write_replay_record(nle, NLE_REPLAY_SEEDS, buf, sizeof(buf));
+}
+
+/* Like write_replay_seeds, but to the replay channel of the ttyrec. */
+void
+write_ttyrec_seeds(nle_ctx_t *nle, boolean force)
+{
+    unsigned char buf[1 + NLE_REPLAY_SEEDS_SIZE];
+
+    get_replay_seeds(nle, buf + 1);
+    if (!force && !memcmp(buf + 1, nle->ttyrec_seeds, NLE_REPLAY_SEEDS_SIZE))
+        return;
+    memcpy(nle->ttyrec_seeds, buf + 1, NLE_REPLAY_SEEDS_SIZE);
+    buf[0] = NLE_REPLAY_SEEDS;
+    write_ttyrec_record(NLE_TTYREC_REPLAY_CHANNEL, buf, sizeof(buf));
+}
+
+/* Writes a TIME record for the local time lt of now. */
+void
+write_ttyrec_time(nle_ctx_t *nle, time_t now, struct tm *lt)
+{
+    char buf[1 + 8 + 4];
+    int64_t time = (int64_t) now;
+    int32_t utc_offset = (int32_t) lt->tm_gmtoff;
+
+    nle->ttyrec_utc_offset = utc_offset;
+    nle->ttyrec_hour = (now + utc_offset) / 3600;
+
+    buf[0] = NLE_REPLAY_TIME;
+    memcpy(buf + 1, &time, sizeof(time));
+    memcpy(buf + 9, &utc_offset, sizeof(utc_offset));
+    write_ttyrec_record(NLE_TTYREC_REPLAY_CHANNEL, buf, sizeof(buf));
+}
+
+void
+write_ttyrec_options()
+{
+    char buf[1 + 1 + 4 + sizeof(settings.options)];
+    uint32_t len = strnlen(settings.options, sizeof(settings.options));
+
+    buf[0] = NLE_REPLAY_OPTIONS;
+    buf[1] = settings.spawn_monsters ? 1 : 0;
+    memcpy(buf + 2, &len, sizeof(len));
+    memcpy(buf + 6, settings.options, len);
+    write_ttyrec_record(NLE_TTYREC_REPLAY_CHANNEL, buf, 6 + len);
+
+    if (settings.initial_seeds.rng != NLE_RNG_ISAAC64) {
+        buf[0] = NLE_REPLAY_RNG;
+        buf[1] = settings.initial_seeds.rng;
+        write_ttyrec_record(NLE_TTYREC_REPLAY_CHANNEL, buf, 2);
+    }
+
+    /* The start time, in the time zone the game is played in. */
+    time_t start = ubirthday;
+    write_ttyrec_time(current_nle_ctx, start, localtime(&start));
+}
+
+void
+write_replay_score(nle_ctx_t *nle, nle_obs *obs, boolean force)
+{
+    if (!obs->blstats)
+        return;
+    if (!force && obs->blstats[NLE_BL_SCORE] == nle->replay_score)
+        return;
+    nle->replay_score = obs->blstats[NLE_BL_SCORE];
+
+    int32_t score = (int32_t) nle->replay_score;
+    write_replay_record(nle, NLE_REPLAY_SCORE, &score, sizeof(score));
+}
+
+void
+open_replay(nle_ctx_t *nle)
+{
+    nle->replay = NULL;
+    if (!settings.replayname[0])
+        return;
+
+    nle->replay = fopen(settings.replayname, "w");
+    if (!nle->replay) {
+        perror("Could not open replay file");
+        return;
+    }
+#ifdef NLE_BZ2_TTYRECS
+    int bzerror;
+    nle->replay_bz2 = BZ2_bzWriteOpen(&bzerror, nle->replay, 9, 0, 0);
+    assert(bzerror == BZ_OK);
+#endif
+}
+
+/* Called once the game has started and the seeds are known. */
+void
+write_replay_header(nle_ctx_t *nle, nle_obs *obs)
+{
+    unsigned char header[NLE_REPLAY_MAGIC_SIZE + 4 + 8];
+    uint32_t version = NLE_REPLAY_VERSION;
+    int64_t start = (int64_t) ubirthday; /* see nle_clock_frozen */
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, NLE_REPLAY_MAGIC, sizeof(NLE_REPLAY_MAGIC));
+    memcpy(header + NLE_REPLAY_MAGIC_SIZE, &version, sizeof(version));
+    memcpy(header + NLE_REPLAY_MAGIC_SIZE + 4, &start, sizeof(start));
+    write_replay_record(nle, NLE_REPLAY_HEADER, header, sizeof(header));
+
+    unsigned char spawn = settings.spawn_monsters ? 1 : 0;
+    uint32_t len = strnlen(settings.options, sizeof(settings.options));
+    write_replay_record(nle, NLE_REPLAY_OPTIONS, &spawn, 1);
+    write_replay_data(nle, &len, sizeof(len));
+    write_replay_data(nle, settings.options, len);
+    if (settings.initial_seeds.rng != NLE_RNG_ISAAC64) {
+        unsigned char rng = settings.initial_seeds.rng;
+        write_replay_record(nle, NLE_REPLAY_RNG, &rng, 1);
+    }
+
+    write_replay_seeds(nle, TRUE);
+    write_replay_score(nle, obs, TRUE);
+}
+
+void
+close_replay(nle_ctx_t *nle)
+{
+    if (!nle->replay)
+        return;
+#ifdef NLE_BZ2_TTYRECS
+    int bzerror;
+    BZ2_bzWriteClose(&bzerror, nle->replay_bz2, 0, NULL, NULL);
+    assert(bzerror == BZ_OK);
+#endif
+    fclose(nle->replay);
+    nle->replay = NULL;
+}
+
 /* win/tty only calls fflush(stdout). */
 int
 nle_fflush(FILE *stream)
@@ -246,8 +494,7 @@ nle_fflush(FILE *stream)
         return 0;
 
     if (nle->ttyrec) {
-        write_ttyrec_header(length, 0);
-        write_ttyrec_data(nle->outbuf, length);
+        write_ttyrec_record(0, nle->outbuf, length);
     }
 
     nle_obs *obs = nle->observation;
@@ -256,11 +503,7 @@ nle_fflush(FILE *stream)
     }
     nle->outbuf_write_ptr = nle->outbuf;
 
-#ifdef NLE_BZ2_TTYRECS
     return 0;
-#else
-    return nle->ttyrec ? fflush(nle->ttyrec) : 0;
-#endif
 }
 
 /*
@@ -318,6 +561,63 @@ nle_get_obs()
     return current_nle_ctx->observation;
 }
 
+/* Whether the clock-dependent parts of the game (moon phase, night...) go
+ * by the time it started rather than the wall clock: in games recorded to
+ * a replay file, which only has the start time. Their re-simulations pin
+ * the clock to that time with settings.fixed_time. See getlt in
+ * hacklib.c. */
+boolean
+nle_clock_frozen()
+{
+    return settings.replayname[0] != '\0';
+}
+
+/* Called by getlt in hacklib.c whenever the game reads the wall clock,
+ * local time lt. NLE ttyrecs record the clock the game sees: a TIME record
+ * whenever it is in a new hour (the finest the game cares about, see
+ * night() and midnight()) or time zone, so that re-simulations can set it
+ * via nle_set_clock. */
+void
+nle_clock_observed(time_t now, struct tm *lt)
+{
+    nle_ctx_t *nle = current_nle_ctx;
+
+    /* Nothing before the start TIME record, see write_ttyrec_options. */
+    if (!nle || !nle->ttyrec || nle->ttyrec_hour < 0)
+        return;
+    if (lt->tm_gmtoff == nle->ttyrec_utc_offset
+        && (now + lt->tm_gmtoff) / 3600 == nle->ttyrec_hour)
+        return;
+    write_ttyrec_time(nle, now, lt);
+}
+
+/* Sets NetHack's clock to now, utc_offset seconds east of UTC; now == 0
+ * goes back to the wall clock. */
+void
+nle_set_clock(nle_ctx_t *nle, long now, long utc_offset)
+{
+    settings.fixed_time = now;
+    settings.fixed_utc_offset = utc_offset;
+}
+
+/* Whether anything reads what NetHack writes to the terminal: the ttyrec
+ * or the tty_* observations. See flush_screen in display.c. */
+boolean
+nle_tty_wanted()
+{
+    nle_obs *obs = current_nle_ctx->observation;
+
+    return current_nle_ctx->ttyrec || obs->tty_chars || obs->tty_colors
+           || obs->tty_cursor;
+}
+
+/* See nle_level_loop in nlelevel.c. */
+nle_level_request *
+nle_get_level_request()
+{
+    return current_nle_ctx->level_request;
+}
+
 void *
 nle_yield(void *notdone)
 {
@@ -388,6 +688,113 @@ nle_fopen_wizkit_file()
     return fmemopen(settings.wizkit, len, "r");
 }
 
+void *
+nle_splev_lookup(const char *name)
+{
+    nle_splev_cache *cache = settings.splev_cache;
+    void *lvl = NULL;
+    int i;
+
+    if (!cache)
+        return NULL;
+    pthread_mutex_lock(&cache->mutex);
+    for (i = 0; i < cache->size; ++i) {
+        if (!strcmp(cache->entries[i].name, name)) {
+            lvl = cache->entries[i].lvl;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return lvl;
+}
+
+/* Offers lvl to the cache. Returns the cached level for name, which is not
+ * lvl if another instance got there first, or NULL if lvl was not cached
+ * and remains the caller's to free. */
+void *
+nle_splev_insert(const char *name, void *lvl)
+{
+    nle_splev_cache *cache = settings.splev_cache;
+    void *cached = NULL;
+    int i;
+
+    if (!cache || strlen(name) >= NLE_SPLEV_NAME_SIZE)
+        return NULL;
+    pthread_mutex_lock(&cache->mutex);
+    for (i = 0; i < cache->size; ++i) {
+        if (!strcmp(cache->entries[i].name, name)) {
+            cached = cache->entries[i].lvl;
+            break;
+        }
+    }
+    if (!cached && cache->size < NLE_SPLEV_CACHE_SIZE) {
+        strcpy(cache->entries[cache->size].name, name);
+        cache->entries[cache->size].lvl = cached = lvl;
+        ++cache->size;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return cached;
+}
+
+/* Index of the dlb cache entry for the file st describes, or -1. */
+static int
+nle_dlb_find(nle_dlb_cache *cache, const struct stat *st)
+{
+    int i;
+
+    for (i = 0; i < cache->size; ++i) {
+        if (cache->entries[i].dev == st->st_dev
+            && cache->entries[i].ino == st->st_ino
+            && cache->entries[i].fsize == st->st_size
+            && cache->entries[i].mtime == st->st_mtime)
+            return i;
+    }
+    return -1;
+}
+
+void *
+nle_dlb_lookup(int fd)
+{
+    nle_dlb_cache *cache = settings.dlb_cache;
+    struct stat st;
+    void *lib = NULL;
+    int i;
+
+    if (!cache || fstat(fd, &st) < 0)
+        return NULL;
+    pthread_mutex_lock(&cache->mutex);
+    if ((i = nle_dlb_find(cache, &st)) >= 0)
+        lib = cache->entries[i].lib;
+    pthread_mutex_unlock(&cache->mutex);
+    return lib;
+}
+
+/* As nle_splev_insert, for the library mapped from fd. */
+void *
+nle_dlb_insert(int fd, void *lib)
+{
+    nle_dlb_cache *cache = settings.dlb_cache;
+    struct stat st;
+    void *cached = NULL;
+    int i;
+
+    if (!cache || fstat(fd, &st) < 0)
+        return NULL;
+    pthread_mutex_lock(&cache->mutex);
+    if ((i = nle_dlb_find(cache, &st)) >= 0) {
+        cached = cache->entries[i].lib;
+    } else if (cache->size < NLE_DLB_CACHE_SIZE) {
+        i = cache->size++;
+        cache->entries[i].dev = st.st_dev;
+        cache->entries[i].ino = st.st_ino;
+        cache->entries[i].fsize = st.st_size;
+        cache->entries[i].mtime = st.st_mtime;
+        cache->entries[i].lib = cached = lib;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return cached;
+}
+
 nle_ctx_t *
 nle_start(nle_obs *obs, FILE *ttyrec, nle_settings *settings_p)
 {
@@ -398,9 +805,14 @@ nle_start(nle_obs *obs, FILE *ttyrec, nle_settings *settings_p)
     settings = *settings_p;
 
     nle_ctx_t *nle = init_nle(ttyrec, obs);
+    open_replay(nle);
+    if (nle->ttyrec)
+        stamp_ttyrec(nle);
 
     /* Initialise the level generation RNG */
     nle_init_lgen_rng();
+    if (settings.rng_counts)
+        nle_set_rng_counting(nle, TRUE);
 
     nle->stack = create_fcontext_stack(STACK_SIZE);
     nle->generatorcontext =
@@ -413,13 +825,19 @@ nle_start(nle_obs *obs, FILE *ttyrec, nle_settings *settings_p)
     obs->done = nle->done;
 
     if (nle->ttyrec) {
+        /* The seeds are known now that the game has started. */
+        write_ttyrec_options();
+        write_ttyrec_seeds(nle, TRUE);
         if (obs->blstats) {
             /* See comment in `nle_step`. We record the score in line with
              * the state to ensure s,r -> a -> s', r'. These lines ensure
              * we don't skip the first reward. */
-            write_ttyrec_header(4, 2);
-            write_ttyrec_data(&obs->blstats[9], 4);
+            write_ttyrec_record(2, &obs->blstats[9], 4);
         }
+        flush_ttyrec(nle);
+    }
+    if (nle->replay) {
+        write_replay_header(nle, obs);
     }
 
     return nle;
@@ -431,8 +849,17 @@ nle_step(nle_ctx_t *nle, nle_obs *obs)
     current_nle_ctx = nle;
     nle->observation = obs;
     if (nle->ttyrec) {
-        write_ttyrec_header(1, 1);
-        write_ttyrec_data(&obs->action, 1);
+        stamp_ttyrec(nle);
+        /* Seeds only change between steps, see below. */
+        write_ttyrec_seeds(nle, FALSE);
+        write_ttyrec_record(1, &obs->action, 1);
+    }
+    if (nle->replay) {
+        /* Seeds can only change between steps (via nle_set_seed), so a
+         * SEEDS record written here applies exactly from this action on. */
+        write_replay_seeds(nle, FALSE);
+        unsigned char action = (unsigned char) obs->action;
+        write_replay_record(nle, NLE_REPLAY_ACTION, &action, 1);
     }
     fcontext_transfer_t t = jump_fcontext(nle->generatorcontext, obs);
     nle->generatorcontext = t.ctx;
@@ -445,6 +872,7 @@ nle_step(nle_ctx_t *nle, nle_obs *obs)
          *  - 0: the terminal instructions (classic ttyrec)
          *  - 1: the keypress/action (1 byte)
          *  - 2: the in-game score (4 bytes)
+         *  - 3: options and seeds for re-simulation (see nlereplay.h)
          *
          * We could either the note the in-game score every time we flush the
          * terminal instructions to screen, (eg writing [ 0 2 0 2 <step> 1 0 2
@@ -458,14 +886,49 @@ nle_step(nle_ctx_t *nle, nle_obs *obs)
          * see winrl.cc
          */
         if (obs->blstats) {
-            write_ttyrec_header(4, 2);
-            write_ttyrec_data(&obs->blstats[9], 4);
+            write_ttyrec_record(2, &obs->blstats[9], 4);
+        }
+        flush_ttyrec(nle);
+    }
+    if (nle->replay) {
+        write_replay_score(nle, obs, FALSE);
+        if (nle->done) {
+            int32_t how = obs->how_done;
+            write_replay_record(nle, NLE_REPLAY_DONE, &how, sizeof(how));
         }
     }
 
     return nle;
 }
 
+/* Makes dungeon dnum's level dlevel from the given level generation seed
+ * in an instance started with settings.level_generator; see nlelevel.c.
+ * Returns 0, or -1 if there is no such level or no level generator. */
+int
+nle_generate_level(nle_ctx_t *nle, unsigned long lgen_seed, int dnum,
+                   int dlevel, nle_level *level)
+{
+    nle_level_request request = { lgen_seed, dnum, dlevel, level,
+                                  NLE_LEVEL_PENDING };
+
+    if (!settings.level_generator || nle->done)
+        return -1;
+
+    current_nle_ctx = nle;
+    nle->level_request = &request;
+    /* Should anything ask for a key on the way, it gets ESC. */
+    nle->observation->action = '\033';
+    while (!nle->done && request.result == NLE_LEVEL_PENDING) {
+        fcontext_transfer_t t =
+            jump_fcontext(nle->generatorcontext, nle->observation);
+        nle->generatorcontext = t.ctx;
+        nle->done = (t.data == NULL);
+    }
+    nle->level_request = NULL;
+
+    return request.result == 0 ? 0 : -1;
+}
+
 void
 nle_end(nle_ctx_t *nle)
 {
@@ -478,6 +941,8 @@ nle_end(nle_ctx_t *nle)
         }
     }
     nle_fflush(stdout);
+    if (nle->ttyrec)
+        flush_ttyrec(nle);
 
 #ifdef NLE_BZ2_TTYRECS
     if (nle->ttyrec) {
@@ -486,6 +951,7 @@ nle_end(nle_ctx_t *nle)
         assert(bzerror == BZ_OK);
     }
 #endif
+    close_replay(nle);
 
     tmt_close(nle->vterminal);
 
@@ -0,0 +1,209 @@
+/* NLE: making levels without playing, for nle_generate_level() in nle.c.
+ *
+ * An instance started with settings.level_generator sets up a game as
+ * usual but never enters moveloop(); it waits in nle_level_loop() for
+ * requests instead. Each request reseeds the level generation RNG, lays
+ * out the dungeon anew from it (so which level is the Oracle & co. depends
+ * on the seed too), makes the requested level with mklev() and copies it
+ * out before throwing it away. The same seed, dungeon and level thus give
+ * the same level in any instance with the same options, whatever came
+ * before; though not the one a game with that seed reaches, as games
+ * draw from the same streams for the hero and earlier levels.
+ *
+ * Instances are independent copies of the library, so many of them can
+ * generate levels at once, one request at a time each.
+ */
+
+#include "hack.h"
+#include "lev.h"
+#include "nlernd.h"
+
+extern nle_settings settings;
+extern int n_dgns;        /* dungeon.c */
+extern char *lev_message; /* sp_lev.c */
+
+extern void NDECL(nle_reset_alignments); /* sp_lev.c */
+extern void NDECL(nle_free_migrating);   /* save.c */
+extern void *FDECL(nle_yield, (genericptr_t));
+extern nle_level_request *NDECL(nle_get_level_request);
+
+STATIC_VAR struct context_info context0; /* as the game set it up */
+
+STATIC_DCL boolean FDECL(make_level, (unsigned long, int, int));
+STATIC_DCL void FDECL(dump_level, (nle_level *));
+STATIC_DCL void NDECL(discard_level);
+
+boolean
+nle_level_generator()
+{
+    return (boolean) settings.level_generator;
+}
+
+/* Serve nle_generate_level(); never returns. */
+void
+nle_level_loop()
+{
+    nle_level_request *req;
+
+    flags.bones = FALSE;        /* only fresh levels */
+    has_strong_rngseed = FALSE; /* no reseeding in mklev() */
+    discard_level();            /* the one the hero started on */
+    context0 = context;
+
+    for (;;) {
+        (void) nle_yield((genericptr_t) TRUE);
+        req = nle_get_level_request();
+        if (!req || req->result != NLE_LEVEL_PENDING)
+            continue; /* nle_step on a level generator */
+
+        if (make_level(req->lgen_seed, req->dnum, req->dlevel)) {
+            dump_level(req->level);
+            discard_level();
+            req->result = 0;
+        } else {
+            req->result = -1;
+        }
+    }
+}
+
+STATIC_OVL boolean
+make_level(seed, dnum, dlevel)
+unsigned long seed;
+int dnum, dlevel;
+{
+    d_level lev;
+    int i;
+
+    settings.initial_seeds.lgen_seed = seed;
+    settings.initial_seeds.use_lgen_seed = TRUE;
+    nle_init_lgen_rng();
+
+    /* As in newgame(), the dungeon's layout comes from the first stream. */
+    nle_swap_to_lgen(0);
+    free_dungeons();
+    init_dungeons();
+    nle_swap_to_core(0);
+
+    /* Forget what earlier levels made: uniques, artifacts, object and
+       monster ids, the tribute book placed in some bookshop... */
+    context = context0;
+    nle_reset_alignments();
+    for (i = LOW_PM; i < NUMMONS; i++) {
+        mvitals[i].born = mvitals[i].died = 0;
+        mvitals[i].mvflags = mons[i].geno & G_NOCORPSE;
+    }
+    init_artifacts();
+
+    lev.dnum = dnum;
+    lev.dlevel = dlevel;
+    if (dnum < 0 || dnum >= n_dgns || dlevel < 1
+        || dlevel > dunlevs_in_dungeon(&lev))
+        return FALSE;
+
+    u.uz = lev;
+    u.ux = u.uy = 0; /* the hero is nowhere */
+    mklev();
+    return TRUE;
+}
+
+STATIC_OVL void
+dump_level(out)
+nle_level *out;
+{
+    struct mkroom *croom;
+    struct monst *mtmp;
+    struct obj *otmp;
+    struct trap *ttmp;
+    s_level *slev = Is_special(&u.uz);
+    int x, y, n;
+
+    (void) memset((genericptr_t) out, 0, sizeof *out);
+    out->dnum = u.uz.dnum;
+    out->dlevel = u.uz.dlevel;
+    out->depth = depth(&u.uz);
+    (void) strncpy(out->dungeon, dungeons[u.uz.dnum].dname,
+                   sizeof out->dungeon - 1);
+    if (slev)
+        (void) strncpy(out->special, slev->proto, sizeof out->special - 1);
+
+    for (y = 0; y < ROWNO; y++)
+        for (x = 1; x < COLNO; x++) {
+            out->typ[y][x - 1] = levl[x][y].typ;
+            out->flags[y][x - 1] = levl[x][y].flags;
+            out->lit[y][x - 1] = levl[x][y].lit;
+            out->roomno[y][x - 1] = levl[x][y].roomno;
+        }
+
+    out->upstair[0] = xupstair, out->upstair[1] = yupstair;
+    out->dnstair[0] = xdnstair, out->dnstair[1] = ydnstair;
+    out->upladder[0] = xupladder, out->upladder[1] = yupladder;
+    out->dnladder[0] = xdnladder, out->dnladder[1] = ydnladder;
+    out->sstairs[0] = sstairs.sx, out->sstairs[1] = sstairs.sy;
+
+    for (croom = &rooms[0]; croom != &rooms[nroom]; croom++) {
+        if ((n = out->nrooms) == NLE_LEVEL_ROOMS) {
+            out->truncated++;
+            continue;
+        }
+        out->rooms[n].lx = croom->lx, out->rooms[n].ly = croom->ly;
+        out->rooms[n].hx = croom->hx, out->rooms[n].hy = croom->hy;
+        out->rooms[n].rtype = croom->orig_rtype;
+        out->rooms[n].rlit = croom->rlit;
+        out->rooms[n].doorct = croom->doorct;
+        out->rooms[n].irregular = croom->irregular;
+        out->nrooms++;
+    }
+
+    for (otmp = fobj; otmp; otmp = otmp->nobj) {
+        if ((n = out->nobjects) == NLE_LEVEL_OBJECTS) {
+            out->truncated++;
+            continue;
+        }
+        out->objects[n].x = otmp->ox, out->objects[n].y = otmp->oy;
+        out->objects[n].otyp = otmp->otyp;
+        out->objects[n].quan = (int) otmp->quan;
+        out->nobjects++;
+    }
+
+    for (mtmp = fmon; mtmp; mtmp = mtmp->nmon) {
+        if (DEADMONSTER(mtmp))
+            continue;
+        if ((n = out->nmonsters) == NLE_LEVEL_MONSTERS) {
+            out->truncated++;
+            continue;
+        }
+        out->monsters[n].x = mtmp->mx, out->monsters[n].y = mtmp->my;
+        out->monsters[n].mnum = mtmp->mnum;
+        out->monsters[n].peaceful = mtmp->mpeaceful;
+        out->monsters[n].asleep = mtmp->msleeping;
+        out->nmonsters++;
+    }
+
+    for (ttmp = ftrap; ttmp; ttmp = ttmp->ntrap) {
+        if ((n = out->ntraps) == NLE_LEVEL_TRAPS) {
+            out->truncated++;
+            continue;
+        }
+        out->traps[n].x = ttmp->tx, out->traps[n].y = ttmp->ty;
+        out->traps[n].ttyp = ttmp->ttyp;
+        out->ntraps++;
+    }
+}
+
+/* Free the current level, as #wizmakemap does before making a new one. */
+STATIC_OVL void
+discard_level()
+{
+    rm_mapseen(ledger_no(&u.uz));
+    dmonsfree();
+    savelev(-1, ledger_no(&u.uz), FREE_SAVE);
+    if (Is_waterlevel(&u.uz) || Is_airlevel(&u.uz))
+        save_waterlevel(-1, FREE_SAVE);
+    nle_free_migrating();
+    if (lev_message) { /* never delivered */
+        free((genericptr_t) lev_message);
+        lev_message = (char *) 0;
+    }
+}
+
+/*nlelevel.c*/
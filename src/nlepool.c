@@ -0,0 +1,158 @@
+/* NLE: free-list pools for monsters, objects and their mextra and oextra.
+ *
+ * These come and go all game long: monsters are killed, corpses rot away,
+ * stacks are split and merged, whole levels are saved and restored. So
+ * instead of a malloc() and free() each, newmonst(), newobj(), newmextra()
+ * and newoextra() take items out of slabs of POOL_SLAB of them, and the
+ * dealloc_*() functions put them on their pool's free list, to be handed
+ * out again most recently released first. Monsters and objects made
+ * together end up next to each other, which helps walking fmon and fobj.
+ * Slabs are only given back by free_pools(), with the rest of the game.
+ *
+ * An item's identity isn't kept here: o_id and m_id come from
+ * context.ident as before, so a recycled item gets a new id just like a
+ * new allocation. With MONITOR_HEAP, items are allocated and freed one by
+ * one so that the heap log still shows each of them under its caller's
+ * file and line; the pools then only count them.
+ */
+
+#include "hack.h"
+#include "nletypes.h"
+
+#if NUM_POOLS != NLE_POOLS
+#error "POOL_* in global.h and NLE_POOL_* in nletypes.h disagree"
+#endif
+
+#define POOL_SLAB 64 /* items per slab */
+
+struct pool_slab {
+    struct pool_slab *next;
+    genericptr_t pad; /* so items are aligned as malloc()'s are */
+};
+
+static struct pool {
+    struct pool_slab *slabs;
+    genericptr_t freelist; /* each free item starts with the next one */
+    nle_pool_stats stats;
+} pools[NUM_POOLS] = {
+    { 0, 0, { sizeof (struct monst) } },
+    { 0, 0, { sizeof (struct obj) } },
+    { 0, 0, { sizeof (struct mextra) } },
+    { 0, 0, { sizeof (struct oextra) } },
+};
+
+#ifndef MONITOR_HEAP
+STATIC_DCL void FDECL(grow_pool, (struct pool *));
+
+/* Add a slab of free items, in address order. */
+STATIC_OVL void
+grow_pool(pl)
+struct pool *pl;
+{
+    struct pool_slab *slab;
+    char *item;
+    int i;
+
+    slab = (struct pool_slab *) alloc(sizeof *slab
+                                      + POOL_SLAB * pl->stats.size);
+    slab->next = pl->slabs;
+    pl->slabs = slab;
+    item = (char *) (slab + 1) + POOL_SLAB * pl->stats.size;
+    for (i = 0; i < POOL_SLAB; i++) {
+        item -= pl->stats.size;
+        *(genericptr_t *) item = pl->freelist;
+        pl->freelist = (genericptr_t) item;
+    }
+    pl->stats.slabs++;
+    pl->stats.items += POOL_SLAB;
+}
+
+/* Uninitialized, like alloc(). */
+genericptr_t
+pool_get(p)
+int p;
+{
+    struct pool *pl = &pools[p];
+    genericptr_t item;
+
+    if (!pl->freelist)
+        grow_pool(pl);
+    item = pl->freelist;
+    pl->freelist = *(genericptr_t *) item;
+    pl->stats.gets++;
+    if (++pl->stats.live > pl->stats.peak)
+        pl->stats.peak = pl->stats.live;
+    return item;
+}
+
+void
+pool_put(p, item)
+int p;
+genericptr_t item;
+{
+    struct pool *pl = &pools[p];
+
+    *(genericptr_t *) item = pl->freelist;
+    pl->freelist = item;
+    pl->stats.puts++;
+    pl->stats.live--;
+}
+
+#else /* MONITOR_HEAP */
+
+genericptr_t
+nhpool_get(p, file, line)
+int p;
+const char *file;
+int line;
+{
+    struct pool *pl = &pools[p];
+
+    pl->stats.gets++;
+    if (++pl->stats.live > pl->stats.peak)
+        pl->stats.peak = pl->stats.live;
+    return (genericptr_t) nhalloc((unsigned) pl->stats.size, file, line);
+}
+
+void
+nhpool_put(p, item, file, line)
+int p;
+genericptr_t item;
+const char *file;
+int line;
+{
+    pools[p].stats.puts++;
+    pools[p].stats.live--;
+    nhfree(item, file, line);
+}
+
+#endif /* MONITOR_HEAP */
+
+/* Give back every slab; whatever is still in them is gone too. */
+void
+free_pools()
+{
+    struct pool *pl;
+    struct pool_slab *slab;
+
+    for (pl = &pools[0]; pl != &pools[NUM_POOLS]; pl++) {
+        while ((slab = pl->slabs) != 0) {
+            pl->slabs = slab->next;
+            free((genericptr_t) slab);
+        }
+        pl->freelist = 0;
+        pl->stats.slabs = pl->stats.items = pl->stats.live = 0;
+    }
+}
+
+/* Copy out the occupancy of each pool, NLE_POOL_* order. */
+void
+nle_get_pool_stats(nle_ctx_t *nle, nle_pool_stats *stats)
+{
+    int p;
+
+    for (p = 0; p < NUM_POOLS; p++)
+        stats[p] = pools[p].stats;
+}
+
+/*nlepool.c*/
@@ -1,14 +1,7 @@
-#include "nlernd.h"
 #include "hack.h"
-#include "isaac64.h"
+#include "nlernd.h"
 
-/* See rng.c. */
-struct rnglist_t {
-    int FDECL((*fn), (int) );
-    boolean init;
-    isaac64_ctx rng_state;
-};
-extern struct rnglist_t rnglist[];
+/* See rnd.c. */
 extern int FDECL(whichrng, (int FDECL((*fn), (int) )));
 
 /* See hacklib.c. */
@@ -35,6 +28,10 @@ init_random(int FDECL((*fn), (int) ))
     } else {
         set_random(sys_random_seed(), fn);
     }
+    /* Replays re-simulate a game from its seeds, which NetHack's anti-TAS
+       reseeding from the system's entropy source would make impossible. */
+    if (settings.replayname[0] != '\0')
+        has_strong_rngseed = FALSE;
 }
 
 unsigned long nle_seeds[] = { 0L, 0L, 0L };
@@ -50,35 +47,27 @@ unsigned long nle_seeds[] = { 0L, 0L, 0L };
 /* Base LGEN RNG state, initialised via the seed &
    used in turn to sample seed values for the RNGs
    for each dungeon. */
-static struct isaac64_ctx nle_lgen_base;
+static nle_rng nle_lgen_base;
 
 /* RNG States for level generation, one for each dungeon */
-static struct isaac64_ctx nle_lgen_state[NLE_NUM_DUNGEONS];
+static nle_rng nle_lgen_state[NLE_NUM_DUNGEONS];
 
 /* State of the NetHack CORE RNG, used to remember what
    it was before we created the level and then restored
    after the level is ready. This allows for randomness
    during exploration / combat in-level. */
-static struct isaac64_ctx nle_core_state;
+static nle_rng nle_core_state;
 
 /* Some flags to help manage the lgen seed */
 static bool lgen_initialised = false;
 static bool lgen_active = false;
 
-/* Seeding function to initialise a fixed-level RNG state.
-   Borrowed from init_isaac64 in NetHack's rnd.c */
+/* Seeding function to initialise a fixed-level RNG state,
+   with the same generator as the core and disp RNGs. */
 void
-nle_init_lgen_state(unsigned long seed, struct isaac64_ctx *state)
+nle_init_lgen_state(unsigned long seed, nle_rng *state)
 {
-    unsigned char new_rng_state[sizeof seed];
-    unsigned i;
-
-    for (i = 0; i < sizeof seed; i++) {
-        new_rng_state[i] = (unsigned char) (seed & 0xFF);
-        seed >>= 8;
-    }
-
-    isaac64_init(state, new_rng_state, (int) sizeof seed);
+    nle_rng_init(state, settings.initial_seeds.rng, seed);
 }
 
 void
@@ -91,7 +80,7 @@ nle_init_lgen_rng()
 
         /* generate a new RNG for each of the dungeons */
         for (int i = 0; i < NLE_NUM_DUNGEONS; i++)
-            nle_init_lgen_state(isaac64_next_uint64(&nle_lgen_base),
+            nle_init_lgen_state(nle_rng_next(&nle_lgen_base),
                                 &(nle_lgen_state[i]));
 
         lgen_initialised = true;
@@ -140,6 +129,13 @@ nle_swap_to_core(int dungeon_num)
     }
 }
 
+/* The stream rn2() currently draws from. */
+int
+nle_core_stream()
+{
+    return lgen_active ? NLE_RNG_STREAM_LGEN : NLE_RNG_STREAM_CORE;
+}
+
 void
 nle_set_seed(nle_ctx_t *nle, unsigned long core, unsigned long disp,
              boolean reseed, unsigned long lgen)
@@ -165,4 +161,20 @@ nle_get_seed(nle_ctx_t *nle, unsigned long *core, unsigned long *disp,
     *reseed = has_strong_rngseed;
     *lgen = nle_seeds[2];
     *lgen_in_use = lgen_initialised;
-}
\ No newline at end of file
+}
+
+/* Restart the RNG accounting from zero, or turn it off. */
+void
+nle_set_rng_counting(nle_ctx_t *nle, boolean on)
+{
+    count_rng(on);
+}
+
+/* Copy out the RNG accounting so far; only the sites in use are copied. */
+void
+nle_get_rng_counts(nle_ctx_t *nle, nle_rng_counts *counts)
+{
+    memcpy(counts, &rng_counts,
+           offsetof(nle_rng_counts, sites)
+               + rng_counts.nsites * sizeof(nle_rng_site));
+}
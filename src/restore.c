@@ -1564,7 +1564,7 @@ STATIC_OVL int
 zerocomp_mgetc()
 {
     if (inbufp >= inbufsz) {
-        inbufsz = read(mreadfd, (genericptr_t) inbuf, sizeof inbuf);
+        inbufsz = nhread(mreadfd, (genericptr_t) inbuf, sizeof inbuf);
         if (!inbufsz) {
             if (inbufp > sizeof inbuf)
                 error("EOF on file #%d.\n", mreadfd);
@@ -1632,7 +1632,7 @@ register unsigned int len;
 #define readLenType unsigned
 #endif
 
-    rlen = read(fd, buf, (readLenType) len);
+    rlen = nhread(fd, buf, (readLenType) len);
     if ((readLenType) rlen != (readLenType) len) {
         if (restoreprocs.mread_flags == 1) { /* means "return anyway" */
             restoreprocs.mread_flags = -1;
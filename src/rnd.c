@@ -5,17 +5,14 @@
 #include "hack.h"
 
 #ifdef USE_ISAAC64
-#include "isaac64.h"
+#include "nlernd.h"
 
 #if 0
 static isaac64_ctx rng_state;
 #endif
 
-struct rnglist_t {
-    int FDECL((*fn), (int));
-    boolean init;
-    isaac64_ctx rng_state;
-};
+/* NLE settings pick the generator; see nle_seeds_init_t */
+extern nle_settings settings;
 
 enum { CORE = 0, DISP = 1 };
 
@@ -38,30 +35,189 @@ int FDECL((*fn), (int));
     return -1;
 }
 
+STATIC_DCL uint64_t FDECL(splitmix64, (uint64_t *));
+
+/* Step a splitmix64 generator; used to spread a seed over xoshiro's
+   state, as recommended by xoshiro's authors. */
+STATIC_OVL uint64_t
+splitmix64(x)
+uint64_t *x;
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+#define ROTL64(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+/* Seed an RNG stream with the given generator.  Unknown generators
+   fall back to ISAAC64. */
 void
-init_isaac64(seed, fn)
+nle_rng_init(rng, kind, seed)
+nle_rng *rng;
+int kind;
 unsigned long seed;
-int FDECL((*fn), (int));
 {
     unsigned char new_rng_state[sizeof seed];
+    uint64_t x;
     unsigned i;
+
+    if (kind == NLE_RNG_XOSHIRO) {
+        x = (uint64_t) seed;
+        for (i = 0; i < SIZE(rng->u.xoshiro); i++)
+            rng->u.xoshiro[i] = splitmix64(&x);
+    } else {
+        kind = NLE_RNG_ISAAC64;
+        for (i = 0; i < sizeof seed; i++) {
+            new_rng_state[i] = (unsigned char) (seed & 0xFF);
+            seed >>= 8;
+        }
+        isaac64_init(&rng->u.isaac64, new_rng_state, (int) sizeof seed);
+    }
+    rng->kind = kind;
+}
+
+/* Next 64 random bits from an RNG stream.  xoshiro256** is by David
+   Blackman and Sebastiano Vigna, placed in the public domain. */
+uint64_t
+nle_rng_next(rng)
+nle_rng *rng;
+{
+    uint64_t *s, result, t;
+
+    if (rng->kind != NLE_RNG_XOSHIRO)
+        return isaac64_next_uint64(&rng->u.isaac64);
+
+    s = rng->u.xoshiro;
+    result = ROTL64(s[1] * 5, 7) * 9;
+    t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ROTL64(s[3], 45);
+    return result;
+}
+
+/* Seed the stream behind fn with the generator chosen for this game. */
+void
+init_isaac64(seed, fn)
+unsigned long seed;
+int FDECL((*fn), (int));
+{
     int rngindx = whichrng(fn);
 
     if (rngindx < 0)
         panic("Bad rng function passed to init_isaac64().");
 
-    for (i = 0; i < sizeof seed; i++) {
-        new_rng_state[i] = (unsigned char) (seed & 0xFF);
-        seed >>= 8;
+    nle_rng_init(&rnglist[rngindx].rng_state, settings.initial_seeds.rng,
+                 seed);
+}
+
+/*
+ * NLE: optional accounting of RNG use, for finding who consumes which
+ * stream.  Only the outermost rn2() & co. of a call chain is counted, so
+ * the rn2()s inside rne() and rnz() are draws of those calls rather than
+ * calls of their own.  For NLE purposes, rng_counts isn't static either;
+ * see nle_get_rng_counts().
+ */
+nle_rng_counts rng_counts;
+static boolean rng_counting = FALSE;
+static int rng_depth;         /* nesting of counted calls */
+static int rng_stream;        /* stream of the outermost call */
+static nle_rng_site *rng_site; /* its entry in rng_counts.sites[] */
+/* Open addressing index into rng_counts.sites[], entries are index+1. */
+static short rng_site_index[2 * NLE_RNG_SITES];
+
+#ifdef __GNUC__
+#define RNG_CALLER ((unsigned long) __builtin_return_address(0))
+#else
+#define RNG_CALLER 0UL
+#endif
+#define RNG_ENTER(func, disp) \
+    if (rng_counting)         \
+        rng_enter(func, disp, RNG_CALLER)
+#define RNG_LEAVE()   \
+    if (rng_counting) \
+        --rng_depth
+
+STATIC_DCL void FDECL(rng_enter, (int, BOOLEAN_P, unsigned long));
+
+/* Start counting from zero, or stop counting. */
+void
+count_rng(on)
+boolean on;
+{
+    if (on) {
+        (void) memset((genericptr_t) &rng_counts, 0,
+                      offsetof(nle_rng_counts, sites));
+        (void) memset((genericptr_t) rng_site_index, 0,
+                      sizeof rng_site_index);
+    }
+    rng_depth = 0;
+    rng_counting = on;
+}
+
+STATIC_OVL void
+rng_enter(func, disp, caller)
+int func;
+boolean disp;
+unsigned long caller;
+{
+    unsigned long h;
+    nle_rng_site *site;
+    int i;
+
+    if (rng_depth++)
+        return;
+
+    rng_stream = disp ? NLE_RNG_STREAM_DISP : nle_core_stream();
+    rng_counts.calls[rng_stream][func]++;
+
+    h = (caller ^ (caller >> 13)) * 31 + func * 3 + rng_stream;
+    for (;;) {
+        i = rng_site_index[h % SIZE(rng_site_index)];
+        if (!i)
+            break;
+        site = &rng_counts.sites[i - 1];
+        if (site->caller == caller && site->func == func
+            && site->stream == rng_stream) {
+            rng_site = site;
+            site->calls++;
+            return;
+        }
+        h++;
+    }
+    if (rng_counts.nsites == NLE_RNG_SITES) {
+        rng_counts.lost++;
+        rng_site = (nle_rng_site *) 0;
+        return;
     }
-    isaac64_init(&rnglist[rngindx].rng_state, new_rng_state,
-                 (int) sizeof seed);
+    rng_site_index[h % SIZE(rng_site_index)] = ++rng_counts.nsites;
+    rng_site = site = &rng_counts.sites[rng_counts.nsites - 1];
+    site->caller = caller;
+    site->func = (unsigned char) func;
+    site->stream = (unsigned char) rng_stream;
+    site->calls = 1;
+    site->draws = 0;
 }
 
+/* Charge a draw to the call being counted. */
+#define RNG_DRAW()                      \
+    if (rng_counting) {                 \
+        rng_counts.draws[rng_stream]++; \
+        if (rng_site)                   \
+            rng_site->draws++;          \
+    }
+
 static int
 RND(int x)
 {
-    return (isaac64_next_uint64(&rnglist[CORE].rng_state) % x);
+    RNG_DRAW();
+    return (nle_rng_next(&rnglist[CORE].rng_state) % x);
 }
 
 /* 0 <= rn2(x) < x, but on a different sequence from the "main" rn2;
@@ -71,7 +227,11 @@ int
 rn2_on_display_rng(x)
 register int x;
 {
-    return (isaac64_next_uint64(&rnglist[DISP].rng_state) % x);
+    RNG_ENTER(NLE_RNG_RN2, TRUE);
+    RNG_DRAW();
+    x = (int) (nle_rng_next(&rnglist[DISP].rng_state) % x);
+    RNG_LEAVE();
+    return x;
 }
 
 #else   /* USE_ISAAC64 */
@@ -96,6 +256,9 @@ register int x;
     seed *= 2739110765;
     return (int)((seed >> 16) % (unsigned)x);
 }
+
+#define RNG_ENTER(func, disp)
+#define RNG_LEAVE()
 #endif  /* USE_ISAAC64 */
 
 /* 0 <= rn2(x) < x */
@@ -108,11 +271,11 @@ register int x;
         impossible("rn2(%d) attempted", x);
         return 0;
     }
+#endif
+    RNG_ENTER(NLE_RNG_RN2, FALSE);
     x = RND(x);
+    RNG_LEAVE();
     return x;
-#else
-    return RND(x);
-#endif
 }
 
 /* 0 <= rnl(x) < x; sometimes subtracting Luck;
@@ -130,6 +293,7 @@ register int x;
     }
 #endif
 
+    RNG_ENTER(NLE_RNG_RNL, FALSE);
     adjustment = Luck;
     if (x <= 15) {
         /* for small ranges, use Luck/3 (rounded away from 0);
@@ -157,6 +321,7 @@ register int x;
         else if (i >= x)
             i = x - 1;
     }
+    RNG_LEAVE();
     return i;
 }
 
@@ -171,7 +336,9 @@ register int x;
         return 1;
     }
 #endif
+    RNG_ENTER(NLE_RNG_RND, FALSE);
     x = RND(x) + 1;
+    RNG_LEAVE();
     return x;
 }
 
@@ -188,8 +355,10 @@ register int n, x;
         return 1;
     }
 #endif
+    RNG_ENTER(NLE_RNG_D, FALSE);
     while (n--)
         tmp += RND(x);
+    RNG_LEAVE();
     return tmp; /* Alea iacta est. -- J.C. */
 }
 
@@ -200,10 +369,12 @@ register int x;
 {
     register int tmp, utmp;
 
+    RNG_ENTER(NLE_RNG_RNE, FALSE);
     utmp = (u.ulevel < 15) ? 5 : u.ulevel / 3;
     tmp = 1;
     while (tmp < utmp && !rn2(x))
         tmp++;
+    RNG_LEAVE();
     return tmp;
 
     /* was:
@@ -229,6 +400,7 @@ int i;
     register long tmp = 1000L;
 #endif
 
+    RNG_ENTER(NLE_RNG_RNZ, FALSE);
     tmp += rn2(1000);
     tmp *= rne(4);
     if (rn2(2)) {
@@ -238,6 +410,7 @@ int i;
         x *= 1000;
         x /= tmp;
     }
+    RNG_LEAVE();
     return (int) x;
 }
 
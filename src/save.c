@@ -686,6 +686,12 @@ def_bufon(fd)
 int fd;
 {
 #ifdef UNIX
+#ifdef MEMORY_LEVELFILES
+    /* there is no stream to put on top of a level file kept in memory,
+       and writing to it is as cheap as buffering would be */
+    if (memlevel_fd(fd))
+        return;
+#endif
     if (bw_fd != fd) {
         if (bw_fd >= 0)
             panic("double buffering unexpected");
@@ -743,9 +749,9 @@ register unsigned num;
     {
         /* lint wants 3rd arg of write to be an int; lint -p an unsigned */
 #if defined(BSD) || defined(ULTRIX) || defined(WIN32) || defined(_MSC_VER)
-        failed = ((long) write(fd, loc, (int) num) != (long) num);
+        failed = ((long) nhwrite(fd, loc, (int) num) != (long) num);
 #else /* e.g. SYSV, __TURBOC__ */
-        failed = ((long) write(fd, loc, num) != (long) num);
+        failed = ((long) nhwrite(fd, loc, num) != (long) num);
 #endif
     }
 
@@ -811,7 +817,7 @@ int c;
         return;
 #endif
     if (outbufp >= sizeof outbuf) {
-        (void) write(bwritefd, outbuf, sizeof outbuf);
+        (void) nhwrite(bwritefd, outbuf, sizeof outbuf);
         outbufp = 0;
     }
     outbuf[outbufp++] = (unsigned char) c;
@@ -855,7 +861,7 @@ register int fd;
 #endif
 
     if (outbufp) {
-        if (write(fd, outbuf, outbufp) != outbufp) {
+        if (nhwrite(fd, outbuf, outbufp) != outbufp) {
 #if defined(UNIX) || defined(VMS) || defined(__EMX__)
             if (program_state.done_hup)
                 nh_terminate(EXIT_FAILURE);
@@ -881,7 +887,7 @@ register unsigned num;
         if (count_only)
             return;
 #endif
-        if ((unsigned) write(fd, loc, num) != num) {
+        if ((unsigned) nhwrite(fd, loc, num) != num) {
 #if defined(UNIX) || defined(VMS) || defined(__EMX__)
             if (program_state.done_hup)
                 nh_terminate(EXIT_FAILURE);
@@ -1302,6 +1308,17 @@ const char *suitename;
 #endif
 }
 
+/* NLE: nlelevel.c drops whatever a level sent elsewhere, such as the
+   orc gang and booty of a ransacked Minetown. */
+void
+nle_free_migrating()
+{
+    saveobjchn(0, migrating_objs, FREE_SAVE);
+    migrating_objs = 0;
+    savemonchn(0, migrating_mons, FREE_SAVE);
+    migrating_mons = 0;
+}
+
 /* also called by prscore(); this probably belongs in dungeon.c... */
 void
 free_dungeons()
@@ -1323,6 +1340,9 @@ freedynamicdata()
     free_menu_coloring();
     free_invbuf();           /* let_to_name (invent.c) */
     free_youbuf();           /* You_buf,&c (pline.c) */
+#ifdef MEMORY_LEVELFILES
+    free_levelfiles();       /* files.c */
+#endif
     msgtype_free();
     tmp_at(DISP_FREEMEM, 0); /* temporary display effects */
 #ifdef FREE_ALL_MEMORY
@@ -1359,6 +1379,7 @@ freedynamicdata()
     freenames();
     free_waterlevel();
     free_dungeons();
+    free_pools(); /* after everything that held monsters or objects */
 
     /* some pointers in iflags */
     if (iflags.wc_font_map)
@@ -191,6 +191,10 @@ extern struct engr *head_engr;
 
 extern int min_rx, max_rx, min_ry, max_ry; /* from mkmap.c */
 
+/* Process-wide cache of loaded levels, see nle.c. */
+extern genericptr_t FDECL(nle_splev_lookup, (const char *));
+extern genericptr_t FDECL(nle_splev_insert, (const char *, genericptr_t));
+
 /* positions touched by level elements explicitly defined in the des-file */
 static char SpLev_Map[COLNO][ROWNO];
 
@@ -672,6 +676,16 @@ shuffle_alignments()
     }
 }
 
+/* NLE: shuffle_alignments() permutes the last shuffle; nlelevel.c starts
+   each level it makes from the same order. */
+void
+nle_reset_alignments()
+{
+    ralign[0] = AM_CHAOTIC;
+    ralign[1] = AM_NEUTRAL;
+    ralign[2] = AM_LAWFUL;
+}
+
 /*
  * Count the different features (sinks, fountains) in the level.
  */
@@ -6035,10 +6049,15 @@ load_special(name)
 const char *name;
 {
     dlb *fd;
-    sp_lev *lvl = NULL;
+    sp_lev *lvl = NULL, *cached;
     boolean result = FALSE;
     struct version_info vers_info;
 
+    /* NLE: sp_level_coder() doesn't modify the program, so a level parsed
+     * by any instance in the process can be run as is. */
+    if ((cached = (sp_lev *) nle_splev_lookup(name)) != 0)
+        return sp_level_coder(cached);
+
     fd = dlb_fopen(name, RDBMODE);
     if (!fd)
         return FALSE;
@@ -6051,10 +6070,16 @@ const char *name;
     lvl = (sp_lev *) alloc(sizeof (sp_lev));
     result = sp_level_loader(fd, lvl);
     (void) dlb_fclose(fd);
-    if (result)
+    cached = result ? (sp_lev *) nle_splev_insert(name, (genericptr_t) lvl)
+                    : (sp_lev *) 0;
+    if (cached != lvl) {
+        if (result)
+            result = sp_level_coder(cached ? cached : lvl);
+        sp_level_free(lvl);
+        Free(lvl);
+    } else {
         result = sp_level_coder(lvl);
-    sp_level_free(lvl);
-    Free(lvl);
+    }
 
 give_up:
     return result;
@@ -1636,7 +1636,7 @@ do_storms()
  *      Start a timer of kind 'kind' that will expire at time
  *      monstermoves+'timeout'.  Call the function at 'func_index'
  *      in the timeout table using argument 'arg'.  Return TRUE if
- *      a timer was started.  This places the timer on a list ordered
+ *      a timer was started.  This places the timer in a queue ordered
  *      "sooner" to "later".  If an object, increment the object's
  *      timer count.
  *
@@ -1682,19 +1682,53 @@ do_storms()
  *      Check whether object has a timer of type timer_type.
  */
 
+/*
+ * The active timers are kept in a binary min-heap ordered by timeout, so
+ * starting a timer and picking off the next one to run are O(log n)
+ * instead of a walk down a sorted list.  Of the timers due on the same
+ * turn, the one queued last comes first, just as when new timers were
+ * inserted ahead of their equals in that list.
+ *
+ * Each timer is also chained into a hash bucket chosen by its argument,
+ * so looking up the timers of one object or one spot only walks that
+ * bucket.  The timer_element inside a node is still exactly what save
+ * files hold; its 'next' field is no longer used.
+ */
+typedef struct timer_node {
+    timer_element te;
+    struct timer_node *hnext; /* next in hash bucket */
+    unsigned long seq;        /* queueing order, breaks timeout ties */
+    int hidx;                 /* index in timer_heap[] */
+} timer_node;
+
+#define TIMER_BUCKETS 512 /* power of 2 */
+
 STATIC_DCL const char *FDECL(kind_name, (SHORT_P));
-STATIC_DCL void FDECL(print_queue, (winid, timer_element *));
-STATIC_DCL void FDECL(insert_timer, (timer_element *));
-STATIC_DCL timer_element *FDECL(remove_timer,
-                                (timer_element **, SHORT_P, ANY_P *));
+STATIC_DCL void FDECL(print_queue, (winid));
+STATIC_DCL boolean FDECL(timer_before, (timer_node *, timer_node *));
+STATIC_DCL void FDECL(heap_set, (int, timer_node *));
+STATIC_DCL void FDECL(heap_up, (int));
+STATIC_DCL void FDECL(heap_down, (int));
+STATIC_DCL timer_node **FDECL(timer_bucket, (anything *));
+STATIC_DCL void FDECL(link_timer, (timer_node *));
+STATIC_DCL void FDECL(unlink_timer, (timer_node *));
+STATIC_DCL void FDECL(insert_timer, (timer_node *));
+STATIC_DCL void FDECL(remove_timer, (timer_node *));
+STATIC_DCL void NDECL(rebuild_timers);
+STATIC_DCL int FDECL(cmp_timers, (const genericptr, const genericptr));
+STATIC_DCL timer_node **NDECL(sorted_timers);
+STATIC_DCL timer_node *FDECL(find_timer, (SHORT_P, ANY_P *));
 STATIC_DCL void FDECL(write_timer, (int, timer_element *));
 STATIC_DCL boolean FDECL(mon_is_local, (struct monst *));
 STATIC_DCL boolean FDECL(timer_is_local, (timer_element *));
 STATIC_DCL int FDECL(maybe_write_timer, (int, int, BOOLEAN_P));
 
-/* ordered timer list */
-static timer_element *timer_base; /* "active" */
+/* timer queue */
+static timer_node **timer_heap; /* "active" */
+static int timer_count, timer_heap_size;
+static timer_node *timer_buckets[TIMER_BUCKETS];
 static unsigned long timer_id = 1;
+static unsigned long timer_seq = 0;
 
 /* If defined, then include names when printing out the timer queue */
 #define VERBOSE_TIMER
@@ -1745,18 +1779,21 @@ short kind;
 }
 
 STATIC_OVL void
-print_queue(win, base)
+print_queue(win)
 winid win;
-timer_element *base;
 {
+    timer_node **sorted;
     timer_element *curr;
     char buf[BUFSZ];
+    int i;
 
-    if (!base) {
+    if (!timer_count) {
         putstr(win, 0, " <empty>");
     } else {
         putstr(win, 0, "timeout  id   kind   call");
-        for (curr = base; curr; curr = curr->next) {
+        sorted = sorted_timers();
+        for (i = 0; i < timer_count; i++) {
+            curr = &sorted[i]->te;
 #ifdef VERBOSE_TIMER
             Sprintf(buf, " %4ld   %4ld  %-6s %s(%s)", curr->timeout,
                     curr->tid, kind_name(curr->kind),
@@ -1769,6 +1806,7 @@ timer_element *base;
 #endif
             putstr(win, 0, buf);
         }
+        free((genericptr_t) sorted);
     }
 }
 
@@ -1790,7 +1828,7 @@ wiz_timeout_queue()
     putstr(win, 0, "");
     putstr(win, 0, "Active timeout queue:");
     putstr(win, 0, "");
-    print_queue(win, timer_base);
+    print_queue(win);
 
     /* Timed properies:
      * check every one; the majority can't obtain temporary timeouts in
@@ -1842,9 +1880,16 @@ void
 timer_sanity_check()
 {
     timer_element *curr;
+    int i;
 
     /* this should be much more complete */
-    for (curr = timer_base; curr; curr = curr->next)
+    for (i = 0; i < timer_count; i++) {
+        curr = &timer_heap[i]->te;
+        if (timer_heap[i]->hidx != i
+            || (i > 0
+                && timer_before(timer_heap[i], timer_heap[(i - 1) / 2])))
+            impossible("timer sanity: heap out of order at %d, timer %ld",
+                       i, curr->tid);
         if (curr->kind == TIMER_OBJECT) {
             struct obj *obj = curr->arg.a_obj;
 
@@ -1853,6 +1898,7 @@ timer_sanity_check()
                       fmt_ptr((genericptr_t) obj), curr->tid);
             }
         }
+    }
 }
 
 /*
@@ -1862,20 +1908,21 @@ timer_sanity_check()
 void
 run_timers()
 {
-    timer_element *curr;
+    timer_node *curr;
 
     /*
-     * Always use the first element.  Elements may be added or deleted at
-     * any time.  The list is ordered, we are done when the first element
+     * Always use the top of the heap.  Elements may be added or deleted at
+     * any time.  The heap is ordered, we are done when its top element
      * is in the future.
      */
-    while (timer_base && timer_base->timeout <= monstermoves) {
-        curr = timer_base;
-        timer_base = curr->next;
-
-        if (curr->kind == TIMER_OBJECT)
-            (curr->arg.a_obj)->timed--;
-        (*timeout_funcs[curr->func_index].f)(&curr->arg, curr->timeout);
+    while (timer_count && timer_heap[0]->te.timeout <= monstermoves) {
+        curr = timer_heap[0];
+        remove_timer(curr);
+
+        if (curr->te.kind == TIMER_OBJECT)
+            (curr->te.arg.a_obj)->timed--;
+        (*timeout_funcs[curr->te.func_index].f)(&curr->te.arg,
+                                                curr->te.timeout);
         free((genericptr_t) curr);
     }
 }
@@ -1890,17 +1937,17 @@ short kind;
 short func_index;
 anything *arg;
 {
-    timer_element *gnu, *dup;
+    timer_node *gnu, *dup;
 
     if (kind < 0 || kind >= NUM_TIMER_KINDS
         || func_index < 0 || func_index >= NUM_TIME_FUNCS)
         panic("start_timer (%s: %d)", kind_name(kind), (int) func_index);
 
     /* fail if <arg> already has a <func_index> timer running */
-    for (dup = timer_base; dup; dup = dup->next)
-        if (dup->kind == kind
-            && dup->func_index == func_index
-            && dup->arg.a_void == arg->a_void)
+    for (dup = *timer_bucket(arg); dup; dup = dup->hnext)
+        if (dup->te.kind == kind
+            && dup->te.func_index == func_index
+            && dup->te.arg.a_void == arg->a_void)
             break;
     if (dup) {
         char idbuf[QBUFSZ];
@@ -1914,15 +1961,15 @@ anything *arg;
         return FALSE;
     }
 
-    gnu = (timer_element *) alloc(sizeof *gnu);
+    gnu = (timer_node *) alloc(sizeof *gnu);
     (void) memset((genericptr_t) gnu, 0, sizeof *gnu);
-    gnu->next = 0;
-    gnu->tid = timer_id++;
-    gnu->timeout = monstermoves + when;
-    gnu->kind = kind;
-    gnu->needs_fixup = 0;
-    gnu->func_index = func_index;
-    gnu->arg = *arg;
+    gnu->te.next = 0;
+    gnu->te.tid = timer_id++;
+    gnu->te.timeout = monstermoves + when;
+    gnu->te.kind = kind;
+    gnu->te.needs_fixup = 0;
+    gnu->te.func_index = func_index;
+    gnu->te.arg = *arg;
     insert_timer(gnu);
 
     if (kind == TIMER_OBJECT) /* increment object's timed count */
@@ -1940,17 +1987,18 @@ stop_timer(func_index, arg)
 short func_index;
 anything *arg;
 {
-    timer_element *doomed;
+    timer_node *doomed;
     long timeout;
 
-    doomed = remove_timer(&timer_base, func_index, arg);
+    doomed = find_timer(func_index, arg);
 
     if (doomed) {
-        timeout = doomed->timeout;
-        if (doomed->kind == TIMER_OBJECT)
+        remove_timer(doomed);
+        timeout = doomed->te.timeout;
+        if (doomed->te.kind == TIMER_OBJECT)
             (arg->a_obj)->timed--;
-        if (timeout_funcs[doomed->func_index].cleanup)
-            (*timeout_funcs[doomed->func_index].cleanup)(arg, timeout);
+        if (timeout_funcs[doomed->te.func_index].cleanup)
+            (*timeout_funcs[doomed->te.func_index].cleanup)(arg, timeout);
         free((genericptr_t) doomed);
         return (timeout - monstermoves);
     }
@@ -1965,13 +2013,9 @@ peek_timer(type, arg)
 short type;
 anything *arg;
 {
-    timer_element *curr;
+    timer_node *curr = find_timer(type, arg);
 
-    for (curr = timer_base; curr; curr = curr->next) {
-        if (curr->func_index == type && curr->arg.a_void == arg->a_void)
-            return curr->timeout;
-    }
-    return 0L;
+    return curr ? curr->te.timeout : 0L;
 }
 
 /*
@@ -1982,14 +2026,24 @@ obj_move_timers(src, dest)
 struct obj *src, *dest;
 {
     int count;
-    timer_element *curr;
-
-    for (count = 0, curr = timer_base; curr; curr = curr->next)
-        if (curr->kind == TIMER_OBJECT && curr->arg.a_obj == src) {
-            curr->arg.a_obj = dest;
-            dest->timed++;
-            count++;
+    timer_node *curr, **prev, *moved = 0;
+
+    /* take them out of src's bucket, then put them into dest's */
+    for (count = 0, prev = timer_bucket(obj_to_any(src)); (curr = *prev);)
+        if (curr->te.kind == TIMER_OBJECT && curr->te.arg.a_obj == src) {
+            *prev = curr->hnext;
+            curr->hnext = moved;
+            moved = curr;
+        } else {
+            prev = &curr->hnext;
         }
+    while ((curr = moved) != 0) {
+        moved = curr->hnext;
+        curr->te.arg.a_obj = dest;
+        link_timer(curr);
+        dest->timed++;
+        count++;
+    }
     if (count != src->timed)
         panic("obj_move_timers");
     src->timed = 0;
@@ -2002,15 +2056,23 @@ void
 obj_split_timers(src, dest)
 struct obj *src, *dest;
 {
-    timer_element *curr, *next_timer = 0;
-
-    for (curr = timer_base; curr; curr = next_timer) {
-        next_timer = curr->next; /* things may be inserted */
-        if (curr->kind == TIMER_OBJECT && curr->arg.a_obj == src) {
-            (void) start_timer(curr->timeout - monstermoves, TIMER_OBJECT,
-                               curr->func_index, obj_to_any(dest));
+    timer_node *curr, *found[NUM_TIME_FUNCS];
+    int i, j, n = 0;
+
+    /* things may be inserted, so collect them first; dest gets its
+       timers queued in the order src's would run */
+    for (curr = *timer_bucket(obj_to_any(src)); curr;
+         curr = curr->hnext)
+        if (curr->te.kind == TIMER_OBJECT && curr->te.arg.a_obj == src) {
+            if (n == NUM_TIME_FUNCS)
+                panic("obj_split_timers");
+            for (j = n++; j > 0 && timer_before(curr, found[j - 1]); j--)
+                found[j] = found[j - 1];
+            found[j] = curr;
         }
-    }
+    for (i = 0; i < n; i++)
+        (void) start_timer(found[i]->te.timeout - monstermoves, TIMER_OBJECT,
+                           found[i]->te.func_index, obj_to_any(dest));
 }
 
 /*
@@ -2021,21 +2083,16 @@ void
 obj_stop_timers(obj)
 struct obj *obj;
 {
-    timer_element *curr, *prev, *next_timer = 0;
-
-    for (prev = 0, curr = timer_base; curr; curr = next_timer) {
-        next_timer = curr->next;
-        if (curr->kind == TIMER_OBJECT && curr->arg.a_obj == obj) {
-            if (prev)
-                prev->next = curr->next;
-            else
-                timer_base = curr->next;
-            if (timeout_funcs[curr->func_index].cleanup)
-                (*timeout_funcs[curr->func_index].cleanup)(&curr->arg,
-                                                           curr->timeout);
+    timer_node *curr, *next_timer = 0;
+
+    for (curr = *timer_bucket(obj_to_any(obj)); curr; curr = next_timer) {
+        next_timer = curr->hnext;
+        if (curr->te.kind == TIMER_OBJECT && curr->te.arg.a_obj == obj) {
+            remove_timer(curr);
+            if (timeout_funcs[curr->te.func_index].cleanup)
+                (*timeout_funcs[curr->te.func_index].cleanup)(
+                    &curr->te.arg, curr->te.timeout);
             free((genericptr_t) curr);
-        } else {
-            prev = curr;
         }
     }
     obj->timed = 0;
@@ -2063,23 +2120,18 @@ spot_stop_timers(x, y, func_index)
 xchar x, y;
 short func_index;
 {
-    timer_element *curr, *prev, *next_timer = 0;
+    timer_node *curr, *next_timer = 0;
     long where = (((long) x << 16) | ((long) y));
 
-    for (prev = 0, curr = timer_base; curr; curr = next_timer) {
-        next_timer = curr->next;
-        if (curr->kind == TIMER_LEVEL && curr->func_index == func_index
-            && curr->arg.a_long == where) {
-            if (prev)
-                prev->next = curr->next;
-            else
-                timer_base = curr->next;
-            if (timeout_funcs[curr->func_index].cleanup)
-                (*timeout_funcs[curr->func_index].cleanup)(&curr->arg,
-                                                           curr->timeout);
+    for (curr = *timer_bucket(long_to_any(where)); curr; curr = next_timer) {
+        next_timer = curr->hnext;
+        if (curr->te.kind == TIMER_LEVEL && curr->te.func_index == func_index
+            && curr->te.arg.a_long == where) {
+            remove_timer(curr);
+            if (timeout_funcs[curr->te.func_index].cleanup)
+                (*timeout_funcs[curr->te.func_index].cleanup)(
+                    &curr->te.arg, curr->te.timeout);
             free((genericptr_t) curr);
-        } else {
-            prev = curr;
         }
     }
 }
@@ -2093,13 +2145,14 @@ spot_time_expires(x, y, func_index)
 xchar x, y;
 short func_index;
 {
-    timer_element *curr;
+    timer_node *curr;
     long where = (((long) x << 16) | ((long) y));
 
-    for (curr = timer_base; curr; curr = curr->next) {
-        if (curr->kind == TIMER_LEVEL && curr->func_index == func_index
-            && curr->arg.a_long == where)
-            return curr->timeout;
+    for (curr = *timer_bucket(long_to_any(where)); curr;
+         curr = curr->hnext) {
+        if (curr->te.kind == TIMER_LEVEL && curr->te.func_index == func_index
+            && curr->te.arg.a_long == where)
+            return curr->te.timeout;
     }
     return 0L;
 }
@@ -2113,43 +2166,195 @@ short func_index;
     return (expires > 0L) ? expires - monstermoves : 0L;
 }
 
-/* Insert timer into the global queue */
+/* Does timer a go off before timer b? */
+STATIC_OVL boolean
+timer_before(a, b)
+timer_node *a, *b;
+{
+    if (a->te.timeout != b->te.timeout)
+        return (boolean) (a->te.timeout < b->te.timeout);
+    return (boolean) (a->seq > b->seq);
+}
+
 STATIC_OVL void
-insert_timer(gnu)
-timer_element *gnu;
+heap_set(i, t)
+int i;
+timer_node *t;
 {
-    timer_element *curr, *prev;
+    timer_heap[i] = t;
+    t->hidx = i;
+}
 
-    for (prev = 0, curr = timer_base; curr; prev = curr, curr = curr->next)
-        if (curr->timeout >= gnu->timeout)
+STATIC_OVL void
+heap_up(i)
+int i;
+{
+    timer_node *t = timer_heap[i];
+    int parent;
+
+    for (; i > 0; i = parent) {
+        parent = (i - 1) / 2;
+        if (!timer_before(t, timer_heap[parent]))
             break;
+        heap_set(i, timer_heap[parent]);
+    }
+    heap_set(i, t);
+}
 
-    gnu->next = curr;
-    if (prev)
-        prev->next = gnu;
-    else
-        timer_base = gnu;
+STATIC_OVL void
+heap_down(i)
+int i;
+{
+    timer_node *t = timer_heap[i];
+    int child;
+
+    for (; (child = 2 * i + 1) < timer_count; i = child) {
+        if (child + 1 < timer_count
+            && timer_before(timer_heap[child + 1], timer_heap[child]))
+            child++;
+        if (!timer_before(timer_heap[child], t))
+            break;
+        heap_set(i, timer_heap[child]);
+    }
+    heap_set(i, t);
 }
 
-STATIC_OVL timer_element *
-remove_timer(base, func_index, arg)
-timer_element **base;
-short func_index;
+/* Hash bucket for timers with argument arg */
+STATIC_OVL timer_node **
+timer_bucket(arg)
 anything *arg;
 {
-    timer_element *prev, *curr;
+    unsigned long h = arg->a_ulong;
 
-    for (prev = 0, curr = *base; curr; prev = curr, curr = curr->next)
-        if (curr->func_index == func_index && curr->arg.a_void == arg->a_void)
-            break;
+    h ^= (h >> 4) ^ (h >> 13);
+    return &timer_buckets[h & (TIMER_BUCKETS - 1)];
+}
 
-    if (curr) {
-        if (prev)
-            prev->next = curr->next;
+STATIC_OVL void
+link_timer(t)
+timer_node *t;
+{
+    timer_node **bucket = timer_bucket(&t->te.arg);
+
+    t->hnext = *bucket;
+    *bucket = t;
+}
+
+STATIC_OVL void
+unlink_timer(t)
+timer_node *t;
+{
+    timer_node **prev = timer_bucket(&t->te.arg);
+
+    while (*prev != t) {
+        if (!*prev)
+            panic("unlink_timer");
+        prev = &(*prev)->hnext;
+    }
+    *prev = t->hnext;
+    t->hnext = 0;
+}
+
+/* Insert timer into the global queue */
+STATIC_OVL void
+insert_timer(gnu)
+timer_node *gnu;
+{
+    if (timer_count == timer_heap_size) {
+        int size = max(2 * timer_heap_size, 64);
+        timer_node **heap = (timer_node **) alloc(size * sizeof *heap);
+
+        if (timer_count)
+            (void) memcpy((genericptr_t) heap, (genericptr_t) timer_heap,
+                          timer_count * sizeof *heap);
+        if (timer_heap)
+            free((genericptr_t) timer_heap);
+        timer_heap = heap;
+        timer_heap_size = size;
+    }
+    gnu->seq = ++timer_seq;
+    heap_set(timer_count++, gnu);
+    heap_up(gnu->hidx);
+    link_timer(gnu);
+}
+
+/* Take timer out of the global queue, without freeing it */
+STATIC_OVL void
+remove_timer(t)
+timer_node *t;
+{
+    int i = t->hidx;
+
+    unlink_timer(t);
+    if (i != --timer_count) {
+        heap_set(i, timer_heap[timer_count]);
+        if (i > 0 && timer_before(timer_heap[i], timer_heap[(i - 1) / 2]))
+            heap_up(i);
         else
-            *base = curr->next;
+            heap_down(i);
     }
+}
+
+/*
+ * Redo the buckets and the heap order of timer_heap[0..timer_count-1], after
+ * timers were dropped from it or had their arguments changed.
+ */
+STATIC_OVL void
+rebuild_timers()
+{
+    int i;
 
+    (void) memset((genericptr_t) timer_buckets, 0, sizeof timer_buckets);
+    for (i = 0; i < timer_count; i++) {
+        heap_set(i, timer_heap[i]);
+        link_timer(timer_heap[i]);
+    }
+    for (i = timer_count / 2 - 1; i >= 0; i--)
+        heap_down(i);
+    if (!timer_count && timer_heap) {
+        free((genericptr_t) timer_heap);
+        timer_heap = (timer_node **) 0;
+        timer_heap_size = 0;
+    }
+}
+
+STATIC_OVL int
+cmp_timers(vptr1, vptr2)
+const genericptr vptr1;
+const genericptr vptr2;
+{
+    timer_node *a = *(timer_node **) vptr1, *b = *(timer_node **) vptr2;
+
+    return timer_before(a, b) ? -1 : timer_before(b, a) ? 1 : 0;
+}
+
+/* Copy of the queue in the order the timers will run; caller frees it */
+STATIC_OVL timer_node **
+sorted_timers()
+{
+    timer_node **sorted;
+
+    sorted = (timer_node **) alloc(max(timer_count, 1) * sizeof *sorted);
+    if (timer_count) {
+        (void) memcpy((genericptr_t) sorted, (genericptr_t) timer_heap,
+                      timer_count * sizeof *sorted);
+        qsort((genericptr_t) sorted, timer_count, sizeof *sorted, cmp_timers);
+    }
+    return sorted;
+}
+
+/* Find the func_index timer with argument arg */
+STATIC_OVL timer_node *
+find_timer(func_index, arg)
+short func_index;
+anything *arg;
+{
+    timer_node *curr;
+
+    for (curr = *timer_bucket(arg); curr; curr = curr->hnext)
+        if (curr->te.func_index == func_index
+            && curr->te.arg.a_void == arg->a_void)
+            break;
     return curr;
 }
 
@@ -2279,10 +2484,14 @@ maybe_write_timer(fd, range, write_it)
 int fd, range;
 boolean write_it;
 {
-    int count = 0;
+    int count = 0, i;
+    timer_node **sorted;
     timer_element *curr;
 
-    for (curr = timer_base; curr; curr = curr->next) {
+    /* write them in the order they run, as the timer list used to be */
+    sorted = write_it ? sorted_timers() : timer_heap;
+    for (i = 0; i < timer_count; i++) {
+        curr = &sorted[i]->te;
         if (range == RANGE_GLOBAL) {
             /* global timers */
 
@@ -2302,6 +2511,8 @@ boolean write_it;
             }
         }
     }
+    if (write_it)
+        free((genericptr_t) sorted);
 
     return count;
 }
@@ -2323,8 +2534,8 @@ void
 save_timers(fd, mode, range)
 int fd, mode, range;
 {
-    timer_element *curr, *prev, *next_timer = 0;
-    int count;
+    timer_node *curr;
+    int count, i;
 
     if (perform_bwrite(mode)) {
         if (range == RANGE_GLOBAL)
@@ -2336,20 +2547,16 @@ int fd, mode, range;
     }
 
     if (release_data(mode)) {
-        for (prev = 0, curr = timer_base; curr; curr = next_timer) {
-            next_timer = curr->next; /* in case curr is removed */
+        for (count = i = 0; i < timer_count; i++) {
+            curr = timer_heap[i];
 
-            if (!(!!(range == RANGE_LEVEL) ^ !!timer_is_local(curr))) {
-                if (prev)
-                    prev->next = curr->next;
-                else
-                    timer_base = curr->next;
+            if (!(!!(range == RANGE_LEVEL) ^ !!timer_is_local(&curr->te)))
                 free((genericptr_t) curr);
-                /* prev stays the same */
-            } else {
-                prev = curr;
-            }
+            else
+                timer_heap[count++] = curr;
         }
+        timer_count = count;
+        rebuild_timers();
     }
 }
 
@@ -2364,7 +2571,7 @@ boolean ghostly; /* restoring from a ghost level */
 long adjust;     /* how much to adjust timeout */
 {
     int count;
-    timer_element *curr;
+    timer_node *curr;
 
     if (range == RANGE_GLOBAL)
         mread(fd, (genericptr_t) &timer_id, sizeof timer_id);
@@ -2372,10 +2579,11 @@ long adjust;     /* how much to adjust timeout */
     /* restore elements */
     mread(fd, (genericptr_t) &count, sizeof count);
     while (count-- > 0) {
-        curr = (timer_element *) alloc(sizeof(timer_element));
-        mread(fd, (genericptr_t) curr, sizeof(timer_element));
+        curr = (timer_node *) alloc(sizeof(timer_node));
+        mread(fd, (genericptr_t) &curr->te, sizeof(timer_element));
+        curr->te.next = 0;
         if (ghostly)
-            curr->timeout += adjust;
+            curr->te.timeout += adjust;
         insert_timer(curr);
     }
 }
@@ -2387,14 +2595,10 @@ const char *hdrfmt;
 char *hdrbuf;
 long *count, *size;
 {
-    timer_element *te;
-
-    Sprintf(hdrbuf, hdrfmt, (long) sizeof (timer_element));
-    *count = *size = 0L;
-    for (te = timer_base; te; te = te->next) {
-        ++*count;
-        *size += (long) sizeof *te;
-    }
+    Sprintf(hdrbuf, hdrfmt, (long) sizeof (timer_node));
+    *count = (long) timer_count;
+    *size = (long) (timer_count * sizeof (timer_node)
+                    + timer_heap_size * sizeof (timer_node *));
 }
 
 /* reset all timers that are marked for reseting */
@@ -2404,9 +2608,12 @@ boolean ghostly;
 {
     timer_element *curr;
     unsigned nid;
+    int i, fixed = 0;
 
-    for (curr = timer_base; curr; curr = curr->next) {
+    for (i = 0; i < timer_count; i++) {
+        curr = &timer_heap[i]->te;
         if (curr->needs_fixup) {
+            fixed++;
             if (curr->kind == TIMER_OBJECT) {
                 if (ghostly) {
                     if (!lookup_id_mapping(curr->arg.a_uint, &nid))
@@ -2423,6 +2630,9 @@ boolean ghostly;
                 panic("relink_timers 2");
         }
     }
+    /* the arguments changed from ids to pointers, so did their buckets */
+    if (fixed)
+        rebuild_timers();
 }
 
 /*timeout.c*/
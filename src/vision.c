@@ -93,6 +93,29 @@ static char *viz_clear_rows[ROWNO];
 static char left_ptrs[ROWNO][COLNO]; /* LOS algorithm helpers */
 static char right_ptrs[ROWNO][COLNO];
 
+#ifdef VISION_BITBOARD
+/*
+ * Row bitsets.  Bit (col % VB_WORDBITS) of word (col / VB_WORDBITS) stands
+ * for column col.  viz_clear_bits[] mirrors viz_clear[] and is kept up to
+ * date by vision_reset(), dig_point() and fill_point().
+ *
+ * The line of sight code marks what the hero could see in viz_cs_bits[];
+ * view_from() then copies the bits into the could see array proper.
+ */
+typedef unsigned long vbits;
+#define VB_WORDBITS ((int) (8 * sizeof (vbits)))
+#define VB_WORDS ((COLNO + VB_WORDBITS - 1) / VB_WORDBITS)
+#define vb_word(col) ((col) / VB_WORDBITS)
+#define vb_bit(col) ((vbits) 1 << ((col) % VB_WORDBITS))
+#define vb_test(bits, col) ((bits)[vb_word(col)] & vb_bit(col))
+/* bits first through last of a word, 0 <= first <= last < VB_WORDBITS */
+#define vb_span(first, last) \
+    (((vbits) ~0 << (first)) & ((vbits) ~0 >> (VB_WORDBITS - 1 - (last))))
+
+static vbits viz_clear_bits[ROWNO][VB_WORDS];
+static vbits viz_cs_bits[ROWNO][VB_WORDS]; /* could see, being worked out */
+#endif
+
 /* Forward declarations. */
 STATIC_DCL void FDECL(fill_point, (int, int));
 STATIC_DCL void FDECL(dig_point, (int, int));
@@ -102,6 +125,13 @@ STATIC_DCL void FDECL(view_from, (int, int, char **, char *, char *, int,
                                   genericptr_t));
 STATIC_DCL void FDECL(get_unused_cs, (char ***, char **, char **));
 STATIC_DCL void FDECL(rogue_vision, (char **, char *, char *));
+#ifdef VISION_BITBOARD
+STATIC_DCL int FDECL(vb_lowbit, (vbits));
+STATIC_DCL void FDECL(vb_row, (char *, int, int, int, vbits *));
+STATIC_DCL int FDECL(vb_next, (vbits *, int));
+STATIC_DCL void FDECL(vb_set_run, (vbits *, int, int));
+STATIC_DCL boolean FDECL(vb_clear_run, (int, int, int));
+#endif
 
 /* Macro definitions that I can't find anywhere. */
 #define sign(z) ((z) < 0 ? -1 : ((z) ? 1 : 0))
@@ -240,8 +270,13 @@ vision_reset()
             right_ptrs[y][i] = (COLNO - 1);
             viz_clear[y][i] = !block;
         }
+#ifdef VISION_BITBOARD
+        vb_row(viz_clear[y], 0, COLNO - 1, 1, viz_clear_bits[y]);
+#endif
     }
 
+    forget_lit_areas(-1, -1); /* every lit area has to be redone */
+
     iflags.vision_inited = 1; /* vision is ready */
     vision_full_recalc = 1;   /* we want to run vision_recalc() */
 }
@@ -282,6 +317,131 @@ char **rmin, **rmax;
     }
 }
 
+#ifdef VISION_BITBOARD
+/*
+ * vb_lowbit()
+ *
+ * Return the index of the lowest set bit of a non-zero bitset word.
+ */
+STATIC_OVL int
+vb_lowbit(w)
+vbits w;
+{
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+    return __builtin_ctzl(w);
+#else
+    int i = 0;
+
+    while (!(w & 0xff))
+        w >>= 8, i += 8;
+    while (!(w & 1))
+        w >>= 1, i++;
+    return i;
+#endif
+}
+
+/*
+ * vb_row()
+ *
+ * Collect the columns start..stop of a vision row that have any of the
+ * bits in mask set into the bitset bits.  The row is scanned a word at
+ * a time so that long runs of nothing cost next to nothing.
+ */
+STATIC_OVL void
+vb_row(rowp, start, stop, mask, bits)
+char *rowp;
+int start, stop, mask;
+vbits *bits;
+{
+    int col, i, end;
+    vbits chunk, wide = ((vbits) ~0 / 0xff) * (uchar) mask;
+
+    for (i = 0; i < VB_WORDS; i++)
+        bits[i] = 0;
+    for (col = start - start % (int) sizeof chunk; col <= stop;
+         col += (int) sizeof chunk) {
+        if (col + (int) sizeof chunk <= COLNO) {
+            (void) memcpy((genericptr_t) &chunk, (genericptr_t) &rowp[col],
+                          sizeof chunk);
+            if (!(chunk & wide))
+                continue;
+        }
+        end = min(col + (int) sizeof chunk - 1, stop);
+        for (i = max(col, start); i <= end; i++)
+            if (rowp[i] & mask)
+                bits[vb_word(i)] |= vb_bit(i);
+    }
+}
+
+/*
+ * vb_next()
+ *
+ * Return the first column at or after col whose bit is set, or COLNO if
+ * there is none.
+ */
+STATIC_OVL int
+vb_next(bits, col)
+vbits *bits;
+int col;
+{
+    int w;
+    vbits b;
+
+    if (col >= COLNO)
+        return COLNO;
+    w = vb_word(col);
+    b = bits[w] & ~(vb_bit(col) - 1);
+    while (!b) {
+        if (++w >= VB_WORDS)
+            return COLNO;
+        b = bits[w];
+    }
+    return w * VB_WORDBITS + vb_lowbit(b);
+}
+
+/*
+ * vb_set_run()
+ *
+ * Set the bits for the columns lo to hi, a word at a time.
+ */
+STATIC_OVL void
+vb_set_run(bits, lo, hi)
+vbits *bits;
+int lo, hi;
+{
+    int w;
+
+    for (w = vb_word(lo); lo <= hi; w++) {
+        bits[w] |= vb_span(lo % VB_WORDBITS, (w == vb_word(hi))
+                                                 ? hi % VB_WORDBITS
+                                                 : VB_WORDBITS - 1);
+        lo = (w + 1) * VB_WORDBITS;
+    }
+}
+
+/*
+ * vb_clear_run()
+ *
+ * Return TRUE if every position from lo to hi on the row is clear.
+ */
+STATIC_OVL boolean
+vb_clear_run(row, lo, hi)
+int row, lo, hi;
+{
+    int w;
+    vbits m;
+
+    for (w = vb_word(lo); lo <= hi; w++) {
+        m = vb_span(lo % VB_WORDBITS,
+                    (w == vb_word(hi)) ? hi % VB_WORDBITS : VB_WORDBITS - 1);
+        if ((viz_clear_bits[row][w] & m) != m)
+            return FALSE;
+        lo = (w + 1) * VB_WORDBITS;
+    }
+    return TRUE;
+}
+#endif /* VISION_BITBOARD */
+
 /*
  * rogue_vision()
  *
@@ -317,6 +477,9 @@ char *rmin, *rmax;
                 } else
                     next[zy][zx] = COULD_SEE;
             }
+#ifdef VISION_BITBOARD
+            vb_set_run(viz_cs_bits[zy], start, stop);
+#endif
         }
     }
 
@@ -332,6 +495,9 @@ char *rmin, *rmax;
             rmin[zy] = xlo;
         if (xhi > rmax[zy])
             rmax[zy] = xhi;
+#ifdef VISION_BITBOARD
+        vb_set_run(viz_cs_bits[zy], xlo, xhi);
+#endif
 
         for (zx = xlo; zx <= xhi; zx++) {
             next[zy][zx] = COULD_SEE | IN_SIGHT;
@@ -518,6 +684,13 @@ int control;
     static unsigned char colbump[COLNO + 1]; /* cols to bump sv */
     unsigned char *sv;                       /* ptr to seen angle bits */
     int oldseenv;                            /* previous seenv value */
+#ifdef VISION_BITBOARD
+    vbits was_cs[VB_WORDS], was_in[VB_WORDS]; /* old could see, in sight */
+    vbits look[VB_WORDS];   /* positions that may be in sight now */
+    vbits hidden[VB_WORDS]; /* positions that only need a newsym() */
+    vbits todo[VB_WORDS];   /* look | hidden */
+    int i;
+#endif
 
     vision_full_recalc = 0; /* reset flag */
     if (in_mklev || !iflags.vision_inited)
@@ -530,6 +703,9 @@ int control;
 
     /* Get the unused could see, row min, and row max arrays. */
     get_unused_cs(&next_array, &next_rmin, &next_rmax);
+#ifdef VISION_BITBOARD
+    (void) memset((genericptr_t) viz_cs_bits, 0, sizeof viz_cs_bits);
+#endif
 
     /* You see nothing, nothing can see you --- if swallowed or refreshing. */
     if (u.uswallow || control == 2) {
@@ -565,9 +741,16 @@ int control;
             start = min(viz_rmin[row], next_rmin[row]);
             stop = max(viz_rmax[row], next_rmax[row]);
 
+#ifdef VISION_BITBOARD
+            vb_row(old_row, start, stop, IN_SIGHT, was_in);
+            for (col = vb_next(was_in, start); col <= stop;
+                 col = vb_next(was_in, col + 1))
+                newsym(col, row);
+#else
             for (col = start; col <= stop; col++)
                 if (old_row[col] & IN_SIGHT)
                     newsym(col, row);
+#endif
         }
 
         /* skip the normal update loop */
@@ -593,6 +776,9 @@ int control;
                     next_rmin[row] = min(next_rmin[row], col);
                     next_rmax[row] = max(next_rmax[row], col);
                     next_array[row][col] = IN_SIGHT | COULD_SEE;
+#ifdef VISION_BITBOARD
+                    viz_cs_bits[row][vb_word(col)] |= vb_bit(col);
+#endif
                 }
 
         /* if in a pit, just update for immediate locations */
@@ -609,6 +795,9 @@ int control;
 
                 for (col = next_rmin[row]; col <= next_rmax[row]; col++)
                     next_row[col] = IN_SIGHT | COULD_SEE;
+#ifdef VISION_BITBOARD
+                vb_set_run(viz_cs_bits[row], next_rmin[row], next_rmax[row]);
+#endif
             }
         } else
             view_from(u.uy, u.ux, next_array, next_rmin, next_rmax, 0,
@@ -723,12 +912,51 @@ int control;
         /* Find the min and max positions on the row. */
         start = min(viz_rmin[row], next_rmin[row]);
         stop = max(viz_rmax[row], next_rmax[row]);
+#ifdef VISION_BITBOARD
+        /*
+         * Sort the row out a word at a time.  The old row is read back
+         * from the array rather than kept as bits since a few places
+         * outside vision poke at viz_array[][] directly.
+         *
+         *      look   - could see now or in sight through xray; these
+         *               need the full treatment below.
+         *      hidden - cannot be seen now but were in sight, or their
+         *               could see bit changed (old ^ new); these only
+         *               need to be redrawn.
+         *
+         * Anything else would be left alone by the loop below anyway.
+         * The positions are still visited left to right, so newsym() is
+         * called in the same order as when every position is looked at.
+         */
+        vb_row(old_row, start, stop, COULD_SEE, was_cs);
+        vb_row(old_row, start, stop, IN_SIGHT, was_in);
+        if (u.xray_range >= 0)
+            vb_row(next_row, start, stop, IN_SIGHT, look);
+        else
+            (void) memset((genericptr_t) look, 0, sizeof look);
+        for (i = 0; i < VB_WORDS; i++) {
+            look[i] |= viz_cs_bits[row][i];
+            hidden[i] = (was_in[i] | (was_cs[i] ^ viz_cs_bits[row][i]))
+                        & ~look[i];
+            todo[i] = look[i] | hidden[i];
+        }
+
+        for (col = vb_next(todo, start); col <= stop;
+             col = vb_next(todo, col + 1)) {
+            if (vb_test(hidden, col)) {
+                newsym(col, row);
+                continue;
+            }
+            lev = &levl[col][row];
+            sv = &seenv_matrix[dy + 1][col < u.ux ? 0 : (col > u.ux ? 2 : 1)];
+#else
         lev = &levl[start][row];
 
         sv = &seenv_matrix[dy + 1][start < u.ux ? 0 : (start > u.ux ? 2 : 1)];
 
         for (col = start; col <= stop;
              lev += ROWNO, sv += (int) colbump[++col]) {
+#endif
             if (next_row[col] & IN_SIGHT) {
                 /*
                  * We see this position because of night- or xray-vision.
@@ -846,7 +1074,8 @@ int x, y;
 {
     fill_point(y, x);
 
-    /* recalc light sources here? */
+    /* light sources near here have to recheck what they light */
+    forget_lit_areas(x, y);
 
     /*
      * We have to do a full vision recalculation if we "could see" the
@@ -870,7 +1099,7 @@ int x, y;
 {
     dig_point(y, x);
 
-    /* recalc light sources here? */
+    forget_lit_areas(x, y);
 
     if (viz_array[y][x])
         vision_full_recalc = 1;
@@ -933,6 +1162,9 @@ int row, col;
         return; /* already done */
 
     viz_clear[row][col] = 1;
+#ifdef VISION_BITBOARD
+    viz_clear_bits[row][vb_word(col)] |= vb_bit(col);
+#endif
 
     /*
      * Boundary cases first.
@@ -1018,6 +1250,9 @@ int row, col;
         return;
 
     viz_clear[row][col] = 0;
+#ifdef VISION_BITBOARD
+    viz_clear_bits[row][vb_word(col)] &= ~vb_bit(col);
+#endif
 
     if (col == 0) {
         if (viz_clear[row][1]) { /* adjacent is clear */
@@ -1111,7 +1346,9 @@ static genericptr_t varg;
  * Both Algorithms C and D use the following macros.
  *
  *      good_row(z)       - Return TRUE if the argument is a legal row.
+ *      cs_row(row)       - The local could see row (a cs_rowp).
  *      set_cs(rowp,col)  - Set the local could see array.
+ *      set_cs_range(rowp,lo,hi) - Set a run of the local could see array.
  *      set_min(z)        - Save the min value of the argument and the current
  *                            row minimum.
  *      set_max(z)        - Save the max value of the argument and the current
@@ -1119,8 +1356,26 @@ static genericptr_t varg;
  *
  * The last three macros depend on having local pointers row_min, row_max,
  * and rowp being set correctly.
+ *
+ * With VISION_BITBOARD (Algorithm C only) the local could see rows are the
+ * bitsets in viz_cs_bits[], so a run of positions is marked a word at a
+ * time.
  */
+#ifdef VISION_BITBOARD
+typedef vbits *cs_rowp;
+#define cs_row(row) (viz_cs_bits[row])
+#define set_cs(rowp, col) (rowp[vb_word(col)] |= vb_bit(col))
+#define set_cs_range(rowp, lo, hi) vb_set_run(rowp, lo, hi)
+#else
+typedef char *cs_rowp;
+#define cs_row(row) (cs_rows[row])
 #define set_cs(rowp, col) (rowp[col] = COULD_SEE)
+#define set_cs_range(rowp, lo, hi)     \
+    do {                               \
+        for (i = (lo); i <= (hi); i++) \
+            set_cs(rowp, i);           \
+    } while (0)
+#endif
 #define good_row(z) ((z) >= 0 && (z) < ROWNO)
 #define set_min(z)      \
     if (*row_min > (z)) \
@@ -1570,6 +1825,12 @@ int col1, row1, col2, row2;
 {
     int result;
 
+#ifdef VISION_BITBOARD
+    /* Along a row only the points strictly between the ends matter. */
+    if (row1 == row2 && col1 != col2)
+        return (col1 < col2) ? vb_clear_run(row1, col1 + 1, col2 - 1)
+                             : vb_clear_run(row1, col2 + 1, col1 - 1);
+#endif
     if (col1 < col2) {
         if (row1 > row2) {
             q1_path(row1, col1, row2, col2, cleardone);
@@ -1799,8 +2060,7 @@ char *limits;       /* points at range limit for current row, or NULL */
             for (i = left; i <= loc_right; i++)
                 (*vis_func)(i, row, varg);
         } else {
-            for (i = left; i <= loc_right; i++)
-                set_cs(rowp, i);
+            set_cs_range(rowp, left, loc_right);
             set_min(left);
             set_max(loc_right);
         }
@@ -1860,8 +2120,7 @@ char *limits;       /* points at range limit for current row, or NULL */
                 for (i = left; i <= loc_right; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = left; i <= loc_right; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, left, loc_right);
                 set_min(left);
                 set_max(loc_right);
             }
@@ -1934,8 +2193,7 @@ char *limits;       /* points at range limit for current row, or NULL */
                 for (i = left; i <= loc_right; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = left; i <= loc_right; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, left, loc_right);
                 set_min(left);
                 set_max(loc_right);
             }
@@ -1972,8 +2230,7 @@ char *limits;       /* points at range limit for current row, or NULL */
                 for (i = left; i <= right_shadow; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = left; i <= right_shadow; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, left, right_shadow);
                 set_min(left);
                 set_max(right_shadow);
             }
@@ -2061,8 +2318,7 @@ char *limits;
             for (i = loc_left; i <= right; i++)
                 (*vis_func)(i, row, varg);
         } else {
-            for (i = loc_left; i <= right; i++)
-                set_cs(rowp, i);
+            set_cs_range(rowp, loc_left, right);
             set_min(loc_left);
             set_max(right);
         }
@@ -2099,8 +2355,7 @@ char *limits;
                 for (i = loc_left; i <= right; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = loc_left; i <= right; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, loc_left, right);
                 set_min(loc_left);
                 set_max(right);
             }
@@ -2148,8 +2403,7 @@ char *limits;
                 for (i = loc_left; i <= right; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = loc_left; i <= right; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, loc_left, right);
                 set_min(loc_left);
                 set_max(right);
             }
@@ -2172,8 +2426,7 @@ char *limits;
                 for (i = left_shadow; i <= right; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = left_shadow; i <= right; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, left_shadow, right);
                 set_min(left_shadow);
                 set_max(right);
             }
@@ -2256,8 +2509,7 @@ genericptr_t arg;
         rowp = cs_rows[srow];
 
         /* We know that we can see our row. */
-        for (i = left; i <= right; i++)
-            set_cs(rowp, i);
+        set_cs_range(rowp, left, right);
         cs_left[srow] = left;
         cs_right[srow] = right;
     }
@@ -2322,7 +2574,7 @@ char *limits;   /* points at range limit for current row, or NULL */
     int deeper;                 /* if TRUE, call self as needed */
     int result;                 /* set by q?_path() */
     register int i;             /* loop counter */
-    register char *rowp = NULL; /* row optimization */
+    register cs_rowp rowp = NULL; /* row optimization */
     char *row_min = NULL;       /* left most  [used by macro set_min()] */
     char *row_max = NULL;       /* right most [used by macro set_max()] */
     int lim_max;                /* right most limit of circle */
@@ -2336,7 +2588,7 @@ char *limits;   /* points at range limit for current row, or NULL */
      */
     deeper = good_row(nrow) && (!limits || (*limits >= *(limits + 1)));
     if (!vis_func) {
-        rowp = cs_rows[row]; /* optimization */
+        rowp = cs_row(row); /* optimization */
         row_min = &cs_left[row];
         row_max = &cs_right[row];
     }
@@ -2378,8 +2630,7 @@ char *limits;   /* points at range limit for current row, or NULL */
                 for (i = left; i <= right_edge; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = left; i <= right_edge; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, left, right_edge);
                 set_min(left);
                 set_max(right_edge);
             }
@@ -2483,8 +2734,7 @@ char *limits;   /* points at range limit for current row, or NULL */
                 for (i = left; i <= right; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = left; i <= right; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, left, right);
                 set_min(left);
                 set_max(right);
             }
@@ -2508,18 +2758,19 @@ char *limits;
 {
     int left, left_edge, nrow, deeper, result;
     register int i;
-    register char *rowp = NULL;
+    register cs_rowp rowp = NULL;
     char *row_min = NULL;
     char *row_max = NULL;
     int lim_min;
 
 #ifdef GCC_WARN
-    rowp = row_min = row_max = 0;
+    rowp = 0;
+    row_min = row_max = 0;
 #endif
     nrow = row + step;
     deeper = good_row(nrow) && (!limits || (*limits >= *(limits + 1)));
     if (!vis_func) {
-        rowp = cs_rows[row];
+        rowp = cs_row(row);
         row_min = &cs_left[row];
         row_max = &cs_right[row];
     }
@@ -2549,8 +2800,7 @@ char *limits;
                 for (i = left_edge; i <= right; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = left_edge; i <= right; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, left_edge, right);
                 set_min(left_edge);
                 set_max(right);
             }
@@ -2618,8 +2868,7 @@ char *limits;
                 for (i = left; i <= right; i++)
                     (*vis_func)(i, row, varg);
             } else {
-                for (i = left; i <= right; i++)
-                    set_cs(rowp, i);
+                set_cs_range(rowp, left, right);
                 set_min(left);
                 set_max(right);
             }
@@ -2648,7 +2897,7 @@ void FDECL((*func), (int, int, genericptr_t));
 genericptr_t arg;
 {
     register int i; /* loop counter */
-    char *rowp;     /* optimization for setting could_see */
+    cs_rowp rowp;   /* optimization for setting could_see */
     int nrow;       /* the next row */
     int left;       /* the left-most visible column */
     int right;      /* the right-most visible column */
@@ -2699,11 +2948,10 @@ genericptr_t arg;
             (*func)(i, srow, arg);
     } else {
         /* Row pointer optimization. */
-        rowp = cs_rows[srow];
+        rowp = cs_row(srow);
 
         /* We know that we can see our row. */
-        for (i = left; i <= right; i++)
-            set_cs(rowp, i);
+        set_cs_range(rowp, left, right);
         cs_left[srow] = left;
         cs_right[srow] = right;
     }
@@ -2728,6 +2976,15 @@ genericptr_t arg;
         if (scol)
             left_side(nrow, left, scol, limits);
     }
+
+#ifdef VISION_BITBOARD
+    /* Copy the bits worked out above into the could see array. */
+    if (!func)
+        for (nrow = 0; nrow < ROWNO; nrow++)
+            for (i = vb_next(viz_cs_bits[nrow], 0); i < COLNO;
+                 i = vb_next(viz_cs_bits[nrow], i + 1))
+                loc_cs_rows[nrow][i] = COULD_SEE;
+#endif
 }
 
 #endif /*===== End of algorithm C =====*/
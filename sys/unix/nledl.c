@@ -1,4 +1,5 @@
 
+#define _GNU_SOURCE /* dladdr */
 #include <dlfcn.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,6 +7,10 @@
 
 #include "nledl.h"
 
+/* Outlives the libraries, see nletypes.h. */
+static nle_splev_cache splev_cache = { PTHREAD_MUTEX_INITIALIZER };
+static nle_dlb_cache dlb_cache = { PTHREAD_MUTEX_INITIALIZER };
+
 void
 nledl_init(nledl_ctx *nledl, nle_obs *obs, nle_settings *settings)
 {
@@ -27,6 +32,9 @@ nledl_init(nledl_ctx *nledl, nle_obs *obs, nle_settings *settings)
 
     dlerror(); /* Clear any existing error */
 
+    settings->splev_cache = &splev_cache;
+    settings->dlb_cache = &dlb_cache;
+
     void *(*start)(nle_obs *, FILE *, nle_settings *);
     start = dlsym(nledl->dlhandle, "nle_start");
     nledl->nle_ctx = start(obs, nledl->ttyrec, settings);
@@ -149,3 +157,92 @@ nle_get_seed(nledl_ctx *nledl, unsigned long *core, unsigned long *disp,
      */
     get_seed(nledl->nle_ctx, core, disp, reseed, lgen, lgen_in_use);
 }
+
+void
+nle_set_clock(nledl_ctx *nledl, long now, long utc_offset)
+{
+    void (*set_clock)(void *, long, long);
+
+    set_clock = dlsym(nledl->dlhandle, "nle_set_clock");
+
+    char *error = dlerror();
+    if (error != NULL) {
+        fprintf(stderr, "%s\n", error);
+        exit(EXIT_FAILURE);
+    }
+
+    set_clock(nledl->nle_ctx, now, utc_offset);
+}
+
+void
+nle_set_rng_counting(nledl_ctx *nledl, char on)
+{
+    void (*set_rng_counting)(void *, char);
+
+    set_rng_counting = dlsym(nledl->dlhandle, "nle_set_rng_counting");
+
+    char *error = dlerror();
+    if (error != NULL) {
+        fprintf(stderr, "%s\n", error);
+        exit(EXIT_FAILURE);
+    }
+
+    set_rng_counting(nledl->nle_ctx, on);
+}
+
+void
+nle_get_rng_counts(nledl_ctx *nledl, nle_rng_counts *counts)
+{
+    void (*get_rng_counts)(void *, nle_rng_counts *);
+    Dl_info info;
+
+    get_rng_counts = dlsym(nledl->dlhandle, "nle_get_rng_counts");
+
+    char *error = dlerror();
+    if (error != NULL) {
+        fprintf(stderr, "%s\n", error);
+        exit(EXIT_FAILURE);
+    }
+
+    get_rng_counts(nledl->nle_ctx, counts);
+
+    /* Make the callers offsets into the library, as addr2line wants them;
+     * each copy of it is loaded at a different address. */
+    if (dladdr((void *) get_rng_counts, &info) && info.dli_fbase) {
+        for (int i = 0; i < counts->nsites; ++i)
+            counts->sites[i].caller -= (unsigned long) info.dli_fbase;
+    }
+}
+
+int
+nle_generate_level(nledl_ctx *nledl, unsigned long lgen_seed, int dnum,
+                   int dlevel, nle_level *level)
+{
+    int (*generate_level)(void *, unsigned long, int, int, nle_level *);
+
+    generate_level = dlsym(nledl->dlhandle, "nle_generate_level");
+
+    char *error = dlerror();
+    if (error != NULL) {
+        fprintf(stderr, "%s\n", error);
+        exit(EXIT_FAILURE);
+    }
+
+    return generate_level(nledl->nle_ctx, lgen_seed, dnum, dlevel, level);
+}
+
+void
+nle_get_pool_stats(nledl_ctx *nledl, nle_pool_stats *stats)
+{
+    void (*get_pool_stats)(void *, nle_pool_stats *);
+
+    get_pool_stats = dlsym(nledl->dlhandle, "nle_get_pool_stats");
+
+    char *error = dlerror();
+    if (error != NULL) {
+        fprintf(stderr, "%s\n", error);
+        exit(EXIT_FAILURE);
+    }
+
+    get_pool_stats(nledl->nle_ctx, stats);
+}
@@ -41,6 +41,10 @@ extern void NDECL(check_linux_console);
 extern void NDECL(init_linux_cons);
 #endif
 
+/* NLE: see nlelevel.c */
+extern boolean NDECL(nle_level_generator);
+extern void NDECL(nle_level_loop);
+
 static void NDECL(wd_message);
 static boolean wiz_error_flag = FALSE;
 static struct passwd *NDECL(get_unix_pw);
@@ -350,6 +354,10 @@ char *argv[];
         wd_message();
     }
 
+    /* NLE: level generators never play, see nlelevel.c */
+    if (nle_level_generator())
+        nle_level_loop();
+
     /* moveloop() never returns but isn't flagged NORETURN */
     moveloop(resuming);
 
@@ -0,0 +1,531 @@
+/*
+ *  Block-parallel bzip2 decompression for the ttyrec converter.
+ *
+ *  A bzip2 stream is "BZh" plus a level digit, then blocks that each start
+ *  with the 48-bit magic 0x314159265359 and the block's 32-bit CRC, then an
+ *  end-of-stream marker 0x177245385090 and the 32-bit combined CRC. Blocks
+ *  aren't byte aligned, but they are compressed independently: shifted into
+ *  a stream of their own (header, block, end marker with the block CRC as
+ *  combined CRC), each can be decompressed separately.
+ */
+
+#include <bzlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bzinput.h"
+
+#define BLOCK_MAGIC 0x314159265359ULL
+#define EOS_MAGIC 0x177245385090ULL
+#define MAGIC_MASK 0xffffffffffffULL
+#define MAGIC_BITS 48
+#define CRC_BITS 32
+#define HEADER_BITS 32
+
+/* Decompressed blocks kept ready, per thread. */
+#define LOOKAHEAD_PER_THREAD 2
+
+typedef struct Block {
+  char *buf;
+  size_t len;
+  size_t cap;
+  bool ready; /* Decompressed, not yet consumed. */
+  bool ok;
+} Block;
+
+typedef enum { BZINPUT_FILE, BZINPUT_MEMORY, BZINPUT_PARALLEL } BzInputMode;
+
+struct BzInput {
+  BzInputMode mode;
+
+  /* BZINPUT_FILE: plain BZ2_bzRead. */
+  BZFILE *bfp;
+
+  /* BZINPUT_MEMORY and BZINPUT_PARALLEL: the whole compressed file. */
+  char *data;
+  size_t size;
+  bool borrowed; /* data belongs to the caller. */
+
+  /* BZINPUT_MEMORY: serial decompression of data. */
+  bz_stream strm;
+  bool strm_open;
+  size_t skip; /* Decompressed bytes to drop first (after a fallback). */
+  bool stream_end;
+
+  /* BZINPUT_PARALLEL */
+  char level;
+  size_t *block_bits; /* Start bit of each block, then of the end marker. */
+  size_t num_blocks;
+  pthread_t *threads;
+  int num_threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  Block *slots; /* Block i is decompressed into slots[i % lookahead]. */
+  size_t lookahead;
+  size_t next_assign; /* Next block to decompress. */
+  size_t next_read;   /* Block being read. */
+  bool holding;       /* Whether next_read's slot is ready and being read. */
+  size_t pos;         /* Read position in that block. */
+  bool stopping;
+
+  size_t emitted; /* Bytes returned so far, in any mode. */
+};
+
+static bool read_all(FILE *f, char **data, size_t *size) {
+  size_t cap = 1 << 20;
+  *size = 0;
+  *data = malloc(cap);
+  if (!*data) return false;
+  for (;;) {
+    if (*size == cap) {
+      char *p = realloc(*data, cap *= 2);
+      if (!p) return false;
+      *data = p;
+    }
+    size_t n = fread(*data + *size, 1, cap - *size, f);
+    *size += n;
+    if (n == 0) return !ferror(f);
+  }
+}
+
+static uint64_t get_bits(const unsigned char *src, size_t pos, int n) {
+  uint64_t v = 0;
+  for (int i = 0; i < n; ++i, ++pos)
+    v = (v << 1) | ((src[pos / 8] >> (7 - pos % 8)) & 1);
+  return v;
+}
+
+/* ORs the n lowest bits of v into a zeroed buffer at bit *pos. */
+static void put_bits(unsigned char *dst, size_t *pos, uint64_t v, int n) {
+  for (int i = n - 1; i >= 0; --i, ++*pos)
+    if ((v >> i) & 1) dst[*pos / 8] |= 0x80 >> (*pos % 8);
+}
+
+/* Copies nbits bits from bit start of src to the byte-aligned dst. */
+static void copy_bits(unsigned char *dst, const unsigned char *src,
+                      size_t src_size, size_t start, size_t nbits) {
+  const unsigned char *p = src + start / 8;
+  size_t avail = src_size - start / 8;
+  int shift = start % 8;
+  size_t nbytes = (nbits + 7) / 8;
+  for (size_t k = 0; k < nbytes; ++k) {
+    unsigned v = p[k] << shift;
+    if (shift && k + 1 < avail) v |= p[k + 1] >> (8 - shift);
+    dst[k] = v;
+  }
+  if (nbits % 8) dst[nbytes - 1] &= 0xff << (8 - nbits % 8);
+}
+
+/* Finds the blocks of the first stream in data. */
+static bool scan_blocks(BzInput *in) {
+  const unsigned char *d = (const unsigned char *)in->data;
+  if (in->size < 4 || memcmp(d, "BZh", 3) || d[3] < '1' || d[3] > '9')
+    return false;
+  in->level = d[3];
+
+  size_t n = 0, cap = 64;
+  size_t *bits = malloc(cap * sizeof(*bits));
+  if (!bits) return false;
+
+  uint64_t window = 0;
+  for (size_t i = 4; i < in->size; ++i) {
+    for (int b = 7; b >= 0; --b) {
+      window = ((window << 1) | ((d[i] >> b) & 1)) & MAGIC_MASK;
+      if (window != BLOCK_MAGIC && window != EOS_MAGIC) continue;
+
+      size_t start = i * 8 + (8 - b) - MAGIC_BITS;
+      if (start < HEADER_BITS) continue;
+      if (n == cap) {
+        size_t *p = realloc(bits, (cap *= 2) * sizeof(*bits));
+        if (!p) {
+          free(bits);
+          return false;
+        }
+        bits = p;
+      }
+      bits[n++] = start;
+
+      if (window == EOS_MAGIC) {
+        in->block_bits = bits;
+        in->num_blocks = n - 1;
+        /* The stream must start with a block and hold the final CRC. */
+        return bits[0] == HEADER_BITS &&
+               start + MAGIC_BITS + CRC_BITS <= in->size * 8;
+      }
+    }
+  }
+  free(bits);
+  return false;
+}
+
+/* Decompresses a standalone bzip2 stream into the block buffer. */
+static bool inflate(char *src, size_t len, Block *block) {
+  bz_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK) return false;
+  strm.next_in = src;
+  strm.avail_in = len;
+  block->len = 0;
+
+  int ret;
+  for (;;) {
+    if (block->len == block->cap) {
+      size_t cap = block->cap ? 2 * block->cap : 1 << 20;
+      char *p = realloc(block->buf, cap);
+      if (!p) {
+        ret = BZ_MEM_ERROR;
+        break;
+      }
+      block->buf = p;
+      block->cap = cap;
+    }
+    strm.next_out = block->buf + block->len;
+    strm.avail_out = block->cap - block->len;
+    ret = BZ2_bzDecompress(&strm);
+    block->len = strm.next_out - block->buf;
+    if (ret != BZ_OK) break;
+    if (strm.avail_in == 0 && strm.avail_out > 0) {
+      ret = BZ_UNEXPECTED_EOF;
+      break;
+    }
+  }
+  BZ2_bzDecompressEnd(&strm);
+  return ret == BZ_STREAM_END;
+}
+
+/* Builds a standalone stream of blocks [first, last) of data. Its combined
+ * CRC is recomputed from the blocks' CRCs. */
+static unsigned char *make_stream(const BzInput *in, size_t first, size_t last,
+                                  size_t *size) {
+  const unsigned char *data = (const unsigned char *)in->data;
+  size_t start = in->block_bits[first];
+  size_t nbits = in->block_bits[last] - start;
+
+  uint32_t crc = 0;
+  for (size_t j = first; j < last; ++j)
+    crc = ((crc << 1) | (crc >> 31)) ^
+          (uint32_t)get_bits(data, in->block_bits[j] + MAGIC_BITS, CRC_BITS);
+
+  *size = 4 + (nbits + MAGIC_BITS + CRC_BITS + 7) / 8;
+  unsigned char *stream = calloc(*size, 1);
+  if (!stream) return NULL;
+  memcpy(stream, "BZh", 3);
+  stream[3] = in->level;
+  copy_bits(stream + 4, data, in->size, start, nbits);
+
+  size_t pos = HEADER_BITS + nbits;
+  put_bits(stream, &pos, EOS_MAGIC, MAGIC_BITS);
+  put_bits(stream, &pos, crc, CRC_BITS);
+  return stream;
+}
+
+static bool decode_block(BzInput *in, size_t i, Block *block) {
+  size_t size;
+  unsigned char *stream = make_stream(in, i, i + 1, &size);
+  if (!stream) return false;
+  bool ok = inflate((char *)stream, size, block);
+  free(stream);
+  return ok;
+}
+
+static void *work(void *arg) {
+  BzInput *in = arg;
+  pthread_mutex_lock(&in->mutex);
+  for (;;) {
+    while (!in->stopping && (in->next_assign >= in->num_blocks ||
+                             in->next_assign >= in->next_read + in->lookahead))
+      pthread_cond_wait(&in->cond, &in->mutex);
+    if (in->stopping) break;
+
+    size_t i = in->next_assign++;
+    Block *block = &in->slots[i % in->lookahead];
+    pthread_mutex_unlock(&in->mutex);
+    bool ok = decode_block(in, i, block);
+    pthread_mutex_lock(&in->mutex);
+    block->ok = ok;
+    block->ready = true;
+    pthread_cond_broadcast(&in->cond);
+  }
+  pthread_mutex_unlock(&in->mutex);
+  return NULL;
+}
+
+static void stop_parallel(BzInput *in) {
+  pthread_mutex_lock(&in->mutex);
+  in->stopping = true;
+  pthread_cond_broadcast(&in->cond);
+  pthread_mutex_unlock(&in->mutex);
+  for (int t = 0; t < in->num_threads; ++t) pthread_join(in->threads[t], NULL);
+  pthread_cond_destroy(&in->cond);
+  pthread_mutex_destroy(&in->mutex);
+
+  for (size_t s = 0; s < in->lookahead; ++s) free(in->slots[s].buf);
+  free(in->slots);
+  free(in->threads);
+  in->slots = NULL;
+  in->threads = NULL;
+  in->num_threads = 0;
+}
+
+static bool start_memory(BzInput *in, size_t skip) {
+  memset(&in->strm, 0, sizeof(in->strm));
+  if (BZ2_bzDecompressInit(&in->strm, 0, 0) != BZ_OK) return false;
+  in->strm_open = true;
+  in->strm.next_in = in->data;
+  in->strm.avail_in = 0;
+  in->skip = skip;
+  in->mode = BZINPUT_MEMORY;
+  return true;
+}
+
+static bool start_parallel(BzInput *in, int threads) {
+  if ((size_t)threads > in->num_blocks) threads = in->num_blocks;
+  in->lookahead = threads * LOOKAHEAD_PER_THREAD;
+  in->slots = calloc(in->lookahead, sizeof(*in->slots));
+  in->threads = calloc(threads, sizeof(*in->threads));
+  if (!in->slots || !in->threads) {
+    free(in->slots);
+    free(in->threads);
+    return false;
+  }
+  pthread_mutex_init(&in->mutex, NULL);
+  pthread_cond_init(&in->cond, NULL);
+  in->mode = BZINPUT_PARALLEL;
+  for (int t = 0; t < threads; ++t) {
+    if (pthread_create(&in->threads[t], NULL, work, in)) break;
+    in->num_threads++;
+  }
+  if (in->num_threads == 0) {
+    stop_parallel(in);
+    return false;
+  }
+  return true;
+}
+
+/* One BZ2_bzRead worth of serial decompression from memory. */
+static int inflate_memory(int *bzerror, BzInput *in, char *buf, int len) {
+  in->strm.next_out = buf;
+  in->strm.avail_out = len;
+  for (;;) {
+    if (in->strm.avail_in == 0) {
+      size_t consumed = in->strm.next_in - in->data;
+      size_t left = in->size - consumed;
+      in->strm.avail_in = left < UINT_MAX ? left : UINT_MAX;
+    }
+    int ret = BZ2_bzDecompress(&in->strm);
+    if (ret == BZ_STREAM_END) {
+      in->stream_end = true;
+      *bzerror = BZ_STREAM_END;
+      break;
+    }
+    if (ret != BZ_OK) {
+      *bzerror = ret;
+      return 0;
+    }
+    if (in->strm.avail_out == 0) {
+      *bzerror = BZ_OK;
+      break;
+    }
+    if (in->strm.avail_in == 0 &&
+        (size_t)(in->strm.next_in - in->data) == in->size) {
+      *bzerror = BZ_UNEXPECTED_EOF;
+      return 0;
+    }
+  }
+  return len - in->strm.avail_out;
+}
+
+static int read_memory(int *bzerror, BzInput *in, char *buf, int len) {
+  while (in->skip > 0) {
+    char scratch[4096];
+    int n = in->skip < sizeof(scratch) ? (int)in->skip : (int)sizeof(scratch);
+    int got = inflate_memory(bzerror, in, scratch, n);
+    if (*bzerror != BZ_OK) return 0;
+    in->skip -= got;
+  }
+  if (in->stream_end) {
+    *bzerror = BZ_STREAM_END;
+    return 0;
+  }
+  int n = inflate_memory(bzerror, in, buf, len);
+  in->emitted += n;
+  return n;
+}
+
+static int read_parallel(int *bzerror, BzInput *in, char *buf, int len) {
+  int n = 0;
+  while (n < len) {
+    if (in->next_read == in->num_blocks) {
+      *bzerror = BZ_STREAM_END;
+      return n;
+    }
+    Block *block = &in->slots[in->next_read % in->lookahead];
+    if (!in->holding) {
+      pthread_mutex_lock(&in->mutex);
+      while (!block->ready) pthread_cond_wait(&in->cond, &in->mutex);
+      pthread_mutex_unlock(&in->mutex);
+      if (!block->ok) {
+        /* Carry on serially from where we are. */
+        stop_parallel(in);
+        if (!start_memory(in, in->emitted)) {
+          *bzerror = BZ_MEM_ERROR;
+          return 0;
+        }
+        int got = read_memory(bzerror, in, buf + n, len - n);
+        return *bzerror == BZ_OK || *bzerror == BZ_STREAM_END ? n + got : 0;
+      }
+      in->holding = true;
+      in->pos = 0;
+    }
+
+    size_t take = block->len - in->pos;
+    if (take > (size_t)(len - n)) take = len - n;
+    memcpy(buf + n, block->buf + in->pos, take);
+    in->pos += take;
+    in->emitted += take;
+    n += take;
+
+    if (in->pos == block->len) {
+      pthread_mutex_lock(&in->mutex);
+      block->ready = false;
+      in->next_read++;
+      pthread_cond_broadcast(&in->cond);
+      pthread_mutex_unlock(&in->mutex);
+      in->holding = false;
+    }
+  }
+  /* Like BZ2_bzDecompress, report the end as soon as all data is out. */
+  *bzerror = in->next_read == in->num_blocks ? BZ_STREAM_END : BZ_OK;
+  return n;
+}
+
+/* Starts reading data, in parallel if there are threads and blocks. */
+static BzInput *start(BzInput *in, int threads) {
+  if (threads > 1 && scan_blocks(in) && in->num_blocks > 1 &&
+      start_parallel(in, threads))
+    return in;
+  if (!start_memory(in, 0)) {
+    bzinput_close(in);
+    return NULL;
+  }
+  return in;
+}
+
+BzInput *bzinput_open(FILE *f, int threads) {
+  BzInput *in = calloc(1, sizeof(*in));
+  if (!in) return NULL;
+
+  if (threads <= 1) {
+    int bzerror;
+    in->bfp = BZ2_bzReadOpen(&bzerror, f, 0, 1, NULL, 0);
+    if (bzerror != BZ_OK) {
+      BZ2_bzReadClose(&bzerror, in->bfp);
+      free(in);
+      return NULL;
+    }
+    in->mode = BZINPUT_FILE;
+    return in;
+  }
+
+  if (!read_all(f, &in->data, &in->size)) {
+    bzinput_close(in);
+    return NULL;
+  }
+  return start(in, threads);
+}
+
+BzInput *bzinput_open_memory(const void *data, size_t size, int threads) {
+  BzInput *in = calloc(1, sizeof(*in));
+  if (!in) return NULL;
+  /* Never written to. */
+  in->data = (char *)data;
+  in->size = size;
+  in->borrowed = true;
+  return start(in, threads);
+}
+
+/* Replaces data by the stream of its blocks from block i on. */
+static bool cut_stream(BzInput *in, size_t i) {
+  size_t size;
+  unsigned char *stream = make_stream(in, i, in->num_blocks, &size);
+  if (!stream) return false;
+  if (!in->borrowed) free(in->data);
+  in->data = (char *)stream;
+  in->size = size;
+  in->borrowed = false;
+  return true;
+}
+
+BzInput *bzinput_open_at(FILE *f, uint64_t offset, uint64_t block_bit,
+                         uint64_t block_offset) {
+  BzInput *in = calloc(1, sizeof(*in));
+  if (!in) return NULL;
+  if (!read_all(f, &in->data, &in->size)) {
+    bzinput_close(in);
+    return NULL;
+  }
+
+  size_t skip = offset;
+  if (block_bit && block_offset <= offset && scan_blocks(in)) {
+    size_t lo = 0, hi = in->num_blocks;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (in->block_bits[mid] < block_bit)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo < in->num_blocks && in->block_bits[lo] == block_bit &&
+        cut_stream(in, lo))
+      skip = offset - block_offset;
+  }
+  if (!start_memory(in, skip)) {
+    bzinput_close(in);
+    return NULL;
+  }
+  in->emitted = offset;
+  return in;
+}
+
+uint64_t bzinput_tell(const BzInput *in) { return in->emitted; }
+
+void bzinput_block(const BzInput *in, uint64_t *block_bit,
+                   uint64_t *block_offset) {
+  if (in->mode == BZINPUT_PARALLEL && in->next_read < in->num_blocks) {
+    *block_bit = in->block_bits[in->next_read];
+    *block_offset = in->emitted - (in->holding ? in->pos : 0);
+  } else {
+    *block_bit = *block_offset = 0;
+  }
+}
+
+int bzinput_read(int *bzerror, BzInput *in, void *buf, int len) {
+  switch (in->mode) {
+  case BZINPUT_FILE: {
+    int n = BZ2_bzRead(bzerror, in->bfp, buf, len);
+    if (*bzerror == BZ_OK || *bzerror == BZ_STREAM_END) in->emitted += n;
+    return n;
+  }
+  case BZINPUT_MEMORY:
+    return read_memory(bzerror, in, buf, len);
+  case BZINPUT_PARALLEL:
+    return read_parallel(bzerror, in, buf, len);
+  }
+  *bzerror = BZ_PARAM_ERROR;
+  return 0;
+}
+
+void bzinput_close(BzInput *in) {
+  if (!in) return;
+  int bzerror;
+  if (in->bfp) BZ2_bzReadClose(&bzerror, in->bfp);
+  if (in->mode == BZINPUT_PARALLEL) stop_parallel(in);
+  if (in->strm_open) BZ2_bzDecompressEnd(&in->strm);
+  free(in->block_bits);
+  if (!in->borrowed) free(in->data);
+  free(in);
+}
@@ -0,0 +1,46 @@
+#ifndef BZINPUT_H
+#define BZINPUT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * Reader for the first bzip2 stream of a file, with the semantics of
+ * BZ2_bzRead. With threads > 1, the stream's blocks are located up front and
+ * decompressed ahead of the reader on that many threads, then handed out
+ * in order. If that fails for any reason (eg. a block magic that was just a
+ * coincidence in the compressed data), reading continues serially.
+ */
+typedef struct BzInput BzInput;
+
+BzInput *bzinput_open(FILE *f, int threads);
+/* Reads from size bytes at data, which must outlive the BzInput. */
+BzInput *bzinput_open_memory(const void *data, size_t size, int threads);
+int bzinput_read(int *bzerror, BzInput *in, void *buf, int len);
+void bzinput_close(BzInput *in);
+
+/* Number of decompressed bytes read so far. */
+uint64_t bzinput_tell(const BzInput *in);
+
+/* Where decompression can restart to get back to the current position: the
+ * bit offset of the bzip2 block holding it and the decompressed offset at
+ * which that block starts. Only known while reading in parallel, 0 and 0
+ * otherwise. */
+void bzinput_block(const BzInput *in, uint64_t *block_bit,
+                   uint64_t *block_offset);
+
+/* Opens f for reading from decompressed offset `offset`, decompressing from
+ * the block found by bzinput_block. Without one (block_bit 0), or if the
+ * file has no block there, decompresses from the start and skips ahead. */
+BzInput *bzinput_open_at(FILE *f, uint64_t offset, uint64_t block_bit,
+                         uint64_t block_offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BZINPUT_H */
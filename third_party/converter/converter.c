@@ -15,12 +15,15 @@
 #include <assert.h>
 #include <bzlib.h>
 #include <locale.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
 
+#include "bzinput.h"
 #include "stripgfx.h"
 #include "tmt.h"
 
@@ -118,10 +121,42 @@ vt_char_color_extract(TMTCHAR *c)
 }
 
 
-int read_header(BZFILE *bfp, Header *h, size_t version) {
+/* vt_char_color_extract of every (fg, bold, reverse, c == ' '), indexed by
+ * color_index. */
+static signed char color_map[16 * 8];
+
+static inline size_t color_index(const TMTCHAR *c) {
+  return ((size_t)(c->a.fg + 1) & 15) << 3 | (size_t)c->a.bold << 2 |
+         (size_t)c->a.reverse << 1 | (size_t)(c->c == ' ');
+}
+
+static void populate_color_map(void) {
+  for (int fg = -1; fg < 15; ++fg) {
+    if (fg == TMT_COLOR_MAX) continue; /* Invalid, stays CLR_BLACK. */
+    for (int i = 0; i < 8; ++i) {
+      TMTCHAR c = {0};
+      c.c = (i & 1) ? ' ' : 'x';
+      c.a.reverse = i & 2;
+      c.a.bold = i & 4;
+      c.a.fg = fg;
+      color_map[color_index(&c)] = vt_char_color_extract(&c);
+    }
+  }
+}
+
+/* Writes the stripped chars and the colors of n cells. */
+static void convert_cells(const TMTCHAR *cells, size_t n,
+                          unsigned char *chars, signed char *colors) {
+  for (size_t i = 0; i < n; ++i) {
+    chars[i] = gfx_strip_map[cells[i].a.dec][(unsigned char)cells[i].c];
+    colors[i] = color_map[color_index(&cells[i])];
+  }
+}
+
+int read_header(BzInput *bfp, Header *h, size_t version) {
   int buf[3];
   int bzerror;
-  BZ2_bzRead(&bzerror, bfp, buf, sizeof(int) * 3);
+  bzinput_read(&bzerror, bfp, buf, sizeof(int) * 3);
   if (bzerror != BZ_OK) {
     /* This could be BZ_STREAM_END, the logical end of a stream.
        We still stop in that case. */
@@ -137,7 +172,7 @@ int read_header(BZFILE *bfp, Header *h, size_t version) {
   if (version > 1) {
     /* NLE-based ttyrecs read have single-byte "channel" which codifies what 
     kind of information one is in the buffer. Here we read into the channel. */
-    BZ2_bzRead(&bzerror, bfp, &h->channel, 1);
+    bzinput_read(&bzerror, bfp, &h->channel, 1);
     if (bzerror != BZ_OK) {
       if (bzerror == BZ_STREAM_END) return CONV_STREAM_END;
       return CONV_HEADER_ERROR;
@@ -155,7 +190,7 @@ int read_header(BZFILE *bfp, Header *h, size_t version) {
   return CONV_OK;
 }
 
-int ttyread(BZFILE *bfp, Header *h, char **buf, size_t version) {
+int ttyread(BzInput *bfp, Header *h, char **buf, size_t version) {
   int status = read_header(bfp, h, version);
   if (status != CONV_OK) {
     return status;
@@ -168,7 +203,7 @@ int ttyread(BZFILE *bfp, Header *h, char **buf, size_t version) {
   }
 
   int bzerror;
-  int length = BZ2_bzRead(&bzerror, bfp, *buf, h->len);
+  int length = bzinput_read(&bzerror, bfp, *buf, h->len);
   if (bzerror != BZ_OK || length != h->len) {
     if (bzerror == BZ_STREAM_END) return CONV_STREAM_END;
     fprintf(stderr, "bzRead failed with return code %d (read %d bytes)\n",
@@ -178,11 +213,47 @@ int ttyread(BZFILE *bfp, Header *h, char **buf, size_t version) {
   return CONV_OK;
 }
 
+int conversion_scan_ttyrec(FILE *f, size_t version, int threads,
+                           TtyrecStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  BzInput *bfp = bzinput_open(f, threads);
+  if (!bfp) return CONV_CRITICAL_ERROR;
+
+  char body[4096];
+  Header h;
+  uint64_t records = 0;
+  int status;
+  while ((status = read_header(bfp, &h, version)) == CONV_OK) {
+    /* Like ttyread, a record cut short by the end of the stream is dropped. */
+    int bzerror = BZ_OK;
+    for (int left = h.len; left > 0 && bzerror == BZ_OK;) {
+      int n = left < (int)sizeof(body) ? left : (int)sizeof(body);
+      left -= bzinput_read(&bzerror, bfp, body, n);
+    }
+    if (bzerror != BZ_OK) {
+      status = (bzerror == BZ_STREAM_END) ? CONV_STREAM_END : CONV_BODY_ERROR;
+      break;
+    }
+
+    unsigned char channel = h.channel;
+    int64_t usec = 1000000 * (int64_t)h.tv.tv_sec + (int64_t)h.tv.tv_usec;
+    if (records++ == 0) stats->first_timestamp = usec;
+    stats->last_timestamp = usec;
+    ++stats->records[channel];
+    /* See conversion_convert_frames and write_to_buffers. */
+    if (version == 1 || channel == 1) ++stats->frames;
+    stats->size = bzinput_tell(bfp);
+  }
+  bzinput_close(bfp);
+  return status;
+}
+
 Conversion *conversion_create(size_t rows, size_t cols, size_t term_rows,
                               size_t term_cols, size_t version) {
   static bool stripgfx_init = false;
   if (!stripgfx_init) {
     populate_gfx_arrays();
+    populate_color_map();
     stripgfx_init = true;
   }
 
@@ -194,6 +265,8 @@ Conversion *conversion_create(size_t rows, size_t cols, size_t term_rows,
   if (!term_rows) term_rows = rows;
   if (!term_cols) term_cols = cols;
   assert(rows <= term_rows && cols <= term_cols);
+  c->term_rows = term_rows;
+  c->term_cols = term_cols;
   c->chars = (UnsignedCharPtr){0};
   c->colors = (SignedCharPtr){0};
   c->cursors = (Int16Ptr){0};
@@ -216,6 +289,10 @@ Conversion *conversion_create(size_t rows, size_t cols, size_t term_rows,
     return NULL;
   }
   c->bfp = NULL;
+  c->threads = 1;
+  c->frame = 0;
+  c->skip = 0;
+  c->index = NULL;
   return c;
 }
 
@@ -244,18 +321,38 @@ void conversion_set_buffers(Conversion *c, unsigned char *chars, size_t chars_si
       (Int32Ptr){scores, scores, scores + scores_size};
 }
 
+void conversion_set_threads(Conversion *c, int threads) {
+  c->threads = threads;
+}
+
 int conversion_load_ttyrec(Conversion *c, FILE *f) {
-  int bzerror;
   if (c->bfp) {
-    BZ2_bzReadClose(&bzerror, c->bfp);
+    bzinput_close(c->bfp);
   }
 
-  c->bfp = BZ2_bzReadOpen(&bzerror, f, 0, 1, NULL, 0);
-  if (bzerror != BZ_OK) {
+  c->bfp = bzinput_open(f, c->threads);
+  if (!c->bfp) {
     perror("Could not open bzip2 file");
-    BZ2_bzReadClose(&bzerror, c->bfp);
     return EXIT_FAILURE;
   }
+  c->frame = 0;
+  c->skip = 0;
+  return EXIT_SUCCESS;
+}
+
+int conversion_load_ttyrec_memory(Conversion *c, const void *data,
+                                  size_t size) {
+  BzInput *in = bzinput_open_memory(data, size, c->threads);
+  if (!in) {
+    perror("Could not open bzip2 data");
+    return EXIT_FAILURE;
+  }
+  if (c->bfp) {
+    bzinput_close(c->bfp);
+  }
+  c->bfp = in;
+  c->frame = 0;
+  c->skip = 0;
   return EXIT_SUCCESS;
 }
 
@@ -283,10 +380,11 @@ int conversion_convert_frames(Conversion *c) {
        *     Channel 0 -> update terminal/state
        *     Channel 2 -> we have an reward: write reward only
        *     Channel 1 -> we have an action: write state + action to buffers 
+       *     Channel 3 -> options and seeds (nlereplay.h): skip
        * NB. Will only end up writing when an action is given. */
       if (c->header.channel == 0) {
         tmt_write(c->vt, c->buf, c->header.len);
-      } else {
+      } else if (c->header.channel <= 2) {
         write_to_buffers(c);
       }
     } else if (c->version == 1) {
@@ -301,13 +399,50 @@ int conversion_convert_frames(Conversion *c) {
   return status;
 }
 
+static bool add_keyframe(ConversionIndex *index, Conversion *conv) {
+  if (index->num_keyframes == index->capacity) {
+    size_t capacity = index->capacity ? 2 * index->capacity : 64;
+    Keyframe *keyframes =
+        realloc(index->keyframes, capacity * sizeof(*keyframes));
+    if (!keyframes) return false;
+    index->keyframes = keyframes;
+    char *states = realloc(index->states, capacity * index->state_size);
+    if (!states) return false;
+    index->states = states;
+    index->capacity = capacity;
+  }
+  Keyframe *k = &index->keyframes[index->num_keyframes];
+  k->frame = conv->frame;
+  k->offset = bzinput_tell(conv->bfp);
+  bzinput_block(conv->bfp, &k->block_bit, &k->block_offset);
+  tmt_save_state(conv->vt,
+                 index->states + index->num_keyframes * index->state_size);
+  ++index->num_keyframes;
+  return true;
+}
+
+static void end_frame(Conversion *conv) {
+  ++conv->frame;
+  if (conv->index && conv->frame % conv->index->interval == 0)
+    add_keyframe(conv->index, conv);
+}
+
 void write_to_buffers(Conversion *conv) {
   if (conv->version > 1)  {
     if (conv->header.channel == 2) {
       /* V3: Write just the reward. Do not write the screen. */
-      memcpy(conv->scores.cur++, conv->buf, sizeof(*conv->scores.cur));
+      if (!conv->skip)
+        memcpy(conv->scores.cur++, conv->buf, sizeof(*conv->scores.cur));
       return;
     }
+  }
+  if (conv->skip) {
+    --conv->skip;
+    end_frame(conv);
+    return;
+  }
+
+  if (conv->version > 1)  {
     if (conv->header.channel == 1) {
       /* V2: Write the action, then continue to flush the screen too. */
       *conv->inputs.cur++ = conv->buf[0];
@@ -315,13 +450,13 @@ void write_to_buffers(Conversion *conv) {
   }
   
   const TMTSCREEN *scr = tmt_screen(conv->vt);
+  assert(conv->chars.end - conv->chars.cur >=
+         (ptrdiff_t)(conv->rows * conv->cols));
   for (size_t r = 0; r < conv->rows; ++r) {
-    for (size_t c = 0; c < conv->cols; ++c) {
-      assert(conv->chars.cur < conv->chars.end);
-      assert(scr->lines[r]->chars[c].c < 256);
-      *conv->chars.cur++ = strip_gfx(scr->lines[r]->chars[c].c, scr->lines[r]->chars[c].a.dec);
-      *conv->colors.cur++ = vt_char_color_extract(&(scr->lines[r]->chars[c]));
-    }
+    convert_cells(scr->lines[r]->chars, conv->cols, conv->chars.cur,
+                  conv->colors.cur);
+    conv->chars.cur += conv->cols;
+    conv->colors.cur += conv->cols;
   }
 
   const TMTPOINT *cur = tmt_cursor(conv->vt);
@@ -332,7 +467,7 @@ void write_to_buffers(Conversion *conv) {
   *conv->timestamps.cur++ = usec + (int64_t)conv->header.tv.tv_usec;
 
   --conv->remaining;
-
+  end_frame(conv);
 }
 
 int conversion_close(Conversion *c) {
@@ -342,14 +477,168 @@ int conversion_close(Conversion *c) {
   }
   tmt_close(c->vt);
   if (c->bfp) {
-    int bzerror;
-    BZ2_bzReadClose(&bzerror, c->bfp);
+    bzinput_close(c->bfp);
   }
   if (c->buf) free(c->buf);
   free(c);
   return EXIT_SUCCESS;
 }
 
+#define INDEX_MAGIC "TTYRIDX"
+#define INDEX_FORMAT 1
+#define INDEX_FIELDS 10
+
+ConversionIndex *conversion_index_ttyrec(const Conversion *c, FILE *f,
+                                         size_t interval) {
+  struct stat st;
+  if (!interval || fstat(fileno(f), &st)) return NULL;
+
+  Conversion *ic = conversion_create(c->rows, c->cols, c->term_rows,
+                                     c->term_cols, c->version);
+  ConversionIndex *index = calloc(1, sizeof(*index));
+  size_t frame_size = c->rows * c->cols;
+  unsigned char *chars = malloc(frame_size);
+  signed char *colors = malloc(frame_size);
+  if (!ic || !index || !chars || !colors) goto fail;
+
+  index->interval = interval;
+  index->state_size = tmt_state_size(ic->vt);
+  index->file_size = st.st_size;
+  index->file_mtime = st.st_mtime;
+  index->term_rows = c->term_rows;
+  index->term_cols = c->term_cols;
+  index->version = c->version;
+
+  /* Block positions are only known when reading in parallel. */
+  conversion_set_threads(ic, c->threads > 2 ? c->threads : 2);
+  if (conversion_load_ttyrec(ic, f) || !add_keyframe(index, ic)) goto fail;
+
+  /* Run through the whole file, never writing a frame. */
+  int16_t cursors[2];
+  int64_t timestamp;
+  unsigned char input;
+  int32_t score;
+  conversion_set_buffers(ic, chars, frame_size, colors, frame_size, cursors,
+                         2, &timestamp, 1, &input, 1, &score, 1);
+  ic->skip = UINT64_MAX;
+  ic->index = index;
+  if (conversion_convert_frames(ic) == CONV_CRITICAL_ERROR) goto fail;
+  if (index->num_keyframes != ic->frame / interval + 1) goto fail;
+  index->num_frames = ic->frame;
+
+  conversion_close(ic);
+  free(chars);
+  free(colors);
+  return index;
+
+fail:
+  if (ic) conversion_close(ic);
+  conversion_free_index(index);
+  free(chars);
+  free(colors);
+  return NULL;
+}
+
+int conversion_write_index(const ConversionIndex *index, FILE *out) {
+  uint64_t header[INDEX_FIELDS] = {
+      INDEX_FORMAT,          index->interval,  index->num_frames,
+      index->num_keyframes,  index->state_size, index->file_size,
+      index->file_mtime,     index->term_rows, index->term_cols,
+      index->version};
+  size_t n = index->num_keyframes;
+  if (fwrite(INDEX_MAGIC, sizeof(INDEX_MAGIC), 1, out) != 1 ||
+      fwrite(header, sizeof(header), 1, out) != 1 ||
+      fwrite(index->keyframes, sizeof(Keyframe), n, out) != n ||
+      fwrite(index->states, index->state_size, n, out) != n)
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
+
+ConversionIndex *conversion_read_index(const Conversion *c, FILE *f,
+                                       FILE *in) {
+  struct stat st;
+  char magic[sizeof(INDEX_MAGIC)];
+  uint64_t header[INDEX_FIELDS];
+  if (fstat(fileno(f), &st) || fread(magic, sizeof(magic), 1, in) != 1 ||
+      memcmp(magic, INDEX_MAGIC, sizeof(magic)) ||
+      fread(header, sizeof(header), 1, in) != 1)
+    return NULL;
+
+  ConversionIndex *index = calloc(1, sizeof(*index));
+  if (!index) return NULL;
+  index->interval = header[1];
+  index->num_frames = header[2];
+  index->num_keyframes = header[3];
+  index->state_size = header[4];
+  index->file_size = header[5];
+  index->file_mtime = header[6];
+  index->term_rows = header[7];
+  index->term_cols = header[8];
+  index->version = header[9];
+
+  size_t n = index->num_keyframes;
+  if (header[0] != INDEX_FORMAT || !index->interval ||
+      n != index->num_frames / index->interval + 1 ||
+      index->file_size != (uint64_t)st.st_size ||
+      index->file_mtime != (int64_t)st.st_mtime ||
+      index->term_rows != c->term_rows || index->term_cols != c->term_cols ||
+      index->version != c->version ||
+      index->state_size != tmt_state_size(c->vt))
+    goto fail;
+
+  index->keyframes = malloc(n * sizeof(Keyframe));
+  index->states = malloc(n * index->state_size);
+  index->capacity = n;
+  if (!index->keyframes || !index->states ||
+      fread(index->keyframes, sizeof(Keyframe), n, in) != n ||
+      fread(index->states, index->state_size, n, in) != n)
+    goto fail;
+  return index;
+
+fail:
+  conversion_free_index(index);
+  return NULL;
+}
+
+void conversion_free_index(ConversionIndex *index) {
+  if (!index) return;
+  free(index->keyframes);
+  free(index->states);
+  free(index);
+}
+
+int conversion_load_ttyrec_at(Conversion *c, FILE *f,
+                              const ConversionIndex *index, size_t frame) {
+  if (index->state_size != tmt_state_size(c->vt) ||
+      index->version != c->version || !index->num_keyframes)
+    return EXIT_FAILURE;
+
+  /* The last keyframe at or before frame. */
+  size_t lo = 0, hi = index->num_keyframes;
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (index->keyframes[mid].frame <= frame)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  const Keyframe *k = &index->keyframes[lo];
+
+  BzInput *in = bzinput_open_at(f, k->offset, k->block_bit, k->block_offset);
+  if (!in) {
+    perror("Could not open bzip2 file");
+    return EXIT_FAILURE;
+  }
+  if (c->bfp) {
+    bzinput_close(c->bfp);
+  }
+  c->bfp = in;
+  tmt_load_state(c->vt, index->states + lo * index->state_size);
+  c->frame = k->frame;
+  c->skip = frame - k->frame;
+  return EXIT_SUCCESS;
+}
+
 void callback(tmt_msg_t m, TMT *vt, const void *a, void *p) {
   UNUSED(m);
   UNUSED(a);
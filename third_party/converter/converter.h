@@ -2,6 +2,7 @@
 #define CONVERTER_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <sys/time.h>
 
 #ifdef __cplusplus
@@ -51,6 +52,45 @@ typedef struct Int64Ptr {
   int64_t *end;
 } Int64Ptr;
 
+/* Where to resume a ttyrec to convert it from frame `frame` on. */
+typedef struct Keyframe {
+  uint64_t frame;        /* Number of frames before this point. */
+  uint64_t offset;       /* Decompressed offset of the next record. */
+  uint64_t block_bit;    /* See bzinput_block. */
+  uint64_t block_offset;
+} Keyframe;
+
+/* Keyframes of one ttyrec every `interval` frames, each with a snapshot of
+ * the terminal (state_size bytes each, in states). Converting from a
+ * keyframe gives the same frames as converting the whole file on a fresh
+ * terminal. */
+typedef struct ConversionIndex {
+  uint64_t interval;
+  uint64_t num_frames; /* In the whole ttyrec. */
+  uint64_t num_keyframes;
+  uint64_t state_size;
+  Keyframe *keyframes;
+  char *states;
+
+  /* Identify the ttyrec and the conversion it was built for. */
+  uint64_t file_size;
+  int64_t file_mtime;
+  uint64_t term_rows;
+  uint64_t term_cols;
+  uint64_t version;
+
+  size_t capacity;
+} ConversionIndex;
+
+/* What a ttyrec holds, as far as its headers tell. */
+typedef struct TtyrecStats {
+  uint64_t records[256];   /* Per channel (all 0 in version 1 ttyrecs). */
+  uint64_t frames;         /* As many as a conversion outputs. */
+  int64_t first_timestamp; /* In microseconds, over all records. */
+  int64_t last_timestamp;
+  uint64_t size;           /* Decompressed, up to the last record read. */
+} TtyrecStats;
+
 typedef struct Conversion {
   void *vt; /* TMT object. */
 
@@ -73,8 +113,13 @@ typedef struct Conversion {
 
   Header header; /* Most recently read header. */
 
-  void *bfp; /* Pointer to current ttyrec BZFILE. */
+  void *bfp; /* Pointer to current ttyrec BzInput. */
+  int threads; /* Threads decompressing each ttyrec, see bzinput.h. */
   char *buf; /* Buffer for read data. */
+
+  uint64_t frame; /* Frames since the start of the ttyrec. */
+  uint64_t skip;  /* Frames still to convert without output. */
+  ConversionIndex *index; /* Index being built, if any. */
 } Conversion;
 
 Conversion *conversion_create(size_t rows, size_t cols, size_t term_rows,
@@ -85,10 +130,35 @@ void conversion_set_buffers(Conversion *c, unsigned char *chars, size_t chars_si
                             int64_t *timestamps, size_t timestamps_size,
                             unsigned char *inputs, size_t inputs_size,
                             int32_t *scores, size_t scores_size);
+void conversion_set_threads(Conversion *c, int threads);
 int conversion_load_ttyrec(Conversion *c, FILE *f);
+/* Like conversion_load_ttyrec, for a ttyrec.bz2 held in memory. data must
+ * stay valid until the next load or conversion_close. */
+int conversion_load_ttyrec_memory(Conversion *c, const void *data,
+                                  size_t size);
 int conversion_convert_frames(Conversion *c);
 int conversion_close(Conversion *c);
 
+/* Reads the headers of f, skipping the bodies without running the
+ * terminal. Returns the status that ended the scan, CONV_STREAM_END at the
+ * end of f; stats cover the records before it either way. */
+int conversion_scan_ttyrec(FILE *f, size_t version, int threads,
+                           TtyrecStats *stats);
+
+/* Indexes all of f, on a fresh terminal like c's. */
+ConversionIndex *conversion_index_ttyrec(const Conversion *c, FILE *f,
+                                         size_t interval);
+/* Reads an index written by conversion_write_index. Returns NULL if it isn't
+ * one, or if it was built for another version of f or a different c. */
+ConversionIndex *conversion_read_index(const Conversion *c, FILE *f,
+                                       FILE *in);
+int conversion_write_index(const ConversionIndex *index, FILE *out);
+void conversion_free_index(ConversionIndex *index);
+/* Like conversion_load_ttyrec, but the next frame converted is frame `frame`
+ * of f, with the terminal state of a conversion of all of f. */
+int conversion_load_ttyrec_at(Conversion *c, FILE *f,
+                              const ConversionIndex *index, size_t frame);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,144 @@
+/*
+ *  Delta encoding of converted terminal frames, see framedelta.h.
+ *
+ *  The encoder finds changed cells 16 at a time with SSE2 where available.
+ *  Decoding a sequence copies each frame on from the previous one and
+ *  scatters its changes, so it runs at memcpy speed for typical frames.
+ */
+
+#include <string.h>
+
+#include "framedelta.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define CELL_SIZE 4 /* uint16 cell, uint8 char, int8 color */
+
+static void put_u16(unsigned char *out, uint16_t v) {
+  memcpy(out, &v, sizeof(v));
+}
+
+static uint16_t get_u16(const unsigned char *in) {
+  uint16_t v;
+  memcpy(&v, in, sizeof(v));
+  return v;
+}
+
+static size_t encode_keyframe(const unsigned char *chars,
+                              const signed char *colors, size_t cells,
+                              unsigned char *out) {
+  put_u16(out, FRAMEDELTA_KEYFRAME);
+  memcpy(out + 2, chars, cells);
+  memcpy(out + 2 + cells, colors, cells);
+  return 2 + 2 * cells;
+}
+
+size_t framedelta_bound(size_t cells) { return 2 + 2 * cells; }
+
+static unsigned char *put_cell(unsigned char *p, size_t i,
+                               const unsigned char *chars,
+                               const signed char *colors) {
+  put_u16(p, (uint16_t)i);
+  p[2] = chars[i];
+  memcpy(p + 3, &colors[i], 1);
+  return p + CELL_SIZE;
+}
+
+size_t framedelta_encode(const unsigned char *chars, const signed char *colors,
+                         const unsigned char *prev_chars,
+                         const signed char *prev_colors, size_t cells,
+                         unsigned char *out) {
+  if (!prev_chars) return encode_keyframe(chars, colors, cells, out);
+
+  /* A delta with more cells than this is no smaller than a keyframe. */
+  size_t max_changes = (2 * cells) / CELL_SIZE;
+  unsigned char *p = out + 2, *end = out + 2 + max_changes * CELL_SIZE;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= cells; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(chars + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(prev_chars + i));
+    __m128i c = _mm_loadu_si128((const __m128i *)(colors + i));
+    __m128i d = _mm_loadu_si128((const __m128i *)(prev_colors + i));
+    __m128i same = _mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(c, d));
+    unsigned mask = ~(unsigned)_mm_movemask_epi8(same) & 0xffff;
+    while (mask) {
+      if (p == end) return encode_keyframe(chars, colors, cells, out);
+      p = put_cell(p, i + __builtin_ctz(mask), chars, colors);
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i < cells; ++i) {
+    if (chars[i] == prev_chars[i] && colors[i] == prev_colors[i]) continue;
+    if (p == end) return encode_keyframe(chars, colors, cells, out);
+    p = put_cell(p, i, chars, colors);
+  }
+
+  put_u16(out, (uint16_t)((p - out - 2) / CELL_SIZE));
+  return p - out;
+}
+
+int framedelta_is_keyframe(const unsigned char *in) {
+  return get_u16(in) == FRAMEDELTA_KEYFRAME;
+}
+
+size_t framedelta_apply(const unsigned char *in, unsigned char *chars,
+                        signed char *colors, size_t cells) {
+  uint16_t n = get_u16(in);
+  if (n == FRAMEDELTA_KEYFRAME) {
+    memcpy(chars, in + 2, cells);
+    memcpy(colors, in + 2 + cells, cells);
+    return 2 + 2 * cells;
+  }
+  const unsigned char *p = in + 2;
+  for (uint16_t k = 0; k < n; ++k, p += CELL_SIZE) {
+    uint16_t i = get_u16(p);
+    if (i >= cells) continue; /* Corrupt. */
+    chars[i] = p[2];
+    memcpy(&colors[i], p + 3, 1);
+  }
+  return 2 + (size_t)n * CELL_SIZE;
+}
+
+/* Whether the frame encoded at offset lies within data[0, size). */
+static int frame_fits(const unsigned char *data, size_t size, uint64_t offset,
+                      size_t cells) {
+  if (offset >= size || size - offset < 2) return 0;
+  uint16_t n = get_u16(data + offset);
+  size_t len = n == FRAMEDELTA_KEYFRAME ? 2 + 2 * cells
+                                        : 2 + (size_t)n * CELL_SIZE;
+  return len <= size - offset;
+}
+
+int framedelta_decode(const unsigned char *data, size_t size,
+                      const uint64_t *offsets, size_t start, size_t n,
+                      size_t cells, unsigned char *chars,
+                      signed char *colors) {
+  if (!n) return 0;
+
+  for (size_t t = 0; t < n; ++t)
+    if (!frame_fits(data, size, offsets[start + t], cells)) return -1;
+
+  /* Rebuild frame start in the first output slot. */
+  size_t k = start;
+  while (!framedelta_is_keyframe(data + offsets[k]))
+    if (k == 0 || !frame_fits(data, size, offsets[--k], cells)) return -1;
+  for (; k <= start; ++k)
+    framedelta_apply(data + offsets[k], chars, colors, cells);
+
+  for (size_t t = 1; t < n; ++t) {
+    unsigned char *c = chars + t * cells;
+    signed char *o = colors + t * cells;
+    const unsigned char *in = data + offsets[start + t];
+    if (!framedelta_is_keyframe(in)) {
+      memcpy(c, c - cells, cells);
+      memcpy(o, o - cells, cells);
+    }
+    framedelta_apply(in, c, o, cells);
+  }
+  return 0;
+}
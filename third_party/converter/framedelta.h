@@ -0,0 +1,61 @@
+#ifndef FRAMEDELTA_H
+#define FRAMEDELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * Delta encoding of converted terminal frames (chars and colors of
+ * rows * cols cells, at most 65535 cells). Each frame is encoded either as
+ * a keyframe holding all cells, or as the cells that changed since the
+ * previous frame:
+ *
+ *   keyframe  uint16 0xffff, uint8 chars[cells], int8 colors[cells]
+ *   delta     uint16 n, n * (uint16 cell, uint8 char, int8 color)
+ *
+ * in native byte order. A delta that would be larger than a keyframe is
+ * stored as a keyframe. Decoding frame i starts from the last keyframe at
+ * or before it, so encoders should emit one every few frames.
+ */
+
+#define FRAMEDELTA_KEYFRAME 0xffff
+#define FRAMEDELTA_MAX_CELLS 0xfffe
+
+/* Upper bound on the encoded size of one frame. */
+size_t framedelta_bound(size_t cells);
+
+/* Encodes a frame into out, as a keyframe if prev_chars is NULL, else as a
+ * delta from prev_chars and prev_colors. Returns the number of bytes
+ * written. */
+size_t framedelta_encode(const unsigned char *chars, const signed char *colors,
+                         const unsigned char *prev_chars,
+                         const signed char *prev_colors, size_t cells,
+                         unsigned char *out);
+
+/* Whether the frame encoded at in is a keyframe. */
+int framedelta_is_keyframe(const unsigned char *in);
+
+/* Applies the frame encoded at in to chars and colors, which hold the
+ * previous frame unless it's a keyframe. Returns the bytes consumed. */
+size_t framedelta_apply(const unsigned char *in, unsigned char *chars,
+                        signed char *colors, size_t cells);
+
+/* Decodes the n frames from frame start on into chars and colors, both
+ * [n, cells]. offsets[i] is where frame i is encoded in data, which holds
+ * size bytes. Returns 0, or -1 without decoding anything if one of the
+ * frames needed doesn't lie within data or there is no keyframe at or
+ * before frame start. */
+int framedelta_decode(const unsigned char *data, size_t size,
+                      const uint64_t *offsets, size_t start, size_t n,
+                      size_t cells, unsigned char *chars,
+                      signed char *colors);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAMEDELTA_H */
@@ -1,14 +1,35 @@
 /* Copyright (c) Facebook, Inc. and its affiliates. */
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <new>
+#include <random>
 #include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bzlib.h>
 
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
 #include "converter.h"
+#include "framedelta.h"
+#include "ziparchive.h"
+#include "nlecolumns.h"
 
 namespace py = pybind11;
 using namespace py::literals;
@@ -55,11 +76,79 @@ checked_conversion(py::handle h, const std::vector<size_t> &shape)
 }
 // end of adapted from pynethack.c
 
+/* The members of a zip archive, see ziparchive.h. */
+class ZipFile
+{
+  public:
+    ZipFile(const std::string &filename) : filename_(filename)
+    {
+        errno = 0;
+        zip_ = ziparchive_open(filename.c_str());
+        if (zip_ == nullptr) {
+            if (errno) {
+                PyErr_SetFromErrnoWithFilename(PyExc_OSError,
+                                               filename.c_str());
+                throw py::error_already_set();
+            }
+            throw std::runtime_error("Not a zip archive: '" + filename + "'");
+        }
+    }
+
+    ~ZipFile() { ziparchive_close(zip_); }
+
+    std::vector<std::string>
+    names() const
+    {
+        std::vector<std::string> result;
+        for (size_t i = 0; i < ziparchive_num_members(zip_); ++i)
+            result.push_back(ziparchive_member(zip_, i)->name);
+        return result;
+    }
+
+    bool
+    contains(const std::string &name) const
+    {
+        return ziparchive_find(zip_, name.c_str()) != nullptr;
+    }
+
+    size_t
+    size() const
+    {
+        return ziparchive_num_members(zip_);
+    }
+
+    const ZipMember &
+    member(const std::string &name) const
+    {
+        const ZipMember *member = ziparchive_find(zip_, name.c_str());
+        if (member == nullptr)
+            throw py::key_error("No member '" + name + "' in '" + filename_
+                                + "'");
+        return *member;
+    }
+
+    const void *
+    data(const ZipMember &member) const
+    {
+        const void *data = ziparchive_data(zip_, &member);
+        if (data == nullptr)
+            throw std::runtime_error("Corrupt member '"
+                                     + std::string(member.name) + "' in '"
+                                     + filename_ + "'");
+        return data;
+    }
+
+    const std::string filename_;
+
+  private:
+    ZipArchive *zip_ = nullptr;
+};
+
 class Converter
 {
   public:
-    Converter(size_t rows, size_t cols, size_t ttyrec_version, size_t term_rows, size_t term_cols
-              )
+    Converter(size_t rows, size_t cols, size_t ttyrec_version, size_t term_rows, size_t term_cols,
+              int threads)
         : rows_(rows), cols_(cols),
           ttyrec_version_(ttyrec_version),
           term_rows_((term_rows != 0) ? term_rows : rows),
@@ -73,19 +162,25 @@ class Converter
         if (conversion_ == nullptr) {
             throw std::bad_alloc();
         }
+        conversion_set_threads(conversion_, threads);
     }
 
     ~Converter()
     {
         conversion_close(conversion_);
+        conversion_free_index(index_);
         if (ttyrec_ != nullptr) {
             fclose(ttyrec_);
         }
     }
 
     void
-    load_ttyrec(const std::string filename, size_t gameid, size_t part)
+    load_ttyrec(const std::string filename, size_t gameid, size_t part,
+                size_t start_frame, size_t index_interval)
     {
+        if (start_frame > 0)
+            index_ttyrec(filename, index_interval);
+
         if (ttyrec_ == nullptr)
             ttyrec_ = fopen(filename.c_str(), "r");
         else
@@ -95,17 +190,64 @@ class Converter
             throw py::error_already_set();
         }
 
-        int status = conversion_load_ttyrec(conversion_, ttyrec_);
+        int status;
+        if (start_frame > 0) {
+            py::gil_scoped_release release;
+            status = conversion_load_ttyrec_at(conversion_, ttyrec_, index_,
+                                               start_frame);
+        } else {
+            status = conversion_load_ttyrec(conversion_, ttyrec_);
+        }
         if (status != 0) {
             throw std::runtime_error("File failed to load: '" + filename
                                      + "'");
         }
 
+        memory_owner_ = py::object();
+
         gameid_ = gameid;
         part_ = part;
         filename_ = std::move(filename);
     }
 
+    /* Loads a ttyrec.bz2 from an object supporting the buffer protocol
+     * (bytes, mmap, ...), without copying it. */
+    void
+    load_ttyrec_buffer(py::buffer buffer, size_t gameid, size_t part,
+                       std::string name)
+    {
+        py::buffer_info info = buffer.request();
+        load_memory(info.ptr, info.size * info.itemsize, buffer,
+                    std::move(name), gameid, part);
+    }
+
+    /* Loads a member of a ZipFile. Stored members, the usual case for
+     * ttyrec.bz2 files, are read straight from the mapped archive;
+     * deflated ones are inflated into memory first. */
+    void
+    load_ttyrec_zip(py::object archive, std::string member, size_t gameid,
+                    size_t part)
+    {
+        const ZipFile &zip = archive.cast<const ZipFile &>();
+        const ZipMember &m = zip.member(member);
+        const void *data = zip.data(m);
+        if (m.method == ZIP_STORED) {
+            load_memory(data, m.compressed_size, archive, std::move(member),
+                        gameid, part);
+        } else if (m.method == ZIP_DEFLATED) {
+            py::bytes raw(static_cast<const char *>(data), m.compressed_size);
+            py::object inflated = py::module::import("zlib").attr(
+                "decompress")(raw, -15, m.uncompressed_size);
+            load_memory(PyBytes_AsString(inflated.ptr()),
+                        PyBytes_Size(inflated.ptr()), inflated,
+                        std::move(member), gameid, part);
+        } else {
+            throw std::runtime_error("Unsupported compression method "
+                                     + std::to_string(m.method) + " for '"
+                                     + member + "'");
+        }
+    }
+
     int
     convert(py::object chars, py::object colors, py::object cursors,
             py::object timestamps, py::object inputs, py::object scores)
@@ -145,10 +287,59 @@ class Converter
         return conversion_->remaining;
     }
 
+    /* Makes sure there's a keyframe index of filename, "<filename>.idx",
+     * building and saving it if it's missing or stale (unless that's not
+     * possible, eg. in a read-only directory). Returns the number of frames
+     * of the ttyrec. */
+    size_t
+    index_ttyrec(const std::string &filename, size_t interval)
+    {
+        if (index_ != nullptr && index_filename_ == filename)
+            return index_->num_frames;
+        conversion_free_index(index_);
+        index_ = nullptr;
+        index_filename_.clear();
+
+        std::unique_ptr<FILE, int (*)(FILE *)> ttyrec(
+            fopen(filename.c_str(), "r"), fclose);
+        if (!ttyrec) {
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename.c_str());
+            throw py::error_already_set();
+        }
+
+        std::string index_filename = filename + ".idx";
+        py::gil_scoped_release release;
+        std::unique_ptr<FILE, int (*)(FILE *)> in(
+            fopen(index_filename.c_str(), "rb"), fclose);
+        if (in)
+            index_ = conversion_read_index(conversion_, ttyrec.get(),
+                                           in.get());
+        if (index_ == nullptr) {
+            index_ = conversion_index_ttyrec(conversion_, ttyrec.get(),
+                                             interval);
+            if (index_ == nullptr)
+                throw std::runtime_error("Failed to index '" + filename
+                                         + "'");
+
+            /* Write to a temporary file so readers never see half of it. */
+            std::string tmp = index_filename + "."
+                              + std::to_string(getpid()) + ".tmp";
+            FILE *out = fopen(tmp.c_str(), "wb");
+            if (out != nullptr) {
+                bool ok = conversion_write_index(index_, out) == 0;
+                ok = fclose(out) == 0 && ok;
+                if (!ok || rename(tmp.c_str(), index_filename.c_str()) != 0)
+                    unlink(tmp.c_str());
+            }
+        }
+        index_filename_ = filename;
+        return index_->num_frames;
+    }
+
     bool
     is_loaded()
     {
-        return ttyrec_ != nullptr && filename_ != "";
+        return (ttyrec_ != nullptr || memory_owner_) && filename_ != "";
     }
 
     const std::string &
@@ -176,8 +367,29 @@ class Converter
     const size_t ttyrec_version_ = 0;
 
   private:
+    void
+    load_memory(const void *data, size_t size, py::object owner,
+                std::string name, size_t gameid, size_t part)
+    {
+        if (conversion_load_ttyrec_memory(conversion_, data, size) != 0)
+            throw std::runtime_error("File failed to load: '" + name + "'");
+        /* The previous input is closed, so its memory can go. */
+        memory_owner_ = std::move(owner);
+        if (ttyrec_ != nullptr) {
+            fclose(ttyrec_);
+            ttyrec_ = nullptr;
+        }
+
+        gameid_ = gameid;
+        part_ = part;
+        filename_ = std::move(name);
+    }
+
     Conversion *conversion_ = nullptr;
     FILE *ttyrec_ = nullptr;
+    py::object memory_owner_; /* Holds the ttyrec loaded from memory. */
+    ConversionIndex *index_ = nullptr;
+    std::string index_filename_;
 
     std::string filename_;
     // These attributes are purely for human readable id of what is loaded
@@ -185,16 +397,1458 @@ class Converter
     size_t gameid_ = 0;
 };
 
+/* A fixed set of threads running index-parallel jobs. The calling thread
+ * works on the job too. */
+class ThreadPool
+{
+  public:
+    explicit ThreadPool(size_t num_threads)
+    {
+        for (size_t i = 1; i < num_threads; ++i)
+            threads_.emplace_back(&ThreadPool::work, this);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (std::thread &thread : threads_)
+            thread.join();
+    }
+
+    /* Calls fn(i) for i in [0, n), returns when all calls are done. */
+    void
+    run(size_t n, const std::function<void(size_t)> &fn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fn_ = &fn;
+            n_ = n;
+            next_ = 0;
+            ++generation_;
+        }
+        cv_.notify_all();
+
+        for (size_t i = next_++; i < n; i = next_++)
+            fn(i);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return active_ == 0; });
+        /* No worker can pick up this job after this. */
+        fn_ = nullptr;
+    }
+
+  private:
+    void
+    work()
+    {
+        size_t seen = 0;
+        for (;;) {
+            const std::function<void(size_t)> *fn;
+            size_t n;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] {
+                    return stop_ || (fn_ && generation_ != seen);
+                });
+                if (stop_)
+                    return;
+                seen = generation_;
+                fn = fn_;
+                n = n_;
+                ++active_;
+            }
+            for (size_t i = next_++; i < n; i = next_++)
+                (*fn)(i);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --active_;
+            }
+            done_cv_.notify_all();
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(size_t)> *fn_ = nullptr;
+    size_t n_ = 0;
+    std::atomic<size_t> next_{ 0 };
+    size_t generation_ = 0;
+    size_t active_ = 0;
+    bool stop_ = false;
+};
+
+/* Memory-mapped index of the games of a dataset, written by
+ * nle.dataset.gameindex.write, so that workers look up the ttyrecs and
+ * metadata of games without loading them from sqlite. All fields are
+ * 8-byte little-endian words:
+ *
+ *   "NLEGIDX1", num_games, num_parts, num_columns, names_size, pool_size,
+ *   ttyrec_version,
+ *   gameids[num_games] (ascending),
+ *   part_offsets[num_games + 1] (parts of game i are part_offsets[i], ...),
+ *   path_offsets[num_parts] (into pool),
+ *   columns[num_columns][num_games],
+ *   names[names_size / 8] (NUL-terminated column names, padded),
+ *   pool[pool_size / 8] (NUL-terminated paths, padded). */
+class GameIndex
+{
+  public:
+    GameIndex(const std::string &filename) : filename_(filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename.c_str());
+            throw py::error_already_set();
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size_ = st.st_size;
+            data_ = static_cast<const char *>(
+                mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0));
+        }
+        ::close(fd);
+        if (!data_ || data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::runtime_error("Could not map '" + filename + "'");
+        }
+        try {
+            parse();
+        } catch (...) {
+            munmap(const_cast<char *>(data_), size_);
+            throw;
+        }
+    }
+
+    ~GameIndex()
+    {
+        munmap(const_cast<char *>(data_), size_);
+    }
+
+    size_t
+    size() const
+    {
+        return num_games_;
+    }
+
+    /* Position of gameid in the index, or -1. */
+    ssize_t
+    find(int64_t gameid) const
+    {
+        const int64_t *it =
+            std::lower_bound(gameids_, gameids_ + num_games_, gameid);
+        if (it == gameids_ + num_games_ || *it != gameid)
+            return -1;
+        return it - gameids_;
+    }
+
+    bool
+    contains(int64_t gameid) const
+    {
+        return find(gameid) >= 0;
+    }
+
+    int64_t
+    gameid(size_t i) const
+    {
+        return gameids_[i];
+    }
+
+    size_t
+    num_parts(size_t i) const
+    {
+        return part_offsets_[i + 1] - part_offsets_[i];
+    }
+
+    const char *
+    path(size_t i, size_t part) const
+    {
+        return pool_ + path_offsets_[part_offsets_[i] + part];
+    }
+
+    std::vector<std::string>
+    get_paths(int64_t gameid) const
+    {
+        ssize_t i = find(gameid);
+        if (i < 0)
+            throw py::key_error("No game " + std::to_string(gameid) + " in '"
+                                + filename_ + "'");
+        std::vector<std::string> result;
+        for (size_t part = 0; part < num_parts(i); ++part)
+            result.push_back(path(i, part));
+        return result;
+    }
+
+    const std::vector<std::string> &
+    columns() const
+    {
+        return names_;
+    }
+
+    /* Read-only views of the mapping, keeping the index (self) alive. */
+    py::array
+    gameids_array(py::object self) const
+    {
+        return view(gameids_, self);
+    }
+
+    py::array
+    column_array(py::object self, const std::string &name) const
+    {
+        auto it = std::find(names_.begin(), names_.end(), name);
+        if (it == names_.end())
+            throw py::key_error("No column '" + name + "' in '" + filename_
+                                + "'");
+        return view(columns_ + (it - names_.begin()) * num_games_, self);
+    }
+
+    const std::string filename_;
+    uint64_t ttyrec_version_ = 0;
+
+  private:
+    py::array
+    view(const int64_t *data, py::object self) const
+    {
+        py::array result(py::dtype::of<int64_t>(),
+                         std::vector<ssize_t>{ (ssize_t) num_games_ },
+                         std::vector<ssize_t>{ sizeof(int64_t) }, data,
+                         self);
+        result.attr("setflags")(false);
+        return result;
+    }
+
+    const uint64_t *
+    words(size_t &pos, uint64_t n) const
+    {
+        if (pos > size_ / 8 || n > size_ / 8 - pos)
+            throw std::runtime_error("Truncated game index: '" + filename_
+                                     + "'");
+        const uint64_t *p = reinterpret_cast<const uint64_t *>(data_) + pos;
+        pos += n;
+        return p;
+    }
+
+    void
+    parse()
+    {
+        size_t pos = 0;
+        const uint64_t *header = words(pos, 7);
+        if (std::memcmp(header, "NLEGIDX1", 8) != 0)
+            throw std::runtime_error("Not a game index: '" + filename_
+                                     + "'");
+        num_games_ = header[1];
+        uint64_t num_parts = header[2], num_columns = header[3];
+        uint64_t names_size = header[4], pool_size = header[5];
+        ttyrec_version_ = header[6];
+        if (names_size % 8 || pool_size % 8 || !pool_size)
+            throw std::runtime_error("Corrupt game index: '" + filename_
+                                     + "'");
+
+        gameids_ = reinterpret_cast<const int64_t *>(words(pos, num_games_));
+        part_offsets_ = words(pos, num_games_ + 1);
+        path_offsets_ = words(pos, num_parts);
+        if (num_columns && num_games_ > (size_ / 8) / num_columns)
+            throw std::runtime_error("Truncated game index: '" + filename_
+                                     + "'");
+        columns_ = reinterpret_cast<const int64_t *>(
+            words(pos, num_columns * num_games_));
+        const char *names =
+            reinterpret_cast<const char *>(words(pos, names_size / 8));
+        pool_ = reinterpret_cast<const char *>(words(pos, pool_size / 8));
+
+        bool valid = part_offsets_[0] == 0
+                     && part_offsets_[num_games_] == num_parts
+                     && pool_[pool_size - 1] == '\0';
+        for (size_t i = 0; valid && i < num_games_; ++i)
+            valid = part_offsets_[i] <= part_offsets_[i + 1]
+                    && (i == 0 || gameids_[i - 1] < gameids_[i]);
+        for (size_t i = 0; valid && i < num_parts; ++i)
+            valid = path_offsets_[i] < pool_size;
+        for (size_t i = 0, start = 0; valid && i < names_size; ++i) {
+            if (names[i] == '\0') {
+                if (i > start)
+                    names_.emplace_back(names + start, i - start);
+                start = i + 1;
+            }
+        }
+        if (!valid || names_.size() != num_columns)
+            throw std::runtime_error("Corrupt game index: '" + filename_
+                                     + "'");
+    }
+
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    size_t num_games_ = 0;
+    const int64_t *gameids_ = nullptr;
+    const uint64_t *part_offsets_ = nullptr;
+    const uint64_t *path_offsets_ = nullptr;
+    const int64_t *columns_ = nullptr;
+    const char *pool_ = nullptr;
+    std::vector<std::string> names_;
+};
+
+/* The rows of [batch, seq, ...] minibatches, converted independently: one
+ * conversion per row, continuing into the next part of its game or else
+ * onto the game next_game() picks. Follows convert_frames and
+ * TtyrecDataset._make_load_fn in dataset.py. */
+class BatchRows
+{
+  public:
+    typedef std::vector<std::pair<int32_t, std::vector<std::string>>> Games;
+
+    /* The games rows take: either (gameid, [paths of part 0, 1, ...]) or
+     * the given games of a GameIndex, their paths relative to root. */
+    struct GameList {
+        Games games;
+        std::shared_ptr<const GameIndex> index;
+        std::vector<size_t> positions;
+        std::string root;
+
+        GameList(Games games = Games()) : games(std::move(games)) {}
+
+        GameList(std::shared_ptr<const GameIndex> index,
+                 const std::vector<int64_t> &gameids, std::string root)
+            : index(index), root(std::move(root))
+        {
+            for (int64_t gameid : gameids) {
+                ssize_t i = index->find(gameid);
+                if (i < 0)
+                    throw py::key_error("No game " + std::to_string(gameid)
+                                        + " in '" + index->filename_ + "'");
+                positions.push_back(i);
+            }
+        }
+
+        size_t
+        size() const
+        {
+            return index ? positions.size() : games.size();
+        }
+
+        int32_t
+        gameid(size_t g) const
+        {
+            return index ? index->gameid(positions[g]) : games[g].first;
+        }
+
+        size_t
+        num_parts(size_t g) const
+        {
+            return index ? index->num_parts(positions[g])
+                         : games[g].second.size();
+        }
+
+        std::string
+        path(size_t g, size_t part) const
+        {
+            if (!index)
+                return games[g].second.at(part);
+            if (part >= num_parts(g))
+                throw std::out_of_range("No such part");
+            const char *path = index->path(positions[g], part);
+            if (root.empty() || path[0] == '/')
+                return path;
+            return root + "/" + path;
+        }
+
+        /* Fisher-Yates with a fixed generator, so a seed gives the same
+         * order everywhere (unlike std::shuffle). */
+        void
+        shuffle(uint64_t seed)
+        {
+            std::mt19937_64 rng(seed);
+            for (size_t i = size() ? size() - 1 : 0; i > 0; --i) {
+                size_t j = rng() % (i + 1);
+                if (index)
+                    std::swap(positions[i], positions[j]);
+                else
+                    std::swap(games[i], games[j]);
+            }
+        }
+    };
+
+  protected:
+    BatchRows(size_t rows, size_t cols, size_t ttyrec_version,
+              size_t batch_size, size_t term_rows, size_t term_cols)
+        : rows_(rows), cols_(cols), ttyrec_version_(ttyrec_version),
+          batch_size_(batch_size), term_rows_(term_rows ? term_rows : rows),
+          term_cols_(term_cols ? term_cols : cols)
+    {
+        if (term_rows_ < 2 || term_cols_ < 2)
+            throw std::invalid_argument(
+                "Terminal invalid: term_rows and term_cols must be >1");
+        if (!batch_size_)
+            throw std::invalid_argument("batch_size must be positive");
+
+        for (size_t b = 0; b < batch_size_; ++b) {
+            Row row;
+            row.conversion = conversion_create(rows_, cols_, term_rows_,
+                                               term_cols_, ttyrec_version_);
+            if (row.conversion == nullptr)
+                throw std::bad_alloc();
+            rows_state_.push_back(row);
+        }
+    }
+
+    virtual ~BatchRows()
+    {
+        for (Row &row : rows_state_) {
+            conversion_close(row.conversion);
+            if (row.ttyrec)
+                fclose(row.ttyrec);
+        }
+    }
+
+    struct Row {
+        Conversion *conversion = nullptr;
+        FILE *ttyrec = nullptr;
+        ssize_t game = -1; /* Index into games_. */
+        int32_t gameid = 0;
+        size_t part = 0;
+    };
+
+    struct Buffers {
+        size_t seq;
+        uint8_t *chars;
+        int8_t *colors;
+        int16_t *cursors;
+        int64_t *timestamps;
+        uint8_t *inputs;
+        int32_t *scores;
+        uint8_t *resets;
+        int32_t *gameids;
+    };
+
+    /* Checks the arrays, all of shape [batch_size, seq, ...]. */
+    Buffers
+    checked_buffers(py::object chars, py::object colors, py::object cursors,
+                    py::object timestamps, py::object inputs,
+                    py::object scores, py::object resets, py::object gameids)
+    {
+        if (!py::isinstance<py::array>(chars))
+            throw std::invalid_argument("Numpy array required");
+        py::array array = py::array::ensure(chars);
+        if (array.ndim() != 4)
+            throw std::invalid_argument("chars must be [batch, seq, rows, "
+                                        "cols]");
+        size_t seq = array.shape(1);
+        size_t b = batch_size_;
+
+        Buffers buf;
+        buf.seq = seq;
+        buf.chars =
+            checked_conversion<uint8_t>(chars, { b, seq, rows_, cols_ });
+        buf.colors =
+            checked_conversion<int8_t>(colors, { b, seq, rows_, cols_ });
+        buf.cursors = checked_conversion<int16_t>(cursors, { b, seq, 2 });
+        buf.timestamps = checked_conversion<int64_t>(timestamps, { b, seq });
+        buf.inputs = checked_conversion<uint8_t>(inputs, { b, seq });
+        buf.scores = checked_conversion<int32_t>(scores, { b, seq });
+        buf.resets = checked_conversion<uint8_t>(resets, { b, seq });
+        buf.gameids = checked_conversion<int32_t>(gameids, { b, seq });
+        if (!buf.chars || !buf.colors || !buf.cursors || !buf.timestamps
+            || !buf.inputs || !buf.scores || !buf.resets || !buf.gameids)
+            throw std::invalid_argument("All buffers are required");
+        return buf;
+    }
+
+    /* The index into games_ of the game row i continues with, or -1 if
+     * there are no more. */
+    virtual ssize_t next_game(size_t i) = 0;
+
+    /* Loads the next part of the row's game, or else the next game. */
+    bool
+    load_next(size_t i)
+    {
+        Row &row = rows_state_[i];
+        size_t game, part;
+        if (row.game >= 0 && row.part + 1 < games_.num_parts(row.game)) {
+            game = row.game;
+            part = row.part + 1;
+        } else {
+            ssize_t next = games_.size() == 0 ? -1 : next_game(i);
+            if (next < 0)
+                return false;
+            game = next;
+            part = 0;
+        }
+
+        const std::string filename = games_.path(game, part);
+        FILE *f = fopen(filename.c_str(), "r");
+        if (f == nullptr)
+            throw std::runtime_error("Could not open '" + filename
+                                     + "': " + std::strerror(errno));
+        if (row.ttyrec)
+            fclose(row.ttyrec);
+        row.ttyrec = f;
+        if (conversion_load_ttyrec(row.conversion, f) != 0)
+            throw std::runtime_error("File failed to load: '" + filename
+                                     + "'");
+        row.game = game;
+        row.gameid = games_.gameid(game);
+        row.part = part;
+        return true;
+    }
+
+    void
+    convert_row(size_t i, const Buffers &buf)
+    {
+        Row &row = rows_state_[i];
+        const size_t frame = rows_ * cols_;
+        size_t t = 0; /* Start of the unfilled part of this row. */
+        size_t base = i * buf.seq;
+
+        buf.resets[base] = 0;
+        for (;;) {
+            size_t n = buf.seq - t, o = base + t;
+            conversion_set_buffers(
+                row.conversion, buf.chars + o * frame, n * frame,
+                reinterpret_cast<signed char *>(buf.colors) + o * frame,
+                n * frame, buf.cursors + 2 * o, 2 * n, buf.timestamps + o, n,
+                buf.inputs + o, n, buf.scores + o, n);
+            if (conversion_convert_frames(row.conversion)
+                == CONV_CRITICAL_ERROR)
+                throw std::runtime_error("Error in file.");
+
+            size_t end = buf.seq - row.conversion->remaining;
+            for (size_t s = t + 1; s < end; ++s)
+                buf.resets[base + s] = 0;
+            std::fill(buf.gameids + o, buf.gameids + base + end, row.gameid);
+            if (end == buf.seq)
+                return;
+
+            /* There's still space in the buffers; load the next ttyrec. */
+            t = end;
+            o = base + t;
+            n = buf.seq - t;
+            if (load_next(i)) {
+                if (row.part == 0)
+                    buf.resets[o] = 1;
+            } else {
+                std::memset(buf.chars + o * frame, 0, n * frame);
+                std::memset(buf.colors + o * frame, 0, n * frame);
+                std::memset(buf.cursors + 2 * o, 0,
+                            2 * n * sizeof(*buf.cursors));
+                std::memset(buf.timestamps + o, 0,
+                            n * sizeof(*buf.timestamps));
+                std::memset(buf.inputs + o, 0, n);
+                std::memset(buf.scores + o, 0, n * sizeof(*buf.scores));
+                std::memset(buf.resets + o, 0, n);
+                std::memset(buf.gameids + o, 0, n * sizeof(*buf.gameids));
+                return;
+            }
+        }
+    }
+
+    const size_t rows_;
+    const size_t cols_;
+    const size_t ttyrec_version_;
+    const size_t batch_size_;
+    const size_t term_rows_;
+    const size_t term_cols_;
+
+    std::vector<Row> rows_state_;
+    GameList games_;
+    bool loop_forever_ = false;
+};
+
+/* Fills whole minibatches natively, the rows converted in parallel on a
+ * thread pool and new games taken from a shared queue, in the order rows
+ * run out. */
+class BatchConverter : public BatchRows
+{
+  public:
+    BatchConverter(size_t rows, size_t cols, size_t ttyrec_version,
+                   size_t batch_size, size_t num_threads, size_t term_rows,
+                   size_t term_cols)
+        : BatchRows(rows, cols, ttyrec_version, batch_size, term_rows,
+                    term_cols),
+          pool_(num_threads ? num_threads : 1)
+    {
+    }
+
+    /* Sets the queue of games, as (gameid, [paths of part 0, 1, ...]). The
+     * next convert() starts all rows on new games. */
+    void
+    set_games(Games games, bool loop_forever)
+    {
+        set_game_list(GameList(std::move(games)), loop_forever);
+    }
+
+    /* Like set_games, for the given games of a GameIndex. */
+    void
+    set_indexed_games(std::shared_ptr<const GameIndex> index,
+                      std::vector<int64_t> gameids, std::string root,
+                      bool loop_forever)
+    {
+        set_game_list(GameList(index, gameids, std::move(root)),
+                      loop_forever);
+    }
+
+    void
+    set_game_list(GameList games, bool loop_forever)
+    {
+        games_ = std::move(games);
+        loop_forever_ = loop_forever;
+        next_game_ = 0;
+        needs_load_ = true;
+        for (Row &row : rows_state_) {
+            row.game = -1;
+            row.gameid = 0;
+            row.part = 0;
+        }
+    }
+
+    /* Fills the arrays, all of shape [batch_size, seq, ...]. Returns false
+     * once the last frames of every row are padding, i.e. the queue of
+     * games is exhausted. */
+    bool
+    convert(py::object chars, py::object colors, py::object cursors,
+            py::object timestamps, py::object inputs, py::object scores,
+            py::object resets, py::object gameids)
+    {
+        Buffers buf = checked_buffers(chars, colors, cursors, timestamps,
+                                      inputs, scores, resets, gameids);
+        size_t b = batch_size_, seq = buf.seq;
+
+        std::vector<std::exception_ptr> errors(b);
+        {
+            py::gil_scoped_release release;
+
+            if (needs_load_) {
+                for (size_t i = 0; i < b; ++i)
+                    if (!load_next(i))
+                        throw std::runtime_error(
+                            "Not enough ttyrecs to fill a batch!");
+                needs_load_ = false;
+            }
+
+            std::function<void(size_t)> fn = [&](size_t i) {
+                try {
+                    convert_row(i, buf);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            };
+            pool_.run(b, fn);
+        }
+        for (std::exception_ptr &error : errors)
+            if (error)
+                std::rethrow_exception(error);
+
+        for (size_t i = 0; i < b; ++i)
+            if (buf.gameids[i * seq + seq - 1] != 0)
+                return true;
+        return false;
+    }
+
+  private:
+    ssize_t
+    next_game(size_t) override
+    {
+        size_t i = next_game_++;
+        if (!loop_forever_ && i >= games_.size())
+            return -1;
+        return i % games_.size();
+    }
+
+    bool needs_load_ = true;
+    std::atomic<size_t> next_game_{ 0 };
+    ThreadPool pool_;
+};
+
+/* Converts minibatches ahead of the consumer into a ring of preallocated
+ * slots. Each batch row is filled by whichever of the producer threads is
+ * free, as far as num_slots - 1 minibatches ahead of the one handed out.
+ *
+ * To keep the output deterministic regardless of thread timing, row i
+ * takes games i, i + batch_size, i + 2 * batch_size, ... of the (seeded,
+ * shuffled) list rather than the next game of a shared queue. */
+class MinibatchPipeline : public BatchRows
+{
+  public:
+    MinibatchPipeline(size_t rows, size_t cols, size_t ttyrec_version,
+                      std::vector<py::tuple> slots, Games games,
+                      bool loop_forever, py::object seed, size_t num_threads,
+                      size_t term_rows, size_t term_cols,
+                      std::shared_ptr<const GameIndex> index,
+                      std::vector<int64_t> gameids, std::string root)
+        : BatchRows(rows, cols, ttyrec_version,
+                    slots.empty() ? 0 : checked_batch_size(slots[0]),
+                    term_rows, term_cols),
+          filled_(slots.size()), more_(slots.size()),
+          row_games_(batch_size_), next_batch_(batch_size_),
+          busy_(batch_size_)
+    {
+        if (slots.size() < 2)
+            throw std::invalid_argument("At least two slots required");
+        for (py::tuple &slot : slots) {
+            if (slot.size() != 8)
+                throw std::invalid_argument(
+                    "Slots must be (chars, colors, cursors, timestamps, "
+                    "inputs, scores, resets, gameids)");
+            buffers_.push_back(checked_buffers(slot[0], slot[1], slot[2],
+                                               slot[3], slot[4], slot[5],
+                                               slot[6], slot[7]));
+            if (buffers_.back().seq != buffers_[0].seq)
+                throw std::invalid_argument("Slots differ in seq_length");
+        }
+        slots_ = std::move(slots);
+
+        /* Games from the index if given, else the list. */
+        if (index)
+            games_ = GameList(index, gameids, std::move(root));
+        else
+            games_ = GameList(std::move(games));
+        loop_forever_ = loop_forever;
+        if (games_.size() == 0
+            || (!loop_forever_ && games_.size() < batch_size_))
+            throw std::runtime_error("Not enough ttyrecs to fill a batch!");
+        if (!seed.is_none())
+            games_.shuffle(seed.cast<uint64_t>());
+
+        for (size_t i = 0; i < (num_threads ? num_threads : 1); ++i)
+            threads_.emplace_back(&MinibatchPipeline::produce, this);
+    }
+
+    ~MinibatchPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        producer_cv_.notify_all();
+        py::gil_scoped_release release;
+        for (std::thread &thread : threads_)
+            thread.join();
+    }
+
+    /* Recycles the slot handed out last and returns the index of the slot
+     * holding the next minibatch, or -1 after the last one (whose last
+     * frames are all padding). */
+    ssize_t
+    next()
+    {
+        py::gil_scoped_release release;
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (handed_ > 0) {
+            size_t slot = (handed_ - 1) % slots_.size();
+            filled_[slot] = 0;
+            more_[slot] = false;
+            released_ = handed_;
+            producer_cv_.notify_all();
+        }
+        if (handed_ > last_batch_)
+            return -1;
+
+        size_t slot = handed_ % slots_.size();
+        consumer_cv_.wait(lock, [&] {
+            return error_ || filled_[slot] == batch_size_;
+        });
+        if (error_)
+            std::rethrow_exception(error_);
+        ++handed_;
+        return slot;
+    }
+
+    size_t
+    num_slots() const
+    {
+        return slots_.size();
+    }
+
+  private:
+    static size_t
+    checked_batch_size(py::tuple &slot)
+    {
+        if (slot.size() == 0 || !py::isinstance<py::array>(slot[0]))
+            throw std::invalid_argument("Numpy array required");
+        return py::array::ensure(slot[0]).shape(0);
+    }
+
+    ssize_t
+    next_game(size_t i) override
+    {
+        size_t game = i + row_games_[i]++ * batch_size_;
+        if (!loop_forever_ && game >= games_.size())
+            return -1;
+        return game % games_.size();
+    }
+
+    /* A row that may be filled: its next minibatch is in a free slot and
+     * not past the last one. */
+    ssize_t
+    ready_row()
+    {
+        size_t limit = std::min(released_ + slots_.size(),
+                                last_batch_ == SIZE_MAX ? SIZE_MAX
+                                                        : last_batch_ + 1);
+        for (size_t k = 0; k < batch_size_; ++k) {
+            size_t i = (cursor_ + k) % batch_size_;
+            if (!busy_[i] && next_batch_[i] < limit) {
+                cursor_ = i + 1;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void
+    produce()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            ssize_t i;
+            producer_cv_.wait(lock, [&] {
+                return stop_ || error_ || (i = ready_row()) >= 0;
+            });
+            if (stop_ || error_)
+                return;
+
+            size_t batch = next_batch_[i];
+            size_t slot = batch % slots_.size();
+            const Buffers &buf = buffers_[slot];
+            busy_[i] = true;
+            lock.unlock();
+            try {
+                if (rows_state_[i].game < 0)
+                    load_next(i);
+                convert_row(i, buf);
+            } catch (...) {
+                lock.lock();
+                error_ = std::current_exception();
+                consumer_cv_.notify_all();
+                producer_cv_.notify_all();
+                return;
+            }
+            lock.lock();
+            busy_[i] = false;
+            ++next_batch_[i];
+            if (buf.gameids[i * buf.seq + buf.seq - 1] != 0)
+                more_[slot] = true;
+            /* Rows fill minibatches in order, so this one completes before
+             * the next. */
+            if (++filled_[slot] == batch_size_) {
+                if (!more_[slot] && last_batch_ == SIZE_MAX)
+                    last_batch_ = batch;
+                consumer_cv_.notify_all();
+            }
+        }
+    }
+
+    std::vector<py::tuple> slots_; /* Keep the arrays alive. */
+    std::vector<Buffers> buffers_;
+
+    std::mutex mutex_;
+    std::condition_variable producer_cv_;
+    std::condition_variable consumer_cv_;
+    std::vector<size_t> filled_; /* Rows done, per slot. */
+    std::vector<char> more_;     /* Any row with frames at the end. */
+    std::vector<size_t> row_games_; /* Games started, per row. */
+    std::vector<size_t> next_batch_;
+    std::vector<char> busy_;
+    size_t cursor_ = 0;
+    size_t handed_ = 0;   /* Minibatches handed out. */
+    size_t released_ = 0; /* Minibatches whose slots are free again. */
+    size_t last_batch_ = SIZE_MAX;
+    std::exception_ptr error_;
+    bool stop_ = false;
+    std::vector<std::thread> threads_;
+};
+
+/* Memory-mapped reader of the columnar observation recordings written by
+ * Nethack.record_observations, cf. nlecolumns.h. */
+class ObservationColumns
+{
+  public:
+    ObservationColumns(const std::string &filename) : filename_(filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename.c_str());
+            throw py::error_already_set();
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size_ = st.st_size;
+            data_ = static_cast<const char *>(
+                mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0));
+        }
+        ::close(fd);
+        if (!data_ || data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::runtime_error("Could not map '" + filename + "'");
+        }
+        try {
+            parse();
+        } catch (...) {
+            munmap(const_cast<char *>(data_), size_);
+            throw;
+        }
+    }
+
+    ~ObservationColumns()
+    {
+        munmap(const_cast<char *>(data_), size_);
+    }
+
+    std::vector<std::string>
+    keys() const
+    {
+        std::vector<std::string> result;
+        for (const Column &column : columns_)
+            result.push_back(column.name);
+        return result;
+    }
+
+    size_t
+    num_frames() const
+    {
+        return chunk_starts_.back();
+    }
+
+    size_t
+    num_chunks() const
+    {
+        return chunks_.size();
+    }
+
+    /* Frames [start, stop) of one column, as a new array. */
+    py::array
+    read(const std::string &key, size_t start, py::object pystop)
+    {
+        size_t stop = pystop.is_none() ? num_frames()
+                                        : pystop.cast<size_t>();
+        stop = std::min(stop, num_frames());
+        start = std::min(start, stop);
+
+        size_t k = column_index(key);
+        Column &column = columns_[k];
+        std::vector<ssize_t> shape = { (ssize_t) (stop - start) };
+        shape.insert(shape.end(), column.shape.begin(), column.shape.end());
+        py::array result(py::dtype(column.dtype), shape);
+        char *out = static_cast<char *>(result.mutable_data());
+
+        py::gil_scoped_release gil;
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        size_t c = std::upper_bound(chunk_starts_.begin(),
+                                    chunk_starts_.end(), start)
+                   - chunk_starts_.begin() - 1;
+        for (size_t t = start; t < stop; ++c) {
+            const char *frames = decompress(k, c);
+            size_t first = t - chunk_starts_[c];
+            size_t n = std::min(stop, chunk_starts_[c + 1]) - t;
+            std::memcpy(out, frames + first * column.frame_size,
+                        n * column.frame_size);
+            out += n * column.frame_size;
+            t += n;
+        }
+        return result;
+    }
+
+  private:
+    struct Column {
+        std::string name;
+        std::string dtype;
+        std::vector<ssize_t> shape;
+        size_t frame_size;
+
+        /* Last decompressed chunk, for sequential reads. */
+        size_t cached_chunk = (size_t) -1;
+        std::vector<char> cache;
+    };
+
+    struct ChunkEntry {
+        size_t offset;
+        size_t size;
+    };
+
+    /* Bounds-checked cursor into the mapping. */
+    struct Cursor {
+        const ObservationColumns &file;
+        size_t pos;
+
+        const char *
+        take(size_t n)
+        {
+            if (pos > file.size_ || n > file.size_ - pos)
+                throw std::runtime_error("Truncated observation file: '"
+                                         + file.filename_ + "'");
+            const char *p = file.data_ + pos;
+            pos += n;
+            return p;
+        }
+
+        template <typename T>
+        T
+        get()
+        {
+            T value;
+            std::memcpy(&value, take(sizeof(value)), sizeof(value));
+            return value;
+        }
+
+        std::string
+        get_string()
+        {
+            size_t len = get<uint8_t>();
+            return std::string(take(len), len);
+        }
+    };
+
+    void
+    parse()
+    {
+        std::string bad = "Not an NLE observation file: '" + filename_ + "'";
+        if (size_ < NLE_COLUMNS_TRAILER_SIZE)
+            throw std::runtime_error(bad);
+
+        Cursor header{ *this, 0 };
+        if (std::memcmp(header.take(NLE_COLUMNS_MAGIC_SIZE),
+                        NLE_COLUMNS_MAGIC, NLE_COLUMNS_MAGIC_SIZE))
+            throw std::runtime_error(bad);
+        if (header.get<uint32_t>() > NLE_COLUMNS_VERSION)
+            throw std::runtime_error("Unsupported observation file: '"
+                                     + filename_ + "'");
+        header.get<uint32_t>(); /* chunk_frames */
+        uint32_t num_columns = header.get<uint32_t>();
+        for (uint32_t k = 0; k < num_columns; ++k) {
+            Column column;
+            column.name = header.get_string();
+            column.dtype = header.get_string();
+            column.frame_size = py::dtype(column.dtype).itemsize();
+            size_t ndim = header.get<uint8_t>();
+            for (size_t d = 0; d < ndim; ++d) {
+                column.shape.push_back(header.get<uint32_t>());
+                column.frame_size *= column.shape.back();
+            }
+            columns_.push_back(std::move(column));
+        }
+
+        Cursor trailer{ *this, size_ - NLE_COLUMNS_TRAILER_SIZE };
+        uint64_t index_offset = trailer.get<uint64_t>();
+        uint64_t num_chunks = trailer.get<uint64_t>();
+        if (std::memcmp(trailer.take(NLE_COLUMNS_MAGIC_SIZE),
+                        NLE_COLUMNS_MAGIC, NLE_COLUMNS_MAGIC_SIZE))
+            throw std::runtime_error("Incomplete observation file (not "
+                                     "closed?): '"
+                                     + filename_ + "'");
+
+        Cursor index{ *this, index_offset };
+        chunk_starts_.push_back(0);
+        for (uint64_t c = 0; c < num_chunks; ++c) {
+            chunk_starts_.push_back(chunk_starts_.back()
+                                    + index.get<uint32_t>());
+            std::vector<ChunkEntry> entries;
+            for (uint32_t k = 0; k < num_columns; ++k) {
+                ChunkEntry entry;
+                entry.offset = index.get<uint64_t>();
+                entry.size = index.get<uint64_t>();
+                Cursor{ *this, entry.offset }.take(entry.size);
+                entries.push_back(entry);
+            }
+            chunks_.push_back(std::move(entries));
+        }
+    }
+
+    size_t
+    column_index(const std::string &key) const
+    {
+        for (size_t k = 0; k < columns_.size(); ++k)
+            if (columns_[k].name == key)
+                return k;
+        throw py::key_error(key);
+    }
+
+    const char *
+    decompress(size_t k, size_t c)
+    {
+        Column &column = columns_[k];
+        if (column.cached_chunk == c)
+            return column.cache.data();
+
+        const ChunkEntry &entry = chunks_[c][k];
+        unsigned int size =
+            (chunk_starts_[c + 1] - chunk_starts_[c]) * column.frame_size;
+        column.cache.resize(size);
+        column.cached_chunk = (size_t) -1;
+        if (BZ2_bzBuffToBuffDecompress(
+                column.cache.data(), &size,
+                const_cast<char *>(data_ + entry.offset), entry.size, 0, 0)
+                != BZ_OK
+            || size != column.cache.size())
+            throw std::runtime_error("Corrupt chunk in '" + filename_ + "'");
+        column.cached_chunk = c;
+        return column.cache.data();
+    }
+
+    std::string filename_;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<Column> columns_;
+    std::vector<size_t> chunk_starts_;
+    std::vector<std::vector<ChunkEntry>> chunks_;
+    std::mutex mutex_;
+};
+
+/* The columns of a frame cache, in the order of its shard files. With
+ * delta encoding, tty_chars and tty_colors are replaced by the encoded
+ * frames and the offset of each frame in them. */
+static const char *const frame_cache_columns[] = {
+    "tty_chars", "tty_colors", "tty_cursor", "timestamps", "keypresses",
+    "scores",
+};
+static const char *const frame_cache_delta_columns[] = {
+    "frames", "frame_offsets", "tty_cursor", "timestamps", "keypresses",
+    "scores",
+};
+
+/* Decodes whole games into the shard files of a frame cache, cf.
+ * nle/dataset/framecache.py. Thread w appends its games to the files
+ * "<column>.<w>" in directory. Returns (gameid, shard, start frame, number
+ * of frames) per game, in order. Each game starts from a fresh terminal;
+ * the parts of a multi-part game share one. If keyframe_interval is
+ * positive, frames are delta encoded (see framedelta.h) with a keyframe at
+ * the start of each game and then every keyframe_interval frames. */
+py::list
+compile_frame_cache(
+    std::string directory,
+    std::vector<std::pair<int32_t, std::vector<std::string>>> games,
+    size_t rows, size_t cols, size_t ttyrec_version, size_t num_threads,
+    size_t keyframe_interval)
+{
+    if (keyframe_interval && rows * cols > FRAMEDELTA_MAX_CELLS)
+        throw std::invalid_argument("Frames too large to delta encode");
+
+    struct Entry {
+        size_t shard = 0, start = 0, length = 0;
+    };
+    std::vector<Entry> entries(games.size());
+    std::vector<std::exception_ptr> errors(games.size());
+    num_threads = std::max<size_t>(1, std::min(num_threads, games.size()));
+
+    {
+        py::gil_scoped_release release;
+        std::atomic<size_t> next(0);
+        auto work = [&](size_t shard) {
+            const size_t chunk = 1024, frame = rows * cols;
+            std::vector<uint8_t> chars(chunk * frame);
+            std::vector<int8_t> colors(chunk * frame);
+            std::vector<int16_t> cursors(chunk * 2);
+            std::vector<int64_t> timestamps(chunk);
+            std::vector<uint8_t> inputs(chunk);
+            std::vector<int32_t> scores(chunk);
+
+            /* For delta encoding. */
+            std::vector<uint8_t> encoded(chunk * framedelta_bound(frame));
+            std::vector<uint64_t> offsets(chunk);
+            std::vector<uint8_t> prev_chars(frame);
+            std::vector<int8_t> prev_colors(frame);
+            uint64_t encoded_size = 0;
+            size_t game_frames = 0;
+
+            std::vector<FILE *> files;
+            for (const char *column : keyframe_interval
+                                          ? frame_cache_delta_columns
+                                          : frame_cache_columns) {
+                std::string filename =
+                    directory + "/" + column + "." + std::to_string(shard);
+                FILE *f = fopen(filename.c_str(), "wb");
+                if (!f) {
+                    for (FILE *g : files)
+                        fclose(g);
+                    throw std::runtime_error("Could not create '" + filename
+                                             + "': " + std::strerror(errno));
+                }
+                files.push_back(f);
+            }
+            auto encode = [&](size_t n) {
+                size_t len = 0;
+                for (size_t t = 0; t < n; ++t, ++game_frames) {
+                    const uint8_t *c = chars.data() + t * frame;
+                    const int8_t *o = colors.data() + t * frame;
+                    const uint8_t *pc = t ? c - frame : prev_chars.data();
+                    const int8_t *po = t ? o - frame : prev_colors.data();
+                    bool key = game_frames % keyframe_interval == 0;
+                    offsets[t] = encoded_size + len;
+                    len += framedelta_encode(
+                        c, reinterpret_cast<const signed char *>(o),
+                        key ? nullptr : pc,
+                        key ? nullptr
+                            : reinterpret_cast<const signed char *>(po),
+                        frame, encoded.data() + len);
+                }
+                if (n) {
+                    std::memcpy(prev_chars.data(),
+                                chars.data() + (n - 1) * frame, frame);
+                    std::memcpy(prev_colors.data(),
+                                colors.data() + (n - 1) * frame, frame);
+                }
+                encoded_size += len;
+                return len;
+            };
+            auto write = [&](size_t n) {
+                const void *data[] = { chars.data(),      colors.data(),
+                                       cursors.data(),    timestamps.data(),
+                                       inputs.data(),     scores.data() };
+                size_t sizes[] = { frame, frame, 4, 8, 1, 4 };
+                size_t counts[] = { n, n, n, n, n, n };
+                if (keyframe_interval) {
+                    data[0] = encoded.data();
+                    sizes[0] = 1;
+                    counts[0] = encode(n);
+                    data[1] = offsets.data();
+                    sizes[1] = sizeof(uint64_t);
+                }
+                for (size_t k = 0; k < files.size(); ++k)
+                    if (fwrite(data[k], sizes[k], counts[k], files[k])
+                        != counts[k])
+                        throw std::runtime_error("Error writing frame cache");
+            };
+
+            size_t written = 0;
+            for (size_t i = next++; i < games.size(); i = next++) {
+                try {
+                    /* Declared first, so it's closed after c. */
+                    std::unique_ptr<FILE, int (*)(FILE *)> ttyrec(nullptr,
+                                                                  fclose);
+                    Conversion *c = conversion_create(rows, cols, 0, 0,
+                                                      ttyrec_version);
+                    if (c == nullptr)
+                        throw std::bad_alloc();
+                    std::unique_ptr<Conversion, int (*)(Conversion *)> guard(
+                        c, conversion_close);
+                    entries[i].shard = shard;
+                    entries[i].start = written;
+                    game_frames = 0;
+                    for (const std::string &path : games[i].second) {
+                        FILE *f = fopen(path.c_str(), "r");
+                        if (!f)
+                            throw std::runtime_error(
+                                "Could not open '" + path
+                                + "': " + std::strerror(errno));
+                        int loaded = conversion_load_ttyrec(c, f);
+                        ttyrec.reset(f);
+                        if (loaded != 0)
+                            throw std::runtime_error("File failed to load: '"
+                                                     + path + "'");
+                        for (;;) {
+                            conversion_set_buffers(
+                                c, chars.data(), chars.size(),
+                                reinterpret_cast<signed char *>(
+                                    colors.data()),
+                                colors.size(), cursors.data(), chunk * 2,
+                                timestamps.data(), chunk, inputs.data(),
+                                chunk, scores.data(), chunk);
+                            int status = conversion_convert_frames(c);
+                            if (status == CONV_CRITICAL_ERROR)
+                                throw std::runtime_error("Error in file.");
+                            size_t n = chunk - c->remaining;
+                            write(n);
+                            written += n;
+                            if (c->remaining)
+                                break; /* End of this part. */
+                        }
+                    }
+                    entries[i].length = written - entries[i].start;
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+            for (FILE *f : files)
+                if (fclose(f))
+                    throw std::runtime_error("Error writing frame cache");
+        };
+
+        std::vector<std::thread> threads;
+        std::vector<std::exception_ptr> thread_errors(num_threads);
+        for (size_t w = 0; w < num_threads; ++w)
+            threads.emplace_back([&, w]() {
+                try {
+                    work(w);
+                } catch (...) {
+                    thread_errors[w] = std::current_exception();
+                }
+            });
+        for (std::thread &thread : threads)
+            thread.join();
+        for (std::exception_ptr &error : thread_errors)
+            if (error)
+                std::rethrow_exception(error);
+    }
+    for (std::exception_ptr &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    py::list result;
+    for (size_t i = 0; i < games.size(); ++i)
+        result.append(py::make_tuple(games[i].first, entries[i].shard,
+                                     entries[i].start, entries[i].length));
+    return result;
+}
+
+/* Delta encodes frames [T, rows, cols], see framedelta.h. Returns the
+ * encoded frames and the offset of each frame in them. */
+py::tuple
+encode_frames(py::object chars, py::object colors, size_t keyframe_interval)
+{
+    if (!py::isinstance<py::array>(chars))
+        throw std::invalid_argument("Numpy array required");
+    py::array array = py::array::ensure(chars);
+    if (array.ndim() != 3)
+        throw std::invalid_argument("chars must be [T, rows, cols]");
+    size_t n = array.shape(0), frame = array.shape(1) * array.shape(2);
+    if (frame > FRAMEDELTA_MAX_CELLS)
+        throw std::invalid_argument("Frames too large to delta encode");
+    if (!keyframe_interval)
+        throw std::invalid_argument("keyframe_interval must be positive");
+
+    const uint8_t *c = checked_conversion<uint8_t>(
+        chars, { n, (size_t)array.shape(1), (size_t)array.shape(2) });
+    const int8_t *o = checked_conversion<int8_t>(
+        colors, { n, (size_t)array.shape(1), (size_t)array.shape(2) });
+
+    std::vector<unsigned char> data(n * framedelta_bound(frame));
+    py::array_t<uint64_t> offsets(n);
+    uint64_t *off = offsets.mutable_data();
+    size_t size = 0;
+    {
+        py::gil_scoped_release release;
+        for (size_t t = 0; t < n; ++t) {
+            bool key = t % keyframe_interval == 0;
+            off[t] = size;
+            size += framedelta_encode(
+                c + t * frame,
+                reinterpret_cast<const signed char *>(o + t * frame),
+                key ? nullptr : c + (t - 1) * frame,
+                key ? nullptr
+                    : reinterpret_cast<const signed char *>(o
+                                                            + (t - 1) * frame),
+                frame, data.data() + size);
+        }
+    }
+    py::array_t<uint8_t> result(size);
+    std::memcpy(result.mutable_data(), data.data(), size);
+    return py::make_tuple(result, offsets);
+}
+
+/* Decodes frames [start, start + T) of encode_frames' output into chars and
+ * colors, both [T, rows, cols]. */
+void
+decode_frames(py::object data, py::object offsets, size_t start,
+              py::object chars, py::object colors)
+{
+    if (!py::isinstance<py::array>(data)
+        || !py::isinstance<py::array>(offsets)
+        || !py::isinstance<py::array>(chars))
+        throw std::invalid_argument("Numpy array required");
+    py::array data_array = py::array::ensure(data);
+    py::array offsets_array = py::array::ensure(offsets);
+    py::array array = py::array::ensure(chars);
+    if (array.ndim() != 3)
+        throw std::invalid_argument("chars must be [T, rows, cols]");
+    size_t n = array.shape(0), frame = array.shape(1) * array.shape(2);
+    size_t num_frames = offsets_array.size();
+    if (start + n > num_frames)
+        throw std::out_of_range("Not enough frames");
+
+    size_t size = data_array.size();
+    const uint8_t *d = checked_conversion<uint8_t>(data, { size });
+    const uint64_t *off =
+        checked_conversion<uint64_t>(offsets, { num_frames });
+    uint8_t *c = checked_conversion<uint8_t>(
+        chars, { n, (size_t)array.shape(1), (size_t)array.shape(2) });
+    int8_t *o = checked_conversion<int8_t>(
+        colors, { n, (size_t)array.shape(1), (size_t)array.shape(2) });
+
+    int status;
+    {
+        py::gil_scoped_release release;
+        status = framedelta_decode(d, size, off, start, n, frame, c,
+                                   reinterpret_cast<signed char *>(o));
+    }
+    if (status != 0)
+        throw std::invalid_argument(
+            "Corrupt frame data: offsets outside of data or no keyframe");
+}
+
+/* Header-only statistics of ttyrecs, see conversion_scan_ttyrec. Returns a
+ * dict per file, in order. */
+py::list
+scan_ttyrecs(std::vector<std::string> filenames, size_t ttyrec_version,
+             size_t num_threads)
+{
+    std::vector<TtyrecStats> stats(filenames.size());
+    std::vector<std::exception_ptr> errors(filenames.size());
+    {
+        py::gil_scoped_release release;
+        ThreadPool pool(std::max<size_t>(
+            1, std::min(num_threads, filenames.size())));
+        std::function<void(size_t)> fn = [&](size_t i) {
+            try {
+                const std::string &filename = filenames[i];
+                FILE *f = fopen(filename.c_str(), "r");
+                if (f == nullptr)
+                    throw std::runtime_error("Could not open '" + filename
+                                             + "': " + std::strerror(errno));
+                int status = conversion_scan_ttyrec(f, ttyrec_version, 1,
+                                                    &stats[i]);
+                fclose(f);
+                if (status == CONV_CRITICAL_ERROR)
+                    throw std::runtime_error("File failed to load: '"
+                                             + filename + "'");
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        };
+        pool.run(filenames.size(), fn);
+    }
+    for (std::exception_ptr &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    py::list result;
+    for (const TtyrecStats &s : stats) {
+        py::dict records;
+        for (size_t channel = 0; channel < 256; ++channel)
+            if (s.records[channel])
+                records[py::int_(channel)] = s.records[channel];
+        py::dict d;
+        d["frames"] = s.frames;
+        d["records"] = records;
+        d["first_timestamp"] = s.first_timestamp;
+        d["last_timestamp"] = s.last_timestamp;
+        d["size"] = s.size;
+        result.append(d);
+    }
+    return result;
+}
+
 PYBIND11_MODULE(_pyconverter, m)
 {
     m.doc() = "Ttyrec Converter";
 
     py::class_<Converter>(m, "Converter")
-        .def(py::init<size_t, size_t, size_t, size_t, size_t>(),
+        .def(py::init<size_t, size_t, size_t, size_t, size_t, int>(),
              py::arg("rows"), py::arg("cols"), py::arg("ttyrec_version"), py::arg("term_rows") = 0,
-             py::arg("term_cols") = 0)
+             py::arg("term_cols") = 0, py::arg("threads") = 1)
         .def("load_ttyrec", &Converter::load_ttyrec, py::arg("filename"),
-             py::arg("gameid") = 0, py::arg("part") = 0)
+             py::arg("gameid") = 0, py::arg("part") = 0,
+             py::arg("start_frame") = 0, py::arg("index_interval") = 1024)
+        .def("index_ttyrec", &Converter::index_ttyrec, py::arg("filename"),
+             py::arg("interval") = 1024)
+        .def("load_ttyrec_buffer", &Converter::load_ttyrec_buffer,
+             py::arg("buffer"), py::arg("gameid") = 0, py::arg("part") = 0,
+             py::arg("name") = "<buffer>")
+        .def("load_ttyrec_zip", &Converter::load_ttyrec_zip,
+             py::arg("archive"), py::arg("member"), py::arg("gameid") = 0,
+             py::arg("part") = 0)
         .def("convert", &Converter::convert, py::arg("chars"),
              py::arg("colors"), py::arg("cursors"), py::arg("timestamps"),
              py::arg("inputs"), py::arg("scores"))
@@ -207,4 +1861,84 @@ PYBIND11_MODULE(_pyconverter, m)
         .def_property_readonly("filename", &Converter::filename)
         .def_property_readonly("part", &Converter::part)
         .def_property_readonly("gameid", &Converter::gameid);
-}
\ No newline at end of file
+
+    py::class_<ZipFile>(m, "ZipFile")
+        .def(py::init<std::string>(), py::arg("filename"))
+        .def("names", &ZipFile::names)
+        .def("__contains__", &ZipFile::contains)
+        .def("__len__", &ZipFile::size)
+        .def_readonly("filename", &ZipFile::filename_);
+
+    py::class_<GameIndex, std::shared_ptr<GameIndex>>(m, "GameIndex")
+        .def(py::init<std::string>(), py::arg("filename"))
+        .def("__len__", &GameIndex::size)
+        .def("__contains__", &GameIndex::contains)
+        .def("get_paths", &GameIndex::get_paths, py::arg("gameid"))
+        .def("columns", &GameIndex::columns)
+        .def("gameids",
+             [](py::object self) {
+                 return self.cast<const GameIndex &>().gameids_array(self);
+             })
+        .def(
+            "column",
+            [](py::object self, const std::string &name) {
+                return self.cast<const GameIndex &>().column_array(self,
+                                                                   name);
+            },
+            py::arg("name"))
+        .def_readonly("filename", &GameIndex::filename_)
+        .def_readonly("ttyrec_version", &GameIndex::ttyrec_version_);
+
+    py::class_<BatchConverter>(m, "BatchConverter")
+        .def(py::init<size_t, size_t, size_t, size_t, size_t, size_t,
+                      size_t>(),
+             py::arg("rows"), py::arg("cols"), py::arg("ttyrec_version"),
+             py::arg("batch_size"), py::arg("num_threads") = 1,
+             py::arg("term_rows") = 0, py::arg("term_cols") = 0)
+        .def("set_games", &BatchConverter::set_games, py::arg("games"),
+             py::arg("loop_forever") = false)
+        .def("set_indexed_games", &BatchConverter::set_indexed_games,
+             py::arg("index"), py::arg("gameids"), py::arg("root"),
+             py::arg("loop_forever") = false)
+        .def("convert", &BatchConverter::convert, py::arg("chars"),
+             py::arg("colors"), py::arg("cursors"), py::arg("timestamps"),
+             py::arg("inputs"), py::arg("scores"), py::arg("resets"),
+             py::arg("gameids"));
+
+    py::class_<MinibatchPipeline>(m, "MinibatchPipeline")
+        .def(py::init<size_t, size_t, size_t, std::vector<py::tuple>,
+                      BatchRows::Games, bool, py::object, size_t, size_t,
+                      size_t, std::shared_ptr<const GameIndex>,
+                      std::vector<int64_t>, std::string>(),
+             py::arg("rows"), py::arg("cols"), py::arg("ttyrec_version"),
+             py::arg("slots"), py::arg("games"),
+             py::arg("loop_forever") = false, py::arg("seed") = py::none(),
+             py::arg("num_threads") = 1, py::arg("term_rows") = 0,
+             py::arg("term_cols") = 0, py::arg("index") = nullptr,
+             py::arg("gameids") = std::vector<int64_t>(),
+             py::arg("root") = "")
+        .def("next", &MinibatchPipeline::next)
+        .def_property_readonly("num_slots", &MinibatchPipeline::num_slots);
+
+    py::class_<ObservationColumns>(m, "ObservationColumns")
+        .def(py::init<std::string>(), py::arg("filename"))
+        .def("keys", &ObservationColumns::keys)
+        .def("read", &ObservationColumns::read, py::arg("key"),
+             py::arg("start") = 0, py::arg("stop") = py::none())
+        .def("__len__", &ObservationColumns::num_frames)
+        .def_property_readonly("num_frames", &ObservationColumns::num_frames)
+        .def_property_readonly("num_chunks", &ObservationColumns::num_chunks);
+
+    m.def("scan_ttyrecs", &scan_ttyrecs, py::arg("filenames"),
+          py::arg("ttyrec_version"), py::arg("num_threads") = 1);
+
+    m.def("compile_frame_cache", &compile_frame_cache, py::arg("directory"),
+          py::arg("games"), py::arg("rows"), py::arg("cols"),
+          py::arg("ttyrec_version"), py::arg("num_threads") = 1,
+          py::arg("keyframe_interval") = 0);
+    m.def("encode_frames", &encode_frames, py::arg("chars"),
+          py::arg("colors"), py::arg("keyframe_interval") = 128);
+    m.def("decode_frames", &decode_frames, py::arg("data"),
+          py::arg("offsets"), py::arg("start"), py::arg("chars"),
+          py::arg("colors"));
+}
@@ -11,6 +11,7 @@
 
 unsigned char gfx_dec_map[256];
 unsigned char gfx_ibm_map[256];
+unsigned char gfx_strip_map[2][256];
 
 /* clang-format off */
 static unsigned char no_graphics[MAXPCHARS] = {
@@ -357,6 +358,11 @@ void populate_gfx_arrays(void) {
     if (ibm_graphics[i]) gfx_ibm_map[ibm_graphics[i]] = no_graphics[i];
   }
 
+  for (i = 0; i < 256; i++) {
+    gfx_strip_map[0][i] = strip_gfx(i, 0);
+    gfx_strip_map[1][i] = strip_gfx(i, 1);
+  }
+
   /* Check. */
   /*
   for (i = 0; i < 255; i++)
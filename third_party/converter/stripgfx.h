@@ -4,4 +4,7 @@
 void populate_gfx_arrays(void);
 unsigned char strip_gfx(unsigned char inchar, int use_dec);
 
+/* strip_gfx(c, use_dec) is gfx_strip_map[use_dec][c], once populated. */
+extern unsigned char gfx_strip_map[2][256];
+
 #endif /* !INCLUDED_stripgfx_h */
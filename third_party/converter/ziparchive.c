@@ -0,0 +1,203 @@
+/*
+ *  Memory-mapped zip archive reader, see ziparchive.h.
+ *
+ *  The end of central directory record (and for zip64 archives, the zip64
+ *  end record it points to) gives the central directory, which lists each
+ *  member's name, sizes, compression method and local header. The data
+ *  follows the local header, whose name and extra field lengths may differ
+ *  from the central directory's.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ziparchive.h"
+
+#define EOCD_SIG 0x06054b50
+#define EOCD_SIZE 22
+#define ZIP64_LOCATOR_SIG 0x07064b50
+#define ZIP64_LOCATOR_SIZE 20
+#define ZIP64_EOCD_SIG 0x06064b50
+#define ZIP64_EOCD_SIZE 56
+#define CENTRAL_SIG 0x02014b50
+#define CENTRAL_SIZE 46
+#define LOCAL_SIG 0x04034b50
+#define LOCAL_SIZE 30
+#define ZIP64_EXTRA_ID 0x0001
+#define MAX_COMMENT 0xffff
+
+struct ZipArchive {
+  const unsigned char *data;
+  size_t size;
+  ZipMember *members;
+  size_t num_members;
+  char *names;
+};
+
+/* Zip integers are little-endian. */
+static uint64_t le(const unsigned char *p, int n) {
+  uint64_t v = 0;
+  for (int i = n - 1; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+
+static bool in_bounds(const ZipArchive *zip, uint64_t offset, uint64_t n) {
+  return offset <= zip->size && n <= zip->size - offset;
+}
+
+/* Finds the central directory's offset, size and number of entries. */
+static bool find_central(const ZipArchive *zip, uint64_t *offset,
+                         uint64_t *size, uint64_t *entries) {
+  if (zip->size < EOCD_SIZE) return false;
+  size_t lowest = zip->size > EOCD_SIZE + MAX_COMMENT
+                      ? zip->size - EOCD_SIZE - MAX_COMMENT
+                      : 0;
+  size_t eocd = zip->size - EOCD_SIZE;
+  while (le(zip->data + eocd, 4) != EOCD_SIG) {
+    if (eocd == lowest) return false;
+    --eocd;
+  }
+  const unsigned char *p = zip->data + eocd;
+  *entries = le(p + 10, 2);
+  *size = le(p + 12, 4);
+  *offset = le(p + 16, 4);
+
+  if (eocd >= ZIP64_LOCATOR_SIZE &&
+      le(p - ZIP64_LOCATOR_SIZE, 4) == ZIP64_LOCATOR_SIG) {
+    uint64_t at = le(p - ZIP64_LOCATOR_SIZE + 8, 8);
+    if (!in_bounds(zip, at, ZIP64_EOCD_SIZE) ||
+        le(zip->data + at, 4) != ZIP64_EOCD_SIG)
+      return false;
+    p = zip->data + at;
+    *entries = le(p + 32, 8);
+    *size = le(p + 40, 8);
+    *offset = le(p + 48, 8);
+  }
+  return in_bounds(zip, *offset, *size);
+}
+
+/* Reads the zip64 extra field's values for the fields that are maxed out. */
+static void read_zip64_extra(const unsigned char *p, size_t len,
+                             ZipMember *m, bool usize, bool csize,
+                             bool offset) {
+  while (len >= 4) {
+    size_t id = le(p, 2), n = le(p + 2, 2);
+    if (n > len - 4) return;
+    if (id == ZIP64_EXTRA_ID) {
+      const unsigned char *q = p + 4, *end = q + n;
+      if (usize && q + 8 <= end) m->uncompressed_size = le(q, 8), q += 8;
+      if (csize && q + 8 <= end) m->compressed_size = le(q, 8), q += 8;
+      if (offset && q + 8 <= end) m->header_offset = le(q, 8);
+      return;
+    }
+    p += 4 + n;
+    len -= 4 + n;
+  }
+}
+
+static int compare_members(const void *a, const void *b) {
+  return strcmp(((const ZipMember *)a)->name, ((const ZipMember *)b)->name);
+}
+
+static bool read_central(ZipArchive *zip) {
+  uint64_t offset, size, entries;
+  if (!find_central(zip, &offset, &size, &entries)) return false;
+  if (entries > size / CENTRAL_SIZE) return false;
+
+  zip->members = calloc(entries ? entries : 1, sizeof(ZipMember));
+  /* Names are shorter than their central directory entries. */
+  zip->names = malloc(size + 1);
+  if (!zip->members || !zip->names) return false;
+
+  const unsigned char *p = zip->data + offset, *end = p + size;
+  char *names = zip->names;
+  for (uint64_t i = 0; i < entries; ++i) {
+    if (end - p < CENTRAL_SIZE || le(p, 4) != CENTRAL_SIG) return false;
+    size_t name_len = le(p + 28, 2), extra_len = le(p + 30, 2);
+    size_t comment_len = le(p + 32, 2);
+    if ((size_t)(end - p) < CENTRAL_SIZE + name_len + extra_len + comment_len)
+      return false;
+
+    ZipMember *m = &zip->members[i];
+    m->method = le(p + 10, 2);
+    m->compressed_size = le(p + 20, 4);
+    m->uncompressed_size = le(p + 24, 4);
+    m->header_offset = le(p + 42, 4);
+    read_zip64_extra(p + CENTRAL_SIZE + name_len, extra_len, m,
+                     m->uncompressed_size == 0xffffffff,
+                     m->compressed_size == 0xffffffff,
+                     m->header_offset == 0xffffffff);
+
+    memcpy(names, p + CENTRAL_SIZE, name_len);
+    names[name_len] = '\0';
+    m->name = names;
+    names += name_len + 1;
+    p += CENTRAL_SIZE + name_len + extra_len + comment_len;
+  }
+  zip->num_members = entries;
+  qsort(zip->members, entries, sizeof(ZipMember), compare_members);
+  return true;
+}
+
+ZipArchive *ziparchive_open(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  ZipArchive *zip = calloc(1, sizeof(*zip));
+  if (!zip || fstat(fd, &st) || st.st_size == 0) goto fail;
+
+  zip->size = st.st_size;
+  void *data = mmap(NULL, zip->size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) goto fail;
+  zip->data = data;
+  close(fd);
+  fd = -1;
+
+  if (read_central(zip)) return zip;
+  ziparchive_close(zip);
+  errno = 0; /* Not a zip archive, as opposed to failing to read one. */
+  return NULL;
+
+fail:
+  if (fd >= 0) close(fd);
+  ziparchive_close(zip);
+  return NULL;
+}
+
+void ziparchive_close(ZipArchive *zip) {
+  if (!zip) return;
+  if (zip->data) munmap((void *)zip->data, zip->size);
+  free(zip->members);
+  free(zip->names);
+  free(zip);
+}
+
+size_t ziparchive_num_members(const ZipArchive *zip) {
+  return zip->num_members;
+}
+
+const ZipMember *ziparchive_member(const ZipArchive *zip, size_t i) {
+  return i < zip->num_members ? &zip->members[i] : NULL;
+}
+
+const ZipMember *ziparchive_find(const ZipArchive *zip, const char *name) {
+  ZipMember key = {0};
+  key.name = name;
+  return bsearch(&key, zip->members, zip->num_members, sizeof(ZipMember),
+                 compare_members);
+}
+
+const void *ziparchive_data(const ZipArchive *zip, const ZipMember *member) {
+  uint64_t at = member->header_offset;
+  if (!in_bounds(zip, at, LOCAL_SIZE) || le(zip->data + at, 4) != LOCAL_SIG)
+    return NULL;
+  at += LOCAL_SIZE + le(zip->data + at + 26, 2) + le(zip->data + at + 28, 2);
+  if (!in_bounds(zip, at, member->compressed_size)) return NULL;
+  return zip->data + at;
+}
@@ -0,0 +1,46 @@
+#ifndef ZIPARCHIVE_H
+#define ZIPARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * Read-only access to the members of a memory-mapped zip archive (including
+ * zip64 archives), by name, without extracting them. Only the central
+ * directory is read up front.
+ */
+
+#define ZIP_STORED 0
+#define ZIP_DEFLATED 8
+
+typedef struct ZipMember {
+  const char *name;           /* NUL-terminated. */
+  uint64_t header_offset;     /* Of the member's local header. */
+  uint64_t compressed_size;
+  uint64_t uncompressed_size;
+  int method;                 /* ZIP_STORED, ZIP_DEFLATED, ... */
+} ZipMember;
+
+typedef struct ZipArchive ZipArchive;
+
+ZipArchive *ziparchive_open(const char *path);
+void ziparchive_close(ZipArchive *zip);
+
+size_t ziparchive_num_members(const ZipArchive *zip);
+/* Members are sorted by name. */
+const ZipMember *ziparchive_member(const ZipArchive *zip, size_t i);
+const ZipMember *ziparchive_find(const ZipArchive *zip, const char *name);
+
+/* The member's compressed_size bytes of data in the mapping, or NULL if the
+ * archive is corrupt there. Stored members' data is their content. */
+const void *ziparchive_data(const ZipArchive *zip, const ZipMember *member);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZIPARCHIVE_H */
@@ -511,3 +511,44 @@ tmt_reset(TMT *vt)
     CB(vt, TMT_MSG_CURSOR, "t");
     notify(vt, true, true);
 }
+
+#define STATE_FIELDS(X) \
+    X(curs) X(oldcurs) X(attrs) X(oldattrs) X(dirty) X(acs) X(ignored) \
+    X(ms) X(nmb) X(mb) X(pars) X(npar) X(arg) X(state)
+
+size_t
+tmt_state_size(const TMT *vt)
+{
+    size_t n = 0;
+    #define SIZE(f) n += sizeof(vt->f);
+    STATE_FIELDS(SIZE)
+    #undef SIZE
+    return n + (vt->screen.nline + 1) * vt->screen.ncol * sizeof(TMTCHAR);
+}
+
+void
+tmt_save_state(const TMT *vt, void *buf)
+{
+    char *p = buf;
+    size_t row = vt->screen.ncol * sizeof(TMTCHAR);
+    #define SAVE(f) memcpy(p, &vt->f, sizeof(vt->f)); p += sizeof(vt->f);
+    STATE_FIELDS(SAVE)
+    #undef SAVE
+    for (size_t i = 0; i < vt->screen.nline; i++, p += row)
+        memcpy(p, vt->screen.lines[i]->chars, row);
+    memcpy(p, vt->tabs->chars, row);
+}
+
+void
+tmt_load_state(TMT *vt, const void *buf)
+{
+    const char *p = buf;
+    size_t row = vt->screen.ncol * sizeof(TMTCHAR);
+    #define LOAD(f) memcpy(&vt->f, p, sizeof(vt->f)); p += sizeof(vt->f);
+    STATE_FIELDS(LOAD)
+    #undef LOAD
+    for (size_t i = 0; i < vt->screen.nline; i++, p += row)
+        memcpy(vt->screen.lines[i]->chars, p, row);
+    memcpy(vt->tabs->chars, p, row);
+    dirtylines(vt, 0, vt->screen.nline);
+}
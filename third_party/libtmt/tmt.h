@@ -138,4 +138,10 @@ const TMTPOINT *tmt_cursor(const TMT *vt);
 void tmt_clean(TMT *vt);
 void tmt_reset(TMT *vt);
 
+/* Snapshots of the whole terminal state (screen, cursor, attributes and
+ * parser), for the same terminal size and build. */
+size_t tmt_state_size(const TMT *vt);
+void tmt_save_state(const TMT *vt, void *buf);
+void tmt_load_state(TMT *vt, const void *buf);
+
 #endif
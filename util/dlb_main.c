@@ -149,6 +149,24 @@ const char *filename, *mode;
     return fopen(filename, mode);
 }
 
+#ifdef DLBMMAP
+/* map_library(dlb.c) shares libraries through these in NLE; nothing here */
+genericptr_t
+nle_dlb_lookup(fd)
+int fd UNUSED;
+{
+    return (genericptr_t) 0;
+}
+
+genericptr_t
+nle_dlb_insert(fd, lib)
+int fd UNUSED;
+genericptr_t lib UNUSED;
+{
+    return (genericptr_t) 0;
+}
+#endif
+
 #endif /* DLBLIB */
 #endif /* DLB */
 
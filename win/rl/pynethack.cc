@@ -1,10 +1,30 @@
 /* Copyright (c) Facebook, Inc. and its affiliates. */
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bzlib.h>
 
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
 // "digit" is declared in both Python's longintrepr.h and NetHack's extern.h.
 #define digit nethack_digit
@@ -17,7 +37,9 @@ extern "C" {
 }
 
 extern "C" {
+#include "nlecolumns.h"
 #include "nledl.h"
+#include "nlereplay.h"
 }
 
 // Undef name clashes between NetHack and Python.
@@ -98,6 +120,323 @@ checked_conversion(py::handle h, const std::vector<ssize_t> &shape)
     return static_cast<T *>(buf.ptr);
 }
 
+/* Observation keys that can be recorded or replayed. Mirrors set_buffers. */
+struct ObservationSpec {
+    const char *name;
+    const char *dtype;
+    size_t itemsize;
+    std::vector<ssize_t> shape;
+    size_t offset; /* Of the pointer in nle_obs. */
+
+    size_t
+    size() const
+    {
+        size_t n = itemsize;
+        for (ssize_t d : shape)
+            n *= d;
+        return n;
+    }
+};
+
+static const std::vector<ObservationSpec> &
+observation_specs()
+{
+    static const std::vector<ObservationSpec> specs = {
+        { "glyphs", "int16", 2, { ROWNO, COLNO - 1 },
+          offsetof(nle_obs, glyphs) },
+        { "chars", "uint8", 1, { ROWNO, COLNO - 1 },
+          offsetof(nle_obs, chars) },
+        { "colors", "uint8", 1, { ROWNO, COLNO - 1 },
+          offsetof(nle_obs, colors) },
+        { "specials", "uint8", 1, { ROWNO, COLNO - 1 },
+          offsetof(nle_obs, specials) },
+        { "blstats", "int64", sizeof(long), { NLE_BLSTATS_SIZE },
+          offsetof(nle_obs, blstats) },
+        { "message", "uint8", 1, { NLE_MESSAGE_SIZE },
+          offsetof(nle_obs, message) },
+        { "program_state", "int32", 4, { NLE_PROGRAM_STATE_SIZE },
+          offsetof(nle_obs, program_state) },
+        { "internal", "int32", 4, { NLE_INTERNAL_SIZE },
+          offsetof(nle_obs, internal) },
+        { "inv_glyphs", "int16", 2, { NLE_INVENTORY_SIZE },
+          offsetof(nle_obs, inv_glyphs) },
+        { "inv_letters", "uint8", 1, { NLE_INVENTORY_SIZE },
+          offsetof(nle_obs, inv_letters) },
+        { "inv_oclasses", "uint8", 1, { NLE_INVENTORY_SIZE },
+          offsetof(nle_obs, inv_oclasses) },
+        { "inv_strs",
+          "uint8",
+          1,
+          { NLE_INVENTORY_SIZE, NLE_INVENTORY_STR_LENGTH },
+          offsetof(nle_obs, inv_strs) },
+        { "screen_descriptions",
+          "uint8",
+          1,
+          { ROWNO, COLNO - 1, NLE_SCREEN_DESCRIPTION_LENGTH },
+          offsetof(nle_obs, screen_descriptions) },
+        { "tty_chars", "uint8", 1, { NLE_TERM_LI, NLE_TERM_CO },
+          offsetof(nle_obs, tty_chars) },
+        { "tty_colors", "int8", 1, { NLE_TERM_LI, NLE_TERM_CO },
+          offsetof(nle_obs, tty_colors) },
+        { "tty_cursor", "uint8", 1, { 2 }, offsetof(nle_obs, tty_cursor) },
+        { "misc", "int32", 4, { NLE_MISC_SIZE }, offsetof(nle_obs, misc) },
+    };
+    return specs;
+}
+
+static const ObservationSpec *
+find_observation_spec(const std::string &key)
+{
+    for (const ObservationSpec &spec : observation_specs())
+        if (key == spec.name)
+            return &spec;
+    throw std::invalid_argument("Unknown observation '" + key + "'");
+}
+
+static const void *
+observation_buffer(const nle_obs &obs, const ObservationSpec &spec)
+{
+    return *reinterpret_cast<void *const *>(
+        reinterpret_cast<const char *>(&obs) + spec.offset);
+}
+
+/* Appends observations to a columnar recording, cf. nlecolumns.h.
+ * Frames are gathered into chunks on the stepping thread; compression and
+ * writing happen on a background thread. */
+class ObservationRecorder
+{
+  public:
+    ObservationRecorder(const std::string &filename,
+                        std::vector<const ObservationSpec *> specs,
+                        size_t chunk_frames)
+        : filename_(filename), specs_(std::move(specs)),
+          chunk_frames_(chunk_frames)
+    {
+        if (!chunk_frames_)
+            throw std::invalid_argument("chunk_frames must be positive");
+
+        for (const ObservationSpec *spec : specs_)
+            frame_sizes_.push_back(spec->size());
+        frame_sizes_.push_back(sizeof(int32_t)); /* actions */
+        frame_sizes_.push_back(sizeof(uint8_t)); /* done */
+
+        file_ = std::fopen(filename_.c_str(), "wb");
+        if (!file_) {
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename_.c_str());
+            throw py::error_already_set();
+        }
+        write_header();
+        chunk_.reset(new Chunk(frame_sizes_.size()));
+        writer_ = std::thread(&ObservationRecorder::write_chunks, this);
+    }
+
+    ~ObservationRecorder()
+    {
+        try {
+            close();
+        } catch (const std::exception &) {
+            /* Nowhere to report this to. */
+        }
+    }
+
+    void
+    append(const nle_obs &obs, int action)
+    {
+        if (!file_)
+            throw std::runtime_error("Observation recording already closed");
+
+        for (size_t k = 0; k < specs_.size(); ++k) {
+            const char *src = static_cast<const char *>(
+                observation_buffer(obs, *specs_[k]));
+            std::vector<char> &column = chunk_->columns[k];
+            if (src)
+                column.insert(column.end(), src, src + frame_sizes_[k]);
+            else
+                column.resize(column.size() + frame_sizes_[k]);
+        }
+        int32_t recorded_action = action;
+        uint8_t done = obs.done;
+        append_bytes(chunk_->columns[specs_.size()], &recorded_action,
+                     sizeof(recorded_action));
+        append_bytes(chunk_->columns[specs_.size() + 1], &done,
+                     sizeof(done));
+
+        if (++chunk_->frames == chunk_frames_)
+            submit();
+    }
+
+    /* Flushes all frames and writes the index. */
+    void
+    close()
+    {
+        if (!file_)
+            return;
+        if (chunk_->frames)
+            submit();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closing_ = true;
+        }
+        cv_.notify_all();
+        writer_.join();
+
+        std::string index;
+        for (const ChunkIndex &entry : index_) {
+            put(index, (uint32_t) entry.frames);
+            for (const auto &column : entry.columns) {
+                put(index, (uint64_t) column.first);
+                put(index, (uint64_t) column.second);
+            }
+        }
+        put(index, (uint64_t) offset_);
+        put(index, (uint64_t) index_.size());
+        index.append(NLE_COLUMNS_MAGIC, NLE_COLUMNS_MAGIC_SIZE);
+
+        if (error_.empty()
+            && std::fwrite(index.data(), 1, index.size(), file_)
+                   != index.size())
+            error_ = "Error writing observations to '" + filename_ + "'";
+        if (std::fclose(file_) && error_.empty())
+            error_ = "Error closing '" + filename_ + "'";
+        file_ = nullptr;
+        if (!error_.empty())
+            throw std::runtime_error(error_);
+    }
+
+  private:
+    struct Chunk {
+        explicit Chunk(size_t num_columns) : columns(num_columns) {}
+        size_t frames = 0;
+        std::vector<std::vector<char>> columns;
+    };
+
+    struct ChunkIndex {
+        size_t frames;
+        std::vector<std::pair<size_t, size_t>> columns; /* offset, size */
+    };
+
+    /* Chunks waiting for the writer before append() blocks. */
+    static constexpr size_t max_pending_ = 2;
+
+    template <typename T>
+    static void
+    put(std::string &out, T value)
+    {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    static void
+    append_bytes(std::vector<char> &out, const void *data, size_t size)
+    {
+        const char *p = static_cast<const char *>(data);
+        out.insert(out.end(), p, p + size);
+    }
+
+    void
+    write_header()
+    {
+        std::string header(NLE_COLUMNS_MAGIC, NLE_COLUMNS_MAGIC_SIZE);
+        put(header, (uint32_t) NLE_COLUMNS_VERSION);
+        put(header, (uint32_t) chunk_frames_);
+        put(header, (uint32_t) frame_sizes_.size());
+
+        auto put_column = [&](const std::string &name,
+                              const std::string &dtype,
+                              const std::vector<ssize_t> &shape) {
+            put(header, (uint8_t) name.size());
+            header += name;
+            put(header, (uint8_t) dtype.size());
+            header += dtype;
+            put(header, (uint8_t) shape.size());
+            for (ssize_t d : shape)
+                put(header, (uint32_t) d);
+        };
+        for (const ObservationSpec *spec : specs_)
+            put_column(spec->name, spec->dtype, spec->shape);
+        put_column("actions", "int32", {});
+        put_column("done", "uint8", {});
+
+        if (std::fwrite(header.data(), 1, header.size(), file_)
+            != header.size())
+            error_ = "Error writing observations to '" + filename_ + "'";
+        offset_ = header.size();
+    }
+
+    void
+    submit()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return queue_.size() < max_pending_; });
+            queue_.push_back(std::move(chunk_));
+        }
+        cv_.notify_all();
+        chunk_.reset(new Chunk(frame_sizes_.size()));
+    }
+
+    void
+    write_chunks()
+    {
+        std::vector<char> compressed;
+        for (;;) {
+            std::unique_ptr<Chunk> chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+                if (queue_.empty())
+                    return;
+                chunk = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            cv_.notify_all();
+            if (!error_.empty())
+                continue;
+
+            ChunkIndex entry;
+            entry.frames = chunk->frames;
+            for (std::vector<char> &column : chunk->columns) {
+                /* Worst case bzip2 output size, see bzlib docs. */
+                unsigned int size = column.size() + column.size() / 100 + 600;
+                compressed.resize(size);
+                if (BZ2_bzBuffToBuffCompress(compressed.data(), &size,
+                                             column.data(), column.size(),
+                                             9, 0, 0)
+                    != BZ_OK) {
+                    error_ = "Error compressing observations";
+                    break;
+                }
+                if (std::fwrite(compressed.data(), 1, size, file_) != size) {
+                    error_ = "Error writing observations to '" + filename_
+                             + "'";
+                    break;
+                }
+                entry.columns.emplace_back(offset_, size);
+                offset_ += size;
+            }
+            index_.push_back(std::move(entry));
+        }
+    }
+
+    std::string filename_;
+    std::vector<const ObservationSpec *> specs_;
+    std::vector<size_t> frame_sizes_;
+    size_t chunk_frames_;
+    std::FILE *file_ = nullptr;
+    std::unique_ptr<Chunk> chunk_;
+
+    /* Shared with the writer thread. */
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::unique_ptr<Chunk>> queue_;
+    bool closing_ = false;
+
+    /* Owned by the writer thread until it is joined. */
+    size_t offset_ = 0;
+    std::vector<ChunkIndex> index_;
+    std::string error_;
+};
+
 class Nethack
 {
   public:
@@ -166,6 +505,8 @@ class Nethack
             throw std::runtime_error("Called step on finished NetHack");
         obs_.action = action;
         nle_ = nle_step(nle_, &obs_);
+        if (recorder_)
+            recorder_->append(obs_, action);
     }
 
     bool
@@ -272,6 +613,11 @@ class Nethack
             nle_end(nle_);
             nle_ = nullptr;
         }
+        if (recorder_) {
+            std::unique_ptr<ObservationRecorder> recorder =
+                std::move(recorder_);
+            recorder->close();
+        }
     }
 
     void
@@ -363,6 +709,200 @@ class Nethack
         strncpy(settings_.wizkit, wizkit.c_str(), sizeof(settings_.wizkit));
     }
 
+    void
+    set_ttyrec_logical_time(bool logical_time)
+    {
+        settings_.ttyrec_logical_time = logical_time;
+    }
+
+    void
+    set_rng(int rng)
+    {
+        if (rng != NLE_RNG_ISAAC64 && rng != NLE_RNG_XOSHIRO)
+            throw std::invalid_argument("Unknown RNG: "
+                                        + std::to_string(rng));
+        settings_.initial_seeds.rng = rng;
+    }
+
+    void
+    set_rng_counting(bool on)
+    {
+        /* From the start of the next game, and right away in this one. */
+        settings_.rng_counts = on;
+        if (nle_)
+            nle_set_rng_counting(nle_, on);
+    }
+
+    py::dict
+    get_rng_counts()
+    {
+        if (!nle_)
+            throw std::runtime_error("get_rng_counts called without reset()");
+
+        if (!rng_counts_)
+            rng_counts_.reset(new nle_rng_counts);
+        nle_get_rng_counts(nle_, rng_counts_.get());
+
+        const nle_rng_counts &counts = *rng_counts_;
+        py::list sites;
+        for (int i = 0; i < counts.nsites; ++i) {
+            const nle_rng_site &site = counts.sites[i];
+            sites.append(py::make_tuple(site.caller, site.func, site.stream,
+                                        site.calls, site.draws));
+        }
+        py::dict result;
+        result["draws"] = py::array_t<unsigned long>(NLE_RNG_STREAMS,
+                                                     counts.draws);
+        result["calls"] = py::array_t<unsigned long>(
+            { NLE_RNG_STREAMS, NLE_RNG_FUNCS }, &counts.calls[0][0]);
+        result["sites"] = sites;
+        result["lost"] = counts.lost;
+        return result;
+    }
+
+    void
+    set_level_generator(bool level_generator)
+    {
+        settings_.level_generator = level_generator;
+    }
+
+    py::object
+    generate_level(unsigned long lgen_seed, int dnum, int dlevel)
+    {
+        if (!nle_)
+            throw std::runtime_error("generate_level called without reset()");
+        if (!settings_.level_generator)
+            throw std::runtime_error("Not a level generator");
+
+        std::unique_ptr<nle_level> level(new nle_level);
+        int result;
+        {
+            py::gil_scoped_release gil;
+            result = nle_generate_level(nle_, lgen_seed, dnum, dlevel,
+                                        level.get());
+        }
+        if (result)
+            return py::none();
+
+        const nle_level &l = *level;
+        auto map = [](const unsigned char(&a)[NLE_LEVEL_ROWS]
+                                             [NLE_LEVEL_COLS]) {
+            return py::array_t<uint8_t>({ NLE_LEVEL_ROWS, NLE_LEVEL_COLS },
+                                        &a[0][0]);
+        };
+        auto stairs = [](const unsigned char(&a)[2]) {
+            return py::make_tuple(a[0], a[1]);
+        };
+
+        py::array_t<int8_t> rooms({ l.nrooms, 8 });
+        for (int i = 0; i < l.nrooms; ++i) {
+            const auto &r = l.rooms[i];
+            int8_t row[] = { r.lx,     r.ly,   r.hx,     r.hy,
+                             r.rtype, r.rlit, r.doorct, r.irregular };
+            std::copy(row, row + 8, rooms.mutable_data(i, 0));
+        }
+        py::array_t<int32_t> objects({ l.nobjects, 4 });
+        for (int i = 0; i < l.nobjects; ++i) {
+            const auto &o = l.objects[i];
+            int32_t row[] = { o.x, o.y, o.otyp, o.quan };
+            std::copy(row, row + 4, objects.mutable_data(i, 0));
+        }
+        py::array_t<int16_t> monsters({ l.nmonsters, 5 });
+        for (int i = 0; i < l.nmonsters; ++i) {
+            const auto &m = l.monsters[i];
+            int16_t row[] = { m.x, m.y, m.mnum, m.peaceful, m.asleep };
+            std::copy(row, row + 5, monsters.mutable_data(i, 0));
+        }
+        py::array_t<uint8_t> traps({ l.ntraps, 3 });
+        for (int i = 0; i < l.ntraps; ++i) {
+            const auto &t = l.traps[i];
+            uint8_t row[] = { t.x, t.y, t.ttyp };
+            std::copy(row, row + 3, traps.mutable_data(i, 0));
+        }
+
+        py::dict result_dict;
+        result_dict["dnum"] = l.dnum;
+        result_dict["dlevel"] = l.dlevel;
+        result_dict["depth"] = l.depth;
+        result_dict["dungeon"] = std::string(l.dungeon);
+        result_dict["special"] = std::string(l.special);
+        result_dict["typ"] = map(l.typ);
+        result_dict["flags"] = map(l.flags);
+        result_dict["lit"] = map(l.lit);
+        result_dict["roomno"] = map(l.roomno);
+        result_dict["upstair"] = stairs(l.upstair);
+        result_dict["dnstair"] = stairs(l.dnstair);
+        result_dict["upladder"] = stairs(l.upladder);
+        result_dict["dnladder"] = stairs(l.dnladder);
+        result_dict["sstairs"] = stairs(l.sstairs);
+        result_dict["rooms"] = rooms;
+        result_dict["objects"] = objects;
+        result_dict["monsters"] = monsters;
+        result_dict["traps"] = traps;
+        result_dict["truncated"] = l.truncated;
+        return result_dict;
+    }
+
+    py::dict
+    get_pool_stats()
+    {
+        if (!nle_)
+            throw std::runtime_error("get_pool_stats called without reset()");
+
+        nle_pool_stats stats[NLE_POOLS];
+        nle_get_pool_stats(nle_, stats);
+
+        static const char *names[NLE_POOLS] = { "monst", "obj", "mextra",
+                                                "oextra" };
+        py::dict result;
+        for (int p = 0; p < NLE_POOLS; ++p) {
+            py::dict pool;
+            pool["size"] = stats[p].size;
+            pool["slabs"] = stats[p].slabs;
+            pool["items"] = stats[p].items;
+            pool["live"] = stats[p].live;
+            pool["peak"] = stats[p].peak;
+            pool["gets"] = stats[p].gets;
+            pool["puts"] = stats[p].puts;
+            result[names[p]] = pool;
+        }
+        return result;
+    }
+
+    void
+    set_replay(std::string replay)
+    {
+        if (replay.size() > sizeof(settings_.replayname) - 1) {
+            throw std::length_error("replay filepath too long");
+        }
+        strncpy(settings_.replayname, replay.c_str(),
+                sizeof(settings_.replayname));
+    }
+
+    void
+    record_observations(std::string filename,
+                        std::vector<std::string> observation_keys,
+                        size_t chunk_frames)
+    {
+        if (recorder_) {
+            std::unique_ptr<ObservationRecorder> recorder =
+                std::move(recorder_);
+            recorder->close();
+        }
+        if (filename.empty())
+            return;
+
+        std::vector<const ObservationSpec *> specs;
+        for (const std::string &key : observation_keys) {
+            specs.push_back(find_observation_spec(key));
+            if (!observation_buffer(obs_, *specs.back()))
+                throw std::invalid_argument("No buffer set for observation '"
+                                            + key + "'");
+        }
+        recorder_.reset(
+            new ObservationRecorder(filename, std::move(specs), chunk_frames));
+    }
+
   private:
     void
     reset(FILE *ttyrec)
@@ -382,6 +922,9 @@ class Nethack
         settings_.initial_seeds.use_init_seeds = false;
         settings_.initial_seeds.use_lgen_seed = false;
 
+        if (recorder_)
+            recorder_->append(obs_, -1);
+
         if (obs_.done)
             throw std::runtime_error("NetHack done right after reset");
     }
@@ -392,6 +935,568 @@ class Nethack
     nledl_ctx *nle_ = nullptr;
     std::FILE *ttyrec_ = nullptr;
     nle_settings settings_;
+    std::unique_ptr<ObservationRecorder> recorder_;
+    std::unique_ptr<nle_rng_counts> rng_counts_;
+};
+
+/* Re-simulation of replay recordings, see nlereplay.h. */
+
+struct ReplaySeeds {
+    unsigned long core = 0;
+    unsigned long disp = 0;
+    unsigned long lgen = 0;
+    bool reseed = false;
+    bool lgen_in_use = false;
+};
+
+struct ReplayClock {
+    int64_t time = 0;
+    int32_t utc_offset = 0; /* seconds east of UTC */
+};
+
+struct ReplayEpisode {
+    std::string options;
+    bool spawn_monsters = true;
+    uint8_t rng = NLE_RNG_ISAAC64;
+    ReplayClock start; /* start.time is 0 if not recorded */
+    ReplaySeeds seeds;
+    std::vector<uint8_t> actions;
+    /* Seeds set (via nle_set_seed) right before actions[first]. */
+    std::vector<std::pair<size_t, ReplaySeeds>> reseeds;
+    /* The clock as the game saw it from actions[first] on (ttyrecs). */
+    std::vector<std::pair<size_t, ReplayClock>> clock_changes;
+    bool has_seeds = false;
+};
+
+/* Applies an OPTIONS, RNG, TIME, SEEDS, ACTION, SCORE or DONE record to the
+ * episode, reading its payload with read(buf, length). Returns false for
+ * other record types. */
+template <typename Read>
+static bool
+read_replay_record(uint8_t type, Read &&read, ReplayEpisode &episode)
+{
+    switch (type) {
+    case NLE_REPLAY_OPTIONS: {
+        uint8_t spawn;
+        uint32_t len;
+        read(&spawn, 1);
+        read(&len, sizeof(len));
+        episode.spawn_monsters = spawn;
+        episode.options.resize(len);
+        read(&episode.options[0], len);
+        return true;
+    }
+    case NLE_REPLAY_RNG:
+        read(&episode.rng, 1);
+        return true;
+    case NLE_REPLAY_TIME: {
+        ReplayClock clock;
+        read(&clock.time, sizeof(clock.time));
+        read(&clock.utc_offset, sizeof(clock.utc_offset));
+        /* The start time comes before the first SEEDS record; later ones
+         * were written while the game took the last action. */
+        if (!episode.has_seeds)
+            episode.start = clock;
+        else
+            episode.clock_changes.emplace_back(
+                episode.actions.empty() ? 0 : episode.actions.size() - 1,
+                clock);
+        return true;
+    }
+    case NLE_REPLAY_SEEDS: {
+        uint8_t buf[NLE_REPLAY_SEEDS_SIZE];
+        uint64_t values[3];
+        read(buf, sizeof(buf));
+        std::memcpy(values, buf, sizeof(values));
+
+        ReplaySeeds seeds;
+        seeds.core = values[0];
+        seeds.disp = values[1];
+        seeds.lgen = values[2];
+        seeds.reseed = buf[sizeof(values)];
+        seeds.lgen_in_use = buf[sizeof(values) + 1];
+        if (!episode.has_seeds)
+            episode.seeds = seeds;
+        else
+            episode.reseeds.emplace_back(episode.actions.size(), seeds);
+        episode.has_seeds = true;
+        return true;
+    }
+    case NLE_REPLAY_ACTION: {
+        uint8_t action;
+        read(&action, 1);
+        episode.actions.push_back(action);
+        return true;
+    }
+    case NLE_REPLAY_SCORE:
+    case NLE_REPLAY_DONE: {
+        int32_t ignored;
+        read(&ignored, sizeof(ignored));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/* Throws unless the episode can be re-simulated exactly: with reseeding,
+ * NetHack reseeds its RNGs from the system's entropy source mid-game. */
+static void
+check_reproducible(const ReplayEpisode &episode, const std::string &filename)
+{
+    bool reseed = episode.seeds.reseed;
+    for (const auto &reseeds : episode.reseeds)
+        reseed = reseed || reseeds.second.reseed;
+    if (reseed)
+        throw std::invalid_argument("Game played with reseeding in '"
+                                    + filename
+                                    + "' cannot be re-simulated");
+}
+
+class ReplayFile
+{
+  public:
+    ReplayFile(const std::string &filename) : filename_(filename)
+    {
+        file_ = std::fopen(filename.c_str(), "r");
+        if (!file_)
+            throw std::runtime_error("Could not open replay: '" + filename
+                                     + "'");
+        int bzerror;
+        bfp_ = BZ2_bzReadOpen(&bzerror, file_, 0, 0, nullptr, 0);
+        if (bzerror != BZ_OK) {
+            BZ2_bzReadClose(&bzerror, bfp_);
+            std::fclose(file_);
+            throw std::runtime_error("Could not open bzip2 stream: '"
+                                     + filename + "'");
+        }
+    }
+
+    ~ReplayFile()
+    {
+        int bzerror;
+        BZ2_bzReadClose(&bzerror, bfp_);
+        std::fclose(file_);
+    }
+
+    /* Returns false if the stream ended before the first byte and eof_ok,
+     * throws on any other short read. */
+    bool
+    read(void *buf, int length, bool eof_ok = false)
+    {
+        if (length == 0)
+            return true;
+        if (eof_) {
+            if (eof_ok)
+                return false;
+            throw std::runtime_error("Truncated replay: '" + filename_
+                                     + "'");
+        }
+        int bzerror;
+        int n = BZ2_bzRead(&bzerror, bfp_, buf, length);
+        if (bzerror == BZ_STREAM_END)
+            eof_ = true;
+        else if (bzerror != BZ_OK)
+            throw std::runtime_error("Error reading replay: '" + filename_
+                                     + "'");
+        if (n == length)
+            return true;
+        if (n == 0 && eof_ok)
+            return false;
+        throw std::runtime_error("Truncated replay: '" + filename_ + "'");
+    }
+
+    ReplayEpisode
+    load()
+    {
+        ReplayEpisode episode;
+        uint8_t type;
+
+        if (!read(&type, 1) || type != NLE_REPLAY_HEADER)
+            throw std::runtime_error("Not an NLE replay: '" + filename_
+                                     + "'");
+        char header[NLE_REPLAY_MAGIC_SIZE + 4 + 8];
+        read(header, sizeof(header));
+        uint32_t version;
+        std::memcpy(&version, header + NLE_REPLAY_MAGIC_SIZE,
+                    sizeof(version));
+        if (std::memcmp(header, NLE_REPLAY_MAGIC, sizeof(NLE_REPLAY_MAGIC))
+            || version > NLE_REPLAY_VERSION)
+            throw std::runtime_error("Unsupported replay: '" + filename_
+                                     + "'");
+        std::memcpy(&episode.start.time, header + NLE_REPLAY_MAGIC_SIZE + 4,
+                    sizeof(episode.start.time));
+
+        auto read_payload = [this](void *buf, int length) {
+            read(buf, length);
+        };
+        while (read(&type, 1, true)) {
+            if (!read_replay_record(type, read_payload, episode))
+                throw std::runtime_error("Unknown replay record in '"
+                                         + filename_ + "'");
+        }
+        if (!episode.has_seeds)
+            throw std::runtime_error("Replay without seeds: '" + filename_
+                                     + "'");
+        check_reproducible(episode, filename_);
+        return episode;
+    }
+
+  private:
+    std::string filename_;
+    std::FILE *file_ = nullptr;
+    BZFILE *bfp_ = nullptr;
+    bool eof_ = false;
+};
+
+/* The episodes of an NLE ttyrec, from the actions in channel 1 and the
+ * replay records in channel NLE_TTYREC_REPLAY_CHANNEL. Each game started
+ * in the ttyrec begins with an OPTIONS record. */
+class TtyrecReplay
+{
+  public:
+    static std::vector<ReplayEpisode>
+    load(const std::string &filename)
+    {
+        std::string data = read_file(filename);
+        std::vector<ReplayEpisode> episodes;
+
+        /* Like read_header in converter.c; a record cut short by the end of
+         * the file is dropped. */
+        const size_t header_size = 3 * sizeof(int32_t) + 1;
+        for (size_t pos = 0; pos + header_size <= data.size();) {
+            int32_t header[3];
+            std::memcpy(header, &data[pos], sizeof(header));
+            unsigned char channel = data[pos + sizeof(header)];
+            size_t len = (uint32_t) header[2];
+            pos += header_size;
+            if (len > data.size() - pos)
+                break;
+            const char *payload = &data[pos];
+            pos += len;
+
+            if (channel == 1 && len > 0 && !episodes.empty()) {
+                episodes.back().actions.push_back(payload[0]);
+            } else if (channel == NLE_TTYREC_REPLAY_CHANNEL && len > 0) {
+                uint8_t type = payload[0];
+                size_t offset = 1;
+                auto read_payload = [&](void *buf, size_t length) {
+                    if (length > len - offset)
+                        throw std::runtime_error("Truncated replay record in '"
+                                                 + filename + "'");
+                    std::memcpy(buf, payload + offset, length);
+                    offset += length;
+                };
+                if (type == NLE_REPLAY_OPTIONS)
+                    episodes.emplace_back();
+                if (episodes.empty()
+                    || !read_replay_record(type, read_payload,
+                                           episodes.back()))
+                    throw std::runtime_error("Unexpected replay record in '"
+                                             + filename + "'");
+            }
+        }
+        if (episodes.empty())
+            throw std::runtime_error("Ttyrec without seeds: '" + filename
+                                     + "'");
+        for (const ReplayEpisode &episode : episodes) {
+            if (!episode.has_seeds)
+                throw std::runtime_error("Ttyrec without seeds: '" + filename
+                                         + "'");
+            check_reproducible(episode, filename);
+        }
+        return episodes;
+    }
+
+  private:
+    /* The whole file, decompressed if it is a (possibly multi-stream, one
+     * stream per reset) bzip2 file. */
+    static std::string
+    read_file(const std::string &filename)
+    {
+        std::ifstream f(filename, std::ios::binary);
+        if (!f)
+            throw std::runtime_error("Could not open ttyrec: '" + filename
+                                     + "'");
+        std::string raw((std::istreambuf_iterator<char>(f)),
+                        std::istreambuf_iterator<char>());
+        if (raw.compare(0, 3, "BZh") != 0)
+            return raw;
+
+        std::string data;
+        size_t consumed = 0;
+        while (consumed < raw.size()) {
+            bz_stream strm{};
+            if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK)
+                throw std::runtime_error("Could not open bzip2 stream: '"
+                                         + filename + "'");
+            strm.next_in = &raw[consumed];
+            strm.avail_in = raw.size() - consumed;
+            int ret;
+            do {
+                char buf[1 << 16];
+                strm.next_out = buf;
+                strm.avail_out = sizeof(buf);
+                ret = BZ2_bzDecompress(&strm);
+                data.append(buf, sizeof(buf) - strm.avail_out);
+            } while (ret == BZ_OK && (strm.avail_in || !strm.avail_out));
+            consumed = raw.size() - strm.avail_in;
+            BZ2_bzDecompressEnd(&strm);
+            if (ret != BZ_STREAM_END)
+                break; /* Truncated: keep what was decompressed. */
+        }
+        return data;
+    }
+};
+
+static int
+remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return ::remove(path);
+}
+
+/* One NetHack instance (own copy of libnethack.so and own HACKDIR)
+ * replaying episodes one after the other. */
+class ReplayWorker
+{
+  public:
+    ReplayWorker(const std::string &dlpath, const std::string &hackdir,
+                 const std::vector<const ObservationSpec *> &specs)
+        : specs_(specs), obs_{}
+    {
+        const char *tmpdir = std::getenv("TMPDIR");
+        std::string pattern = std::string(tmpdir ? tmpdir : "/tmp")
+                              + "/nlereplayXXXXXX";
+        std::vector<char> buf(pattern.begin(), pattern.end());
+        buf.push_back('\0');
+        if (!mkdtemp(buf.data()))
+            throw std::runtime_error("Could not create replay directory");
+        vardir_ = buf.data();
+
+        /* Same layout as Nethack.__init__ in nethack.py. */
+        if (symlink((hackdir + "/nhdat").c_str(),
+                    (vardir_ + "/nhdat").c_str()))
+            throw std::runtime_error("Could not link nhdat from '" + hackdir
+                                     + "'");
+        for (const char *fn : { "perm", "record", "logfile", "xlogfile" }) {
+            int fd = open((vardir_ + "/" + fn).c_str(), O_CREAT | O_WRONLY,
+                          0644);
+            if (fd >= 0)
+                close(fd);
+        }
+        mkdir((vardir_ + "/save").c_str(), 0755);
+
+        /* Several copies of the dl are necessary to run instances in
+         * parallel, cf. _new_dl in nethack.py. */
+        dlpath_ = vardir_ + "/libnethack.so";
+        std::ifstream src(dlpath, std::ios::binary);
+        std::ofstream dst(dlpath_, std::ios::binary);
+        dst << src.rdbuf();
+        if (!src || !dst)
+            throw std::runtime_error("Could not copy '" + dlpath + "'");
+
+        scratch_.reserve(specs_.size());
+        for (const ObservationSpec *spec : specs_) {
+            scratch_.emplace_back(spec->size());
+            *reinterpret_cast<void **>(reinterpret_cast<char *>(&obs_)
+                                       + spec->offset) =
+                scratch_.back().data();
+        }
+    }
+
+    ~ReplayWorker()
+    {
+        if (nle_)
+            nle_end(nle_);
+        nftw(vardir_.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    /* Returns one buffer per observation key with the observations the
+     * recorded actions were taken in, plus the actions themselves. */
+    std::vector<std::vector<uint8_t>>
+    run(const ReplayEpisode &episode)
+    {
+        nle_settings settings{};
+        strncpy(settings.hackdir, vardir_.c_str(),
+                sizeof(settings.hackdir) - 1);
+        strncpy(settings.options, episode.options.c_str(),
+                sizeof(settings.options) - 1);
+        settings.spawn_monsters = episode.spawn_monsters;
+        settings.fixed_time = episode.start.time;
+        settings.fixed_utc_offset = episode.start.utc_offset;
+        settings.initial_seeds.seeds[0] = episode.seeds.core;
+        settings.initial_seeds.seeds[1] = episode.seeds.disp;
+        settings.initial_seeds.reseed = episode.seeds.reseed;
+        settings.initial_seeds.use_init_seeds = true;
+        settings.initial_seeds.lgen_seed = episode.seeds.lgen;
+        settings.initial_seeds.use_lgen_seed = episode.seeds.lgen_in_use;
+        settings.initial_seeds.rng = episode.rng;
+
+        if (!nle_)
+            nle_ = nle_start(dlpath_.c_str(), &obs_, nullptr, &settings);
+        else
+            nle_reset(nle_, &obs_, nullptr, &settings);
+
+        std::vector<std::vector<uint8_t>> result(specs_.size() + 1);
+        for (size_t k = 0; k < specs_.size(); ++k)
+            result[k].reserve(episode.actions.size() * scratch_[k].size());
+
+        auto reseed = episode.reseeds.begin();
+        auto clock = episode.clock_changes.begin();
+        size_t t = 0;
+        for (; t < episode.actions.size() && !obs_.done; ++t) {
+            for (; reseed != episode.reseeds.end() && reseed->first == t;
+                 ++reseed) {
+                const ReplaySeeds &s = reseed->second;
+                nle_set_seed(nle_, s.core, s.disp, s.reseed, s.lgen);
+            }
+            for (; clock != episode.clock_changes.end() && clock->first == t;
+                 ++clock)
+                nle_set_clock(nle_, clock->second.time,
+                              clock->second.utc_offset);
+            for (size_t k = 0; k < specs_.size(); ++k)
+                result[k].insert(result[k].end(), scratch_[k].begin(),
+                                 scratch_[k].end());
+            obs_.action = episode.actions[t];
+            nle_ = nle_step(nle_, &obs_);
+        }
+        result.back().assign(episode.actions.begin(),
+                             episode.actions.begin() + t);
+        return result;
+    }
+
+  private:
+    std::vector<const ObservationSpec *> specs_;
+    std::string vardir_;
+    std::string dlpath_;
+    nledl_ctx *nle_ = nullptr;
+    nle_obs obs_;
+    std::vector<std::vector<uint8_t>> scratch_;
+};
+
+class Replayer
+{
+  public:
+    Replayer(std::string dlpath, std::string hackdir,
+             std::vector<std::string> observation_keys, size_t num_threads)
+        : dlpath_(std::move(dlpath)), hackdir_(std::move(hackdir)),
+          num_threads_(num_threads ? num_threads : 1)
+    {
+        for (const std::string &key : observation_keys)
+            specs_.push_back(find_observation_spec(key));
+    }
+
+    py::list
+    replay(std::vector<std::string> filenames)
+    {
+        std::vector<ReplayEpisode> episodes(filenames.size());
+        {
+            py::gil_scoped_release gil;
+            parallel_for(filenames.size(), [&](size_t, size_t i) {
+                episodes[i] = ReplayFile(filenames[i]).load();
+            });
+        }
+        return simulate(episodes);
+    }
+
+    py::list
+    replay_ttyrecs(std::vector<std::string> filenames)
+    {
+        std::vector<std::vector<ReplayEpisode>> loaded(filenames.size());
+        {
+            py::gil_scoped_release gil;
+            parallel_for(filenames.size(), [&](size_t, size_t i) {
+                loaded[i] = TtyrecReplay::load(filenames[i]);
+            });
+        }
+        std::vector<ReplayEpisode> episodes;
+        for (auto &file_episodes : loaded)
+            for (auto &episode : file_episodes)
+                episodes.push_back(std::move(episode));
+        return simulate(episodes);
+    }
+
+  private:
+    /* Calls fn(worker, i) for i in [0, n) on up to num_threads_ threads,
+     * then rethrows the first error, if any. */
+    template <typename F>
+    void
+    parallel_for(size_t n, F &&fn)
+    {
+        std::vector<std::exception_ptr> errors(n);
+        size_t num_threads = std::min(num_threads_, n);
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < num_threads; ++w) {
+            threads.emplace_back([&, w]() {
+                for (size_t i = next++; i < n; i = next++) {
+                    try {
+                        fn(w, i);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        for (std::exception_ptr &error : errors)
+            if (error)
+                std::rethrow_exception(error);
+    }
+
+    py::list
+    simulate(const std::vector<ReplayEpisode> &episodes)
+    {
+        std::vector<std::vector<std::vector<uint8_t>>> results(
+            episodes.size());
+        {
+            py::gil_scoped_release gil;
+
+            size_t num_threads = std::min(num_threads_, episodes.size());
+            while (workers_.size() < num_threads)
+                workers_.emplace_back(new ReplayWorker(dlpath_, hackdir_,
+                                                       specs_));
+            parallel_for(episodes.size(), [&](size_t w, size_t i) {
+                results[i] = workers_[w]->run(episodes[i]);
+            });
+        }
+
+        py::list result_list;
+        for (auto &result : results) {
+            py::dict episode;
+            size_t steps = result.back().size();
+            for (size_t k = 0; k < specs_.size(); ++k) {
+                std::vector<ssize_t> shape = { (ssize_t) steps };
+                shape.insert(shape.end(), specs_[k]->shape.begin(),
+                             specs_[k]->shape.end());
+                episode[specs_[k]->name] =
+                    to_array(std::move(result[k]), specs_[k]->dtype, shape);
+            }
+            episode["actions"] = to_array(std::move(result.back()), "uint8",
+                                          { (ssize_t) steps });
+            result_list.append(std::move(episode));
+        }
+        return result_list;
+    }
+
+    static py::array
+    to_array(std::vector<uint8_t> &&data, const char *dtype,
+             const std::vector<ssize_t> &shape)
+    {
+        auto *owned = new std::vector<uint8_t>(std::move(data));
+        py::capsule free_when_done(owned, [](void *p) {
+            delete reinterpret_cast<std::vector<uint8_t> *>(p);
+        });
+        return py::array(py::dtype(dtype), shape, owned->data(),
+                         free_when_done);
+    }
+
+    std::string dlpath_;
+    std::string hackdir_;
+    size_t num_threads_;
+    std::vector<const ObservationSpec *> specs_;
+    std::vector<std::unique_ptr<ReplayWorker>> workers_;
 };
 
 PYBIND11_MODULE(_pynethack, m)
@@ -431,7 +1536,30 @@ PYBIND11_MODULE(_pynethack, m)
         .def("get_seeds", &Nethack::get_seeds)
         .def("in_normal_game", &Nethack::in_normal_game)
         .def("how_done", &Nethack::how_done)
-        .def("set_wizkit", &Nethack::set_wizkit);
+        .def("set_wizkit", &Nethack::set_wizkit)
+        .def("set_ttyrec_logical_time", &Nethack::set_ttyrec_logical_time,
+             py::arg("logical_time"))
+        .def("set_rng", &Nethack::set_rng, py::arg("rng"))
+        .def("set_rng_counting", &Nethack::set_rng_counting, py::arg("on"))
+        .def("get_rng_counts", &Nethack::get_rng_counts)
+        .def("set_level_generator", &Nethack::set_level_generator,
+             py::arg("level_generator"))
+        .def("generate_level", &Nethack::generate_level,
+             py::arg("lgen_seed"), py::arg("dnum"), py::arg("dlevel"))
+        .def("get_pool_stats", &Nethack::get_pool_stats)
+        .def("set_replay", &Nethack::set_replay, py::arg("replay"))
+        .def("record_observations", &Nethack::record_observations,
+             py::arg("filename"), py::arg("observation_keys"),
+             py::arg("chunk_frames") = 1024);
+
+    py::class_<Replayer>(m, "Replayer")
+        .def(py::init<std::string, std::string, std::vector<std::string>,
+                      size_t>(),
+             py::arg("dlpath"), py::arg("hackdir"),
+             py::arg("observation_keys"), py::arg("num_threads") = 1)
+        .def("replay", &Replayer::replay, py::arg("filenames"))
+        .def("replay_ttyrecs", &Replayer::replay_ttyrecs,
+             py::arg("filenames"));
 
     py::module mn = m.def_submodule(
         "nethack", "Collection of NetHack constants and functions");
@@ -446,6 +1574,17 @@ PYBIND11_MODULE(_pynethack, m)
     mn.attr("NLE_INVENTORY_STR_LENGTH") = py::int_(NLE_INVENTORY_STR_LENGTH);
     mn.attr("NLE_SCREEN_DESCRIPTION_LENGTH") =
         py::int_(NLE_SCREEN_DESCRIPTION_LENGTH);
+    mn.attr("NLE_RNG_ISAAC64") = py::int_(NLE_RNG_ISAAC64);
+    mn.attr("NLE_RNG_XOSHIRO") = py::int_(NLE_RNG_XOSHIRO);
+    mn.attr("NLE_RNG_STREAM_CORE") = py::int_(NLE_RNG_STREAM_CORE);
+    mn.attr("NLE_RNG_STREAM_DISP") = py::int_(NLE_RNG_STREAM_DISP);
+    mn.attr("NLE_RNG_STREAM_LGEN") = py::int_(NLE_RNG_STREAM_LGEN);
+    mn.attr("NLE_RNG_RN2") = py::int_(NLE_RNG_RN2);
+    mn.attr("NLE_RNG_RNL") = py::int_(NLE_RNG_RNL);
+    mn.attr("NLE_RNG_RND") = py::int_(NLE_RNG_RND);
+    mn.attr("NLE_RNG_D") = py::int_(NLE_RNG_D);
+    mn.attr("NLE_RNG_RNE") = py::int_(NLE_RNG_RNE);
+    mn.attr("NLE_RNG_RNZ") = py::int_(NLE_RNG_RNZ);
 
     mn.attr("NLE_BL_X") = py::int_(NLE_BL_X);
     mn.attr("NLE_BL_Y") = py::int_(NLE_BL_Y);
@@ -136,6 +136,8 @@ class NetHackRL
     static void rl_cliparound(int x, int y);
     static void rl_print_glyph(winid wid, XCHAR_P x, XCHAR_P y, int glyph,
                                int bkglyph);
+    static void rl_print_glyph_row(int y, int start, int stop,
+                                   const int *glyphs);
     static void rl_raw_print(const char *str);
     static void rl_raw_print_bold(const char *str);
     static int rl_nhgetch();
@@ -208,6 +210,8 @@ class NetHackRL
     void store_mapped_glyph(int ch, int color, int special, XCHAR_P x,
                             XCHAR_P y);
     void store_screen_description(XCHAR_P x, XCHAR_P y, int glyph);
+    void store_map_glyph(XCHAR_P x, XCHAR_P y, int glyph);
+    void store_glyph_row(int y, int start, int stop, const int *glyphs);
 
     void fill_obs(nle_obs *);
     int getch_method();
@@ -487,6 +491,40 @@ NetHackRL::store_mapped_glyph(int ch, int color, int special, XCHAR_P x,
     specials_[offset] = special;
 }
 
+/* Stores everything the observations hold about glyph at (x, y) on the
+ * map, see rl_print_glyph. */
+void
+NetHackRL::store_map_glyph(XCHAR_P x, XCHAR_P y, int glyph)
+{
+    int ch;
+    int color;
+    unsigned special;
+
+    (void) mapglyph(glyph, &ch, &color, &special, x, y, 0);
+    store_glyph(x, y, glyph);
+    if (glyph != nul_glyph && color == CLR_BLACK) {
+        /* This will be 'bright black' (or blue) on tty so we change it to
+         * make NLE's colors and tty_colors stay compatible. */
+        color = iflags.wc2_darkgray ? 8 : CLR_BLUE;
+    }
+    store_mapped_glyph(ch, color, special, x, y);
+    if (nle_get_obs()->screen_descriptions) {
+        store_screen_description(x, y, glyph);
+    }
+}
+
+/* As store_map_glyph for each changed position of row y from start to
+ * stop, see rl_print_glyph_row. */
+void
+NetHackRL::store_glyph_row(int y, int start, int stop, const int *glyphs)
+{
+    // 1 <= start <= stop < cols, 0 <= y < rows
+    for (int x = start; x <= stop; ++x) {
+        if (glyphs[x - start] != NO_GLYPH)
+            store_map_glyph(x, y, glyphs[x - start]);
+    }
+}
+
 void
 NetHackRL::store_screen_description(XCHAR_P x, XCHAR_P y, int glyph)
 {
@@ -909,12 +947,11 @@ void
 NetHackRL::rl_print_glyph(winid wid, XCHAR_P x, XCHAR_P y, int glyph,
                           int bkglyph)
 {
+#if USE_DEBUG_API
     int ch;
     int color;
     unsigned special;
-
     (void) mapglyph(glyph, &ch, &color, &special, x, y, 0);
-#if USE_DEBUG_API
     DEBUG_API("rl_print_glyph(wid=" << wid << ", x=" << x << ", y=" << y
                                     << ", glyph=(ch='" << (char) ch
                                     << "', color=" << color
@@ -930,16 +967,7 @@ NetHackRL::rl_print_glyph(winid wid, XCHAR_P x, XCHAR_P y, int glyph,
 
     // No win_proc_calls entry here.
     if (wid == WIN_MAP) {
-        instance->store_glyph(x, y, glyph);
-        if (glyph != nul_glyph && color == CLR_BLACK) {
-            /* This will be 'bright black' (or blue) on tty so we change it to
-             * make NLE's colors and tty_colors stay compatible. */
-            color = iflags.wc2_darkgray ? 8 : CLR_BLUE;
-        }
-        instance->store_mapped_glyph(ch, color, special, x, y);
-        if (nle_get_obs()->screen_descriptions) {
-            instance->store_screen_description(x, y, glyph);
-        }
+        instance->store_map_glyph(x, y, glyph);
     } else {
         DEBUG_API("Window id is " << wid << ". This shouldn't happen."
                                   << std::endl);
@@ -947,6 +975,16 @@ NetHackRL::rl_print_glyph(winid wid, XCHAR_P x, XCHAR_P y, int glyph,
 
     tty_print_glyph(wid, x, y, glyph, bkglyph);
 }
+
+/* Like rl_print_glyph on WIN_MAP for each position of row y from start to
+ * stop whose glyphs[x - start] isn't NO_GLYPH, but with no tty output.
+ * flush_screen in display.c calls this instead when nothing reads the
+ * terminal (no ttyrec and no tty_* observations). */
+void
+NetHackRL::rl_print_glyph_row(int y, int start, int stop, const int *glyphs)
+{
+    instance->store_glyph_row(y, start, stop, glyphs);
+}
 void
 NetHackRL::rl_raw_print(const char *str)
 {
@@ -1211,3 +1249,9 @@ struct window_procs rl_procs = {
     nethack_rl::NetHackRL::rl_status_update,
     genl_can_suspend_yes,
 };
+
+extern "C" void
+rl_print_glyph_row(int y, int start, int stop, const int *glyphs)
+{
+    nethack_rl::NetHackRL::rl_print_glyph_row(y, start, stop, glyphs);
+}